@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+
+#include <wand/magick_wand.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "source_io.h"
+#include "admission.h"
+
+char *admission_oversize_strs[] = {
+        [ADMISSION_OVERSIZE_DOWNSCALE]  = "downscale",
+        [ADMISSION_OVERSIZE_REJECT]     = "reject",
+};
+
+struct admission admission_limits;
+
+static uint64_t admission_pixels_max(void)
+{
+        uint64_t mp = admission_limits.max_megapixels ? admission_limits.max_megapixels : ADMISSION_MEGAPIXELS_DEFAULT;
+
+        return mp * 1000000;
+}
+
+static uint64_t admission_file_size_max(void)
+{
+        uint64_t mb = admission_limits.max_file_size ? admission_limits.max_file_size : ADMISSION_FILE_SIZE_DEFAULT;
+
+        return mb << 20;
+}
+
+static uint64_t admission_frames_max(void)
+{
+        return admission_limits.max_frames ? admission_limits.max_frames : ADMISSION_FRAMES_DEFAULT;
+}
+
+static double admission_ratio_max(void)
+{
+        return admission_limits.max_ratio > 0.0 ? admission_limits.max_ratio : ADMISSION_RATIO_DEFAULT;
+}
+
+// decoders which honour size hint by reducing while decoding
+static int admission_format_scalable(const char *fmt)
+{
+        if (!fmt)
+                return 0;
+
+        return !strcasecmp(fmt, "JPEG") || !strcasecmp(fmt, "JPG");
+}
+
+// file size only, before anything is read, quiet for callers which just skip
+int admission_file_check(const char *path, uint64_t *size)
+{
+        uint64_t file_size = 0;
+        int err;
+
+        if ((err = source_stat(path, &file_size, NULL)))
+                return err;
+
+        if (file_size > admission_file_size_max())
+                return -EFBIG;
+
+        if (size)
+                *size = file_size;
+
+        return 0;
+}
+
+//
+// check pinged header of @path against limits, a source over pixel limit
+// whose decoder can reduce while decoding gets a size hint which lands
+// within limit, others are rejected, so decoder never allocates more than
+// share of a single source
+//
+static int admission_header_check(const char *path, uint64_t width, uint64_t height, uint64_t frames,
+                                  const char *fmt, uint64_t file_size, struct admission_hint *hint)
+{
+        uint64_t pixels = width * height;
+        uint64_t pixels_max = admission_pixels_max();
+
+        hint->width = 0;
+        hint->height = 0;
+
+        if (!width || !height)
+                return -EINVAL;
+
+        if (frames > admission_frames_max()) {
+                pr_err("reject %s: %llu frames, limit %llu\n", path,
+                       (unsigned long long)frames, (unsigned long long)admission_frames_max());
+                return -E2BIG;
+        }
+
+        //
+        // a few KiB declaring gigapixels is a decompression bomb, flat or
+        // palette images compress far beyond the ratio too, so only judge
+        // sources which come near the pixel limit in total
+        //
+        if (file_size && pixels * max(frames, (uint64_t)1) >= pixels_max / ADMISSION_RATIO_FROM &&
+            (double)pixels * max(frames, (uint64_t)1) * 4 / file_size > admission_ratio_max()) {
+                pr_err("reject %s: %llux%llu from %llu bytes, ratio over %.0f\n", path,
+                       (unsigned long long)width, (unsigned long long)height,
+                       (unsigned long long)file_size, admission_ratio_max());
+                return -E2BIG;
+        }
+
+        if (pixels <= pixels_max)
+                return 0;
+
+        if (admission_limits.oversize == ADMISSION_OVERSIZE_DOWNSCALE && admission_format_scalable(fmt)) {
+                for (uint32_t k = 1; k <= ADMISSION_SCALE_SHIFT_MAX; k++) {
+                        if ((width >> k) * (height >> k) > pixels_max)
+                                continue;
+
+                        hint->width = (uint32_t)max(width >> k, (uint64_t)1);
+                        hint->height = (uint32_t)max(height >> k, (uint64_t)1);
+
+                        pr_info("%s: %llux%llu over limit, decode at 1/%u\n", path,
+                                (unsigned long long)width, (unsigned long long)height, 1U << k);
+
+                        return 0;
+                }
+        }
+
+        pr_err("reject %s: %llux%llu over limit of %llu megapixels\n", path,
+               (unsigned long long)width, (unsigned long long)height,
+               (unsigned long long)(pixels_max / 1000000));
+
+        return -E2BIG;
+}
+
+int admission_check(MagickWand *ping, const char *path, uint64_t file_size, struct admission_hint *hint)
+{
+        char *fmt = MagickGetImageFormat(ping);
+        int err;
+
+        err = admission_header_check(path, MagickGetImageWidth(ping), MagickGetImageHeight(ping),
+                                     MagickGetNumberImages(ping), fmt, file_size, hint);
+
+        if (fmt)
+                MagickRelinquishMemory(fmt);
+
+        return err;
+}
+
+//
+// for rasters whose size is ours to pick (vector documents), fit
+// @width x @height into pixel limit keeping aspect or reject, per oversize
+//
+int admission_pixels_fit(const char *path, uint32_t *width, uint32_t *height)
+{
+        uint64_t pixels = (uint64_t)*width * *height;
+        uint64_t pixels_max = admission_pixels_max();
+        double scale;
+
+        if (pixels <= pixels_max)
+                return 0;
+
+        if (admission_limits.oversize != ADMISSION_OVERSIZE_DOWNSCALE) {
+                pr_err("reject %s: %ux%u over limit of %llu megapixels\n", path, *width, *height,
+                       (unsigned long long)(pixels_max / 1000000));
+                return -E2BIG;
+        }
+
+        scale = sqrt((double)pixels_max / pixels);
+
+        pr_info("%s: %ux%u over limit, rasterise at %.3fx\n", path, *width, *height, scale);
+
+        *width = (uint32_t)max(*width * scale, 1.0);
+        *height = (uint32_t)max(*height * scale, 1.0);
+
+        return 0;
+}
+
+//
+// for decoders which reduce by powers of two up to @shift_max (video
+// lowres), smallest shift which lands @width x @height within pixel limit,
+// rejects when oversize mode says so or no shift is small enough
+//
+int admission_pixels_shift(const char *path, uint32_t width, uint32_t height, uint32_t shift_max,
+                           uint32_t *shift)
+{
+        uint64_t pixels_max = admission_pixels_max();
+
+        *shift = 0;
+
+        if ((uint64_t)width * height <= pixels_max)
+                return 0;
+
+        if (admission_limits.oversize == ADMISSION_OVERSIZE_DOWNSCALE) {
+                for (uint32_t k = 1; k <= shift_max; k++) {
+                        if ((uint64_t)(width >> k) * (height >> k) > pixels_max)
+                                continue;
+
+                        pr_info("%s: %ux%u over limit, decode at 1/%u\n", path, width, height, 1U << k);
+
+                        *shift = k;
+
+                        return 0;
+                }
+        }
+
+        pr_err("reject %s: %ux%u over limit of %llu megapixels\n", path, width, height,
+               (unsigned long long)(pixels_max / 1000000));
+
+        return -E2BIG;
+}
+
+int admission_ping(const char *path, struct admission_hint *hint)
+{
+        uint64_t file_size = 0;
+        MagickWand *w;
+        int err;
+
+        if ((err = admission_file_check(path, &file_size))) {
+                if (err == -EFBIG)
+                        pr_err("reject %s: file over %u MiB\n", path,
+                               (uint32_t)(admission_file_size_max() >> 20));
+
+                return err;
+        }
+
+        w = NewMagickWand();
+
+        if (MagickPingImage(w, path) != MagickPass) {
+                pr_err("failed to read header of %s\n", path);
+                DestroyMagickWand(w);
+                return -EIO;
+        }
+
+        err = admission_check(w, path, file_size, hint);
+
+        DestroyMagickWand(w);
+
+        return err;
+}
+
+// same as admission_ping() on a prefetched copy of @path, file is not read again
+int admission_ping_blob(const char *path, const void *blob, size_t len, struct admission_hint *hint)
+{
+        ExceptionInfo exception;
+        ImageInfo *info;
+        Image *img;
+        int err;
+
+        if (len > admission_file_size_max()) {
+                pr_err("reject %s: file over %u MiB\n", path,
+                       (uint32_t)(admission_file_size_max() >> 20));
+                return -EFBIG;
+        }
+
+        GetExceptionInfo(&exception);
+
+        // name only hints format, detected from blob magic
+        info = CloneImageInfo(NULL);
+        strncpy(info->filename, path, sizeof(info->filename) - 1);
+
+        img = PingBlob(info, blob, len, &exception);
+        if (!img) {
+                pr_err("failed to read header of %s\n", path);
+                err = -EIO;
+                goto out;
+        }
+
+        err = admission_header_check(path, img->columns, img->rows, GetImageListLength(img),
+                                     img->magick, len, hint);
+
+        DestroyImageList(img);
+
+out:
+        DestroyImageInfo(info);
+        DestroyExceptionInfo(&exception);
+
+        return err;
+}
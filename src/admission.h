@@ -0,0 +1,48 @@
+#ifndef __TABLET_WALLPAPER_ADMISSION_H__
+#define __TABLET_WALLPAPER_ADMISSION_H__
+
+#include <stdint.h>
+
+#include <wand/magick_wand.h>
+
+#define ADMISSION_MEGAPIXELS_DEFAULT    256     // 16k x 16k
+#define ADMISSION_FILE_SIZE_DEFAULT     256     // MiB
+#define ADMISSION_FRAMES_DEFAULT        64
+#define ADMISSION_RATIO_DEFAULT         4096.0
+#define ADMISSION_RATIO_FROM            4       // ratio is judged above 1/4 of pixel limit
+#define ADMISSION_SCALE_SHIFT_MAX       3       // jpeg decodes at 1/2, 1/4, 1/8
+
+enum admission_oversize {
+        ADMISSION_OVERSIZE_DOWNSCALE = 0,       // reduce while decoding if format can
+        ADMISSION_OVERSIZE_REJECT,
+        NUM_ADMISSION_OVERSIZES,
+};
+
+extern char *admission_oversize_strs[];
+
+// per source limits, 0: use built-in default
+struct admission {
+        uint32_t        max_megapixels;         // per frame
+        uint32_t        max_file_size;          // MiB
+        uint32_t        max_frames;
+        double          max_ratio;              // decoded bytes per file byte
+        int             oversize;
+};
+
+extern struct admission admission_limits;
+
+// size hint for decoder, 0: decode at full size
+struct admission_hint {
+        uint32_t        width;
+        uint32_t        height;
+};
+
+int admission_file_check(const char *path, uint64_t *size);
+int admission_check(MagickWand *ping, const char *path, uint64_t file_size, struct admission_hint *hint);
+int admission_pixels_fit(const char *path, uint32_t *width, uint32_t *height);
+int admission_pixels_shift(const char *path, uint32_t width, uint32_t height, uint32_t shift_max,
+                           uint32_t *shift);
+int admission_ping(const char *path, struct admission_hint *hint);
+int admission_ping_blob(const char *path, const void *blob, size_t len, struct admission_hint *hint);
+
+#endif // __TABLET_WALLPAPER_ADMISSION_H__
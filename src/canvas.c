@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <wand/magick_wand.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "mem.h"
+#include "canvas.h"
+#include "pixel.h"
+
+int canvas_init(struct canvas *c, uint32_t width, uint32_t height)
+{
+        if (!width || !height)
+                return -EINVAL;
+
+        c->width = width;
+        c->height = height;
+        c->stride = ALIGN_UP((size_t)width * CANVAS_BPP, CANVAS_ROW_ALIGN);
+        c->pixels = mem_huge_alloc(c->stride * height, &c->large_page);
+        if (!c->pixels) {
+                pr_err("failed to allocate canvas %ux%u\n", width, height);
+                return -ENOMEM;
+        }
+
+        pr_dbg("canvas %ux%u stride %zu%s\n", width, height, c->stride,
+               c->large_page ? " (large pages)" : "");
+
+        return 0;
+}
+
+void canvas_deinit(struct canvas *c)
+{
+        if (c->pixels)
+                mem_huge_free(c->pixels);
+
+        memset(c, 0, sizeof(*c));
+}
+
+void canvas_fill(struct canvas *c, struct rectangle *r, uint32_t bgra)
+{
+        struct rectangle rc = *r;
+        const struct pixel_ops *ops = pixel_ops_get(PIXEL_BGRA32, 0);
+
+        if (canvas_rect_clip(c, &rc))
+                return;
+
+        for (uint32_t y = 0; y < rc.height; y++)
+                ops->fill(canvas_pixel(c, rc.x, rc.y + y), rc.width, bgra);
+}
+
+//
+// blend two canvases of same size into dst at (x, y), weight is in [0, 256]
+// where 0 gives @a and 256 gives @b
+//
+int canvas_lerp(struct canvas *dst, int32_t x, int32_t y,
+                struct canvas *a, struct canvas *b, uint32_t weight)
+{
+        struct rectangle rc = { .x = x, .y = y, .width = a->width, .height = a->height };
+
+        if (a->width != b->width || a->height != b->height)
+                return -EINVAL;
+
+        if (weight > 256)
+                weight = 256;
+
+        if (canvas_rect_clip(dst, &rc))
+                return 0;
+
+        for (uint32_t i = 0; i < rc.height; i++) {
+                int32_t sx = rc.x - x, sy = rc.y - y + i;
+
+                pixel_lerp_row(canvas_pixel(dst, rc.x, rc.y + i),
+                               canvas_pixel(a, sx, sy),
+                               canvas_pixel(b, sx, sy),
+                               (size_t)rc.width * CANVAS_BPP, weight);
+        }
+
+        return 0;
+}
+
+int canvas_rect_to_wand(struct canvas *c, struct rectangle *r, MagickWand **out)
+{
+        struct rectangle rc = *r;
+        MagickWand *w;
+        MagickPassFail status;
+        int err = 0;
+
+        if (canvas_rect_clip(c, &rc))
+                return -EINVAL;
+
+        w = NewMagickWand();
+
+        status = MagickSetSize(w, rc.width, rc.height);
+        if (status == MagickPass)
+                status = MagickReadImage(w, "xc:black");
+
+        if (status != MagickPass) {
+                err = -EFAULT;
+                goto out_err;
+        }
+
+        if (rc.x == 0 && rc.width == c->width && c->stride == (size_t)c->width * CANVAS_BPP) {
+                status = MagickSetImagePixels(w, 0, 0, rc.width, rc.height,
+                                              "BGRA", CharPixel, canvas_pixel(c, 0, rc.y));
+        } else {
+                for (uint32_t y = 0; y < rc.height && status == MagickPass; y++) {
+                        status = MagickSetImagePixels(w, 0, y, rc.width, 1, "BGRA",
+                                                      CharPixel, canvas_pixel(c, rc.x, rc.y + y));
+                }
+        }
+
+        if (status != MagickPass) {
+                err = -EFAULT;
+                goto out_err;
+        }
+
+        // canvas is always opaque, do not let encoder write alpha channel
+        MagickSetImageType(w, TrueColorType);
+
+        *out = w;
+
+        return 0;
+
+out_err:
+        DestroyMagickWand(w);
+
+        return err;
+}
+
+//
+// 8bit grey image of @r for monochrome panels, luma is taken from canvas and
+// dithered to @levels grey levels if set, encoders then write one channel
+//
+int canvas_rect_to_wand_grey(struct canvas *c, struct rectangle *r, uint32_t levels, MagickWand **out)
+{
+        struct rectangle rc = *r;
+        struct pixel_dither *dither = NULL;
+        uint8_t *row = NULL;
+        MagickWand *w;
+        MagickPassFail status;
+        int err = 0;
+
+        if (canvas_rect_clip(c, &rc))
+                return -EINVAL;
+
+        dither = malloc(sizeof(*dither));
+        row = malloc(rc.width);
+        if (!dither || !row) {
+                err = -ENOMEM;
+                goto out_free;
+        }
+
+        pixel_dither_init(dither, levels);
+
+        w = NewMagickWand();
+
+        status = MagickSetSize(w, rc.width, rc.height);
+        if (status == MagickPass)
+                status = MagickReadImage(w, "xc:black");
+
+        for (uint32_t y = 0; y < rc.height && status == MagickPass; y++) {
+                pixel_luma_row(row, canvas_pixel(c, rc.x, rc.y + y), rc.width);
+                pixel_dither_row(dither, row, rc.width, (uint32_t)rc.x, (uint32_t)(rc.y + y));
+                status = MagickSetImagePixels(w, 0, y, rc.width, 1, "I", CharPixel, row);
+        }
+
+        if (status == MagickPass)
+                status = MagickSetImageType(w, GrayscaleType);
+        if (status == MagickPass)
+                status = MagickSetImageDepth(w, 8);
+
+        if (status != MagickPass) {
+                DestroyMagickWand(w);
+                err = -EFAULT;
+                goto out_free;
+        }
+
+        *out = w;
+
+out_free:
+        if (row)
+                free(row);
+        if (dither)
+                free(dither);
+
+        return err;
+}
+
+int canvas_to_wand(struct canvas *c, MagickWand **out)
+{
+        struct rectangle r = { .x = 0, .y = 0, .width = c->width, .height = c->height };
+
+        return canvas_rect_to_wand(c, &r, out);
+}
+
+#define HASH_P1                         0x9e3779b185ebca87ULL
+#define HASH_P2                         0xc2b2ae3d27d4eb4fULL
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t v)
+{
+        acc += v * HASH_P2;
+        acc = (acc << 31) | (acc >> 33);
+
+        return acc * HASH_P1;
+}
+
+//
+// 64bit content fingerprint of @r to detect unchanged output, four
+// independent lanes keep multiplies pipelined, not cryptographic
+//
+uint64_t canvas_rect_hash(struct canvas *c, struct rectangle *r)
+{
+        uint64_t lane[4] = { HASH_P1, HASH_P2, ~HASH_P1, ~HASH_P2 };
+        struct rectangle rc = *r;
+        uint64_t h;
+
+        if (canvas_rect_clip(c, &rc))
+                return 0;
+
+        for (uint32_t y = 0; y < rc.height; y++) {
+                const uint8_t *p = canvas_pixel(c, rc.x, rc.y + y);
+                size_t n = (size_t)rc.width * CANVAS_BPP, i = 0;
+
+                for (; i + 32 <= n; i += 32) {
+                        uint64_t v[4];
+
+                        memcpy(v, &p[i], sizeof(v));
+
+                        for (int j = 0; j < 4; j++)
+                                lane[j] = hash_round(lane[j], v[j]);
+                }
+
+                for (; i < n; i += 8) {
+                        uint64_t v = 0;
+
+                        memcpy(&v, &p[i], min(n - i, (size_t)8));
+                        lane[0] = hash_round(lane[0], v);
+                }
+        }
+
+        h = ((uint64_t)rc.width << 32) | rc.height;
+
+        for (int j = 0; j < 4; j++)
+                h = hash_round(h, lane[j]);
+
+        return h;
+}
+
+int color_parse(const char *str, uint32_t *bgra)
+{
+        PixelWand *p;
+        uint32_t r, g, b;
+
+        if (!str || str[0] == '\0')
+                return -ENODATA;
+
+        p = NewPixelWand();
+
+        if (PixelSetColor(p, str) != MagickPass) {
+                pr_err("invalid color: \"%s\"\n", str);
+                DestroyPixelWand(p);
+                return -EINVAL;
+        }
+
+        r = (uint32_t)(PixelGetRed(p) * 255.0 + 0.5);
+        g = (uint32_t)(PixelGetGreen(p) * 255.0 + 0.5);
+        b = (uint32_t)(PixelGetBlue(p) * 255.0 + 0.5);
+
+        *bgra = 0xff000000U | (r << 16) | (g << 8) | b;
+
+        DestroyPixelWand(p);
+
+        return 0;
+}
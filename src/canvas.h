@@ -0,0 +1,76 @@
+#ifndef __TABLET_WALLPAPER_CANVAS_H__
+#define __TABLET_WALLPAPER_CANVAS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+
+#include <wand/magick_wand.h>
+
+struct rectangle {
+        int32_t x;
+        int32_t y;
+        uint32_t width;
+        uint32_t height;
+};
+
+//
+// raw 32bpp BGRA pixel buffer, which is the native layout of a windows DIB,
+// the whole virtual desktop is composed in here before being encoded
+//
+struct canvas {
+        uint8_t        *pixels;
+        uint32_t        width;
+        uint32_t        height;
+        size_t          stride;         // in bytes, multiple of CANVAS_ROW_ALIGN
+        uint32_t        large_page;
+};
+
+#define CANVAS_BPP                      4
+#define CANVAS_ROW_ALIGN                64
+
+static inline uint8_t *canvas_pixel(struct canvas *c, int32_t x, int32_t y)
+{
+        return c->pixels + (size_t)y * c->stride + (size_t)x * CANVAS_BPP;
+}
+
+// returns -ERANGE if nothing is left after clipping
+static inline int canvas_rect_clip(struct canvas *c, struct rectangle *r)
+{
+        int64_t x0 = r->x, y0 = r->y;
+        int64_t x1 = x0 + r->width, y1 = y0 + r->height;
+
+        if (x0 < 0)
+                x0 = 0;
+        if (y0 < 0)
+                y0 = 0;
+        if (x1 > c->width)
+                x1 = c->width;
+        if (y1 > c->height)
+                y1 = c->height;
+
+        if (x1 <= x0 || y1 <= y0)
+                return -ERANGE;
+
+        r->x = (int32_t)x0;
+        r->y = (int32_t)y0;
+        r->width = (uint32_t)(x1 - x0);
+        r->height = (uint32_t)(y1 - y0);
+
+        return 0;
+}
+
+int canvas_init(struct canvas *c, uint32_t width, uint32_t height);
+void canvas_deinit(struct canvas *c);
+
+void canvas_fill(struct canvas *c, struct rectangle *r, uint32_t bgra);
+int canvas_lerp(struct canvas *dst, int32_t x, int32_t y,
+                struct canvas *a, struct canvas *b, uint32_t weight);
+int canvas_rect_to_wand(struct canvas *c, struct rectangle *r, MagickWand **out);
+int canvas_rect_to_wand_grey(struct canvas *c, struct rectangle *r, uint32_t levels, MagickWand **out);
+int canvas_to_wand(struct canvas *c, MagickWand **out);
+uint64_t canvas_rect_hash(struct canvas *c, struct rectangle *r);
+
+int color_parse(const char *str, uint32_t *bgra);
+
+#endif // __TABLET_WALLPAPER_CANVAS_H__
@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#include <wand/magick_wand.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "admission.h"
+#include "canvas.h"
+#include "pixel.h"
+#include "plan.h"
+#include "prof.h"
+#include "worker.h"
+#include "source_io.h"
+#include "collage.h"
+
+#define COLLAGE_COUNT_MAX               256
+#define COLLAGE_ROWS_SEARCH_STEPS       256
+
+char *collage_layout_strs[] = {
+        [COLLAGE_LAYOUT_GRID]           = "grid",
+        [COLLAGE_LAYOUT_ROWS]           = "rows",
+};
+
+static const char *collage_exts[] = {
+        ".jpg", ".jpeg", ".png", ".bmp", ".gif", ".tif", ".tiff", ".webp",
+};
+
+struct collage_item {
+        char           *path;           // not owned
+        uint32_t        width;          // source size from header
+        uint32_t        height;
+        struct rectangle cell;          // canvas coordinate
+        struct admission_hint hint;     // forced reduction of oversize source
+        uint64_t        cost;           // predicted, in us
+        int             err;
+};
+
+struct collage_job {
+        struct canvas          *canvas;
+        struct rectangle       *clip;
+        struct collage_item    *items;
+};
+
+static int collage_path_is_image(const char *path)
+{
+        const char *ext = strrchr(path, '.');
+
+        if (!ext)
+                return 0;
+
+        for (size_t i = 0; i < ARRAY_SIZE(collage_exts); i++) {
+                if (!strcasecmp(ext, collage_exts[i]))
+                        return 1;
+        }
+
+        return 0;
+}
+
+// only read headers, dimensions are all the layout needs
+static void collage_ping_job(void *arg, size_t idx)
+{
+        struct collage_item *it = &((struct collage_item *)arg)[idx];
+        uint64_t file_size = 0;
+        MagickWand *w;
+
+        if ((it->err = admission_file_check(it->path, &file_size)))
+                return;
+
+        w = NewMagickWand();
+
+        if (MagickPingImage(w, it->path) != MagickPass) {
+                it->err = -EIO;
+                goto out;
+        }
+
+        it->width = MagickGetImageWidth(w);
+        it->height = MagickGetImageHeight(w);
+        it->err = admission_check(w, it->path, file_size, &it->hint);
+
+out:
+        DestroyMagickWand(w);
+}
+
+static int collage_item_cost_cmp(const void *a, const void *b)
+{
+        const struct collage_item *ia = a, *ib = b;
+
+        return (ia->cost < ib->cost) - (ia->cost > ib->cost);
+}
+
+static double collage_item_aspect(struct collage_item *it)
+{
+        return (double)it->width / it->height;
+}
+
+// largest rectangle of item aspect inside @box, centered
+static void collage_item_fit(struct collage_item *it, struct rectangle *box)
+{
+        double sx = (double)box->width / it->width;
+        double sy = (double)box->height / it->height;
+        double s = sx < sy ? sx : sy;
+
+        it->cell.width = max(1U, (uint32_t)(it->width * s));
+        it->cell.height = max(1U, (uint32_t)(it->height * s));
+        it->cell.x = box->x + (int32_t)((box->width - it->cell.width) / 2);
+        it->cell.y = box->y + (int32_t)((box->height - it->cell.height) / 2);
+}
+
+//
+// uniform cells, pick column count which leaves least area uncovered
+// after fitting every image into its cell
+//
+static void collage_grid_layout(struct collage_item *items, size_t n, struct rectangle *r, uint32_t gap)
+{
+        uint32_t best_cols = 1;
+        double best_area = -1.0;
+        uint32_t cols, rows, cw, ch;
+
+        for (cols = 1; cols <= n; cols++) {
+                double area = 0.0;
+
+                rows = (uint32_t)((n + cols - 1) / cols);
+
+                if ((uint64_t)gap * (cols + 1) + cols > r->width ||
+                    (uint64_t)gap * (rows + 1) + rows > r->height)
+                        continue;
+
+                cw = (r->width - gap * (cols + 1)) / cols;
+                ch = (r->height - gap * (rows + 1)) / rows;
+
+                for (size_t i = 0; i < n; i++) {
+                        double s = (double)cw / items[i].width;
+
+                        if ((double)ch / items[i].height < s)
+                                s = (double)ch / items[i].height;
+
+                        area += items[i].width * s * items[i].height * s;
+                }
+
+                if (area > best_area) {
+                        best_area = area;
+                        best_cols = cols;
+                }
+        }
+
+        cols = best_cols;
+        rows = (uint32_t)((n + cols - 1) / cols);
+        cw = max(1U, (r->width - min(r->width, gap * (cols + 1))) / cols);
+        ch = max(1U, (r->height - min(r->height, gap * (rows + 1))) / rows);
+
+        for (size_t i = 0; i < n; i++) {
+                uint32_t col = (uint32_t)(i % cols), row = (uint32_t)(i / cols);
+                uint32_t in_row = (uint32_t)min((size_t)cols, n - (size_t)row * cols);
+                // center incomplete last row
+                uint32_t off = (cols - in_row) * (cw + gap) / 2;
+                struct rectangle box = {
+                        .x = r->x + (int32_t)(off + gap + col * (cw + gap)),
+                        .y = r->y + (int32_t)(gap + row * (ch + gap)),
+                        .width = cw,
+                        .height = ch,
+                };
+
+                collage_item_fit(&items[i], &box);
+        }
+}
+
+//
+// greedy justified rows of target height @h: images are appended until the
+// row overflows width, then row is scaled down to fit exactly, incomplete
+// last row keeps @h, returns total height, cells are only written if @assign
+//
+static double collage_rows_pack(struct collage_item *items, size_t n, struct rectangle *r,
+                                uint32_t gap, double h, int32_t y0, int assign)
+{
+        double y = gap;
+        size_t i = 0;
+
+        while (i < n) {
+                double aspect = 0.0, avail, row_h, x;
+                size_t j = i;
+
+                do {
+                        aspect += collage_item_aspect(&items[j++]);
+                } while (j < n && aspect * h + (double)gap * (j - i + 1) < r->width);
+
+                avail = (double)r->width - (double)gap * (j - i + 1);
+                if (avail < 1.0)
+                        avail = 1.0;
+
+                row_h = avail / aspect;
+                x = gap;
+
+                if (j == n && row_h > h) {
+                        row_h = h;
+                        x += (avail - aspect * h) / 2.0;
+                }
+
+                for (size_t k = i; assign && k < j; k++) {
+                        double w = collage_item_aspect(&items[k]) * row_h;
+
+                        items[k].cell = (struct rectangle){
+                                .x = r->x + (int32_t)x,
+                                .y = r->y + y0 + (int32_t)y,
+                                .width = max(1U, (uint32_t)w),
+                                .height = max(1U, (uint32_t)row_h),
+                        };
+
+                        x += w + gap;
+                }
+
+                y += row_h + gap;
+                i = j;
+        }
+
+        return y;
+}
+
+static void collage_rows_layout(struct collage_item *items, size_t n, struct rectangle *r, uint32_t gap)
+{
+        double best_h = 1.0, best_total = 0.0;
+
+        // total height is not monotonic in target row height, scan candidates
+        // and keep the one filling most of monitor height
+        for (int i = 1; i <= COLLAGE_ROWS_SEARCH_STEPS; i++) {
+                double h = (double)r->height * i / COLLAGE_ROWS_SEARCH_STEPS;
+                double total = collage_rows_pack(items, n, r, gap, h, 0, 0);
+
+                if (total <= r->height && total > best_total) {
+                        best_total = total;
+                        best_h = h;
+                }
+        }
+
+        if (best_total == 0.0)
+                best_total = collage_rows_pack(items, n, r, gap, best_h, 0, 0);
+
+        collage_rows_pack(items, n, r, gap, best_h, (int32_t)((r->height - best_total) / 2.0), 1);
+}
+
+//
+// decode at reduced size, decoders like jpeg scale down while decoding
+// when size hint is set, then resample straight into cell of canvas,
+// cells do not overlap so jobs write canvas concurrently
+//
+static void collage_render_job(void *arg, size_t idx)
+{
+        struct collage_job *job = arg;
+        struct collage_item *it = &job->items[idx];
+        struct pixel_image img = { 0 };
+        MagickWand *w = NewMagickWand();
+
+        // cell larger than admitted reduction would decode over limit
+        if (it->hint.width && (it->cell.width > it->hint.width || it->cell.height > it->hint.height))
+                MagickSetSize(w, it->hint.width, it->hint.height);
+        else
+                MagickSetSize(w, it->cell.width, it->cell.height);
+
+        if (MagickReadImage(w, it->path) != MagickPass) {
+                pr_err("failed to open collage image: %s\n", it->path);
+                it->err = -EIO;
+                DestroyMagickWand(w);
+                return;
+        }
+
+        it->err = pixel_image_from_wand(&img, w);
+        DestroyMagickWand(w);
+
+        if (it->err)
+                return;
+
+        it->err = pixel_resample(job->canvas, job->clip, &it->cell, &img);
+
+        pixel_image_free(&img);
+}
+
+int collage_render(struct canvas *c, struct rectangle *r, const char *dir,
+                   struct collage *cfg, uint32_t bg)
+{
+        struct collage_item *items = NULL;
+        struct collage_job job = { .canvas = c, .clip = r };
+        uint32_t count = cfg->count ? min(cfg->count, (uint32_t)COLLAGE_COUNT_MAX) : COLLAGE_COUNT_MAX;
+        uint32_t gap = cfg->gap;
+        uint64_t ts = prof_usec_now();
+        char **paths = NULL;
+        size_t n = 0, cnt = 0, kept = 0, failed = 0;
+        int err;
+
+        if (!dir || dir[0] == '\0') {
+                pr_err("collage directory is not defined\n");
+                return -ENODATA;
+        }
+
+        if ((err = source_dir_list(dir, 0, &paths, &cnt))) {
+                pr_err("failed to list collage directory: %s\n", dir);
+                return err;
+        }
+
+        items = calloc(max(cnt, (size_t)1), sizeof(*items));
+        if (!items) {
+                err = -ENOMEM;
+                goto out;
+        }
+
+        for (size_t i = 0; i < cnt && n < count; i++) {
+                if (collage_path_is_image(paths[i]))
+                        items[n++].path = paths[i];
+        }
+
+        worker_run(n, collage_ping_job, items);
+
+        // drop unreadable ones, keep name order
+        for (size_t i = 0; i < n; i++) {
+                if (items[i].err) {
+                        pr_err("skip collage image: %s\n", items[i].path);
+                        continue;
+                }
+
+                items[kept++] = items[i];
+        }
+
+        n = kept;
+
+        canvas_fill(c, r, bg);
+
+        if (!n) {
+                pr_err("no image found in collage directory: %s\n", dir);
+                err = -ENODATA;
+                goto out;
+        }
+
+        // gaps should not eat up the whole monitor
+        if ((uint64_t)gap * 4 >= min(r->width, r->height))
+                gap = 0;
+
+        if (cfg->layout == COLLAGE_LAYOUT_ROWS)
+                collage_rows_layout(items, n, r, gap);
+        else
+                collage_grid_layout(items, n, r, gap);
+
+        // cells are placed, start the most expensive ones first so a large
+        // png does not become the tail of the pool
+        for (size_t i = 0; i < n; i++) {
+                items[i].cost = plan_cost_usec(PLAN_OP_DECODE, (uint64_t)items[i].width * items[i].height) +
+                                plan_cost_usec(PLAN_OP_RESAMPLE, (uint64_t)items[i].cell.width * items[i].cell.height);
+        }
+
+        qsort(items, n, sizeof(*items), collage_item_cost_cmp);
+
+        job.items = items;
+        worker_run(n, collage_render_job, &job);
+
+        for (size_t i = 0; i < n; i++) {
+                if (items[i].err)
+                        failed++;
+        }
+
+        pr_info("collage %zu images (%zu failed) in %llu us\n",
+                n, failed, (unsigned long long)(prof_usec_now() - ts));
+
+out:
+        if (items)
+                free(items);
+
+        source_dir_list_free(paths, cnt);
+
+        return err;
+}
@@ -0,0 +1,25 @@
+#ifndef __TABLET_WALLPAPER_COLLAGE_H__
+#define __TABLET_WALLPAPER_COLLAGE_H__
+
+#include <stdint.h>
+
+#include "canvas.h"
+
+enum collage_layout {
+        COLLAGE_LAYOUT_GRID = 0,
+        COLLAGE_LAYOUT_ROWS,            // justified rows, images keep aspect ratio
+        NUM_COLLAGE_LAYOUTS,
+};
+
+extern char *collage_layout_strs[];
+
+struct collage {
+        int             layout;
+        uint32_t        count;          // max images taken from directory, 0: all
+        uint32_t        gap;            // pixels between and around cells
+};
+
+int collage_render(struct canvas *c, struct rectangle *r, const char *dir,
+                   struct collage *cfg, uint32_t bg);
+
+#endif // __TABLET_WALLPAPER_COLLAGE_H__
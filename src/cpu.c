@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include <windows.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "cpu.h"
+
+#ifndef PF_ARM_NEON_INSTRUCTIONS_AVAILABLE
+#define PF_ARM_NEON_INSTRUCTIONS_AVAILABLE      19
+#endif
+
+char *cpu_simd_strs[] = {
+        [CPU_SIMD_NONE]         = "scalar",
+        [CPU_SIMD_SSE2]         = "sse2",
+        [CPU_SIMD_NEON]         = "neon",
+};
+
+// whether kernel set is built in and running cpu reports it, cpuid on x86
+int cpu_simd_supported(int simd)
+{
+        switch (simd) {
+        case CPU_SIMD_NONE:
+                return 1;
+
+#ifdef HAVE_SIMD_SSE2
+        case CPU_SIMD_SSE2:
+                __builtin_cpu_init();
+
+                return __builtin_cpu_supports("sse2");
+#endif
+
+#ifdef HAVE_SIMD_NEON
+        case CPU_SIMD_NEON:
+                return IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE);
+#endif
+
+        default:
+                break;
+        }
+
+        return 0;
+}
+
+//
+// kernel set picked by "auto", neon kernels are only checked against the
+// scalar ones for identical output and have not been timed on hardware,
+// so they are left to explicit "simd": "neon"
+//
+int cpu_simd_detect(void)
+{
+        if (cpu_simd_supported(CPU_SIMD_SSE2))
+                return CPU_SIMD_SSE2;
+
+        return CPU_SIMD_NONE;
+}
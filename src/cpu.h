@@ -0,0 +1,32 @@
+#ifndef __TABLET_WALLPAPER_CPU_H__
+#define __TABLET_WALLPAPER_CPU_H__
+
+//
+// vector kernels are only compiled when the target baseline has the
+// instruction set (SSE2 on x86-64, NEON on AArch64), the running cpu is
+// still asked before a kernel set is picked
+//
+// neon kernels also need WITH_NEON, they are vetted by tests/pixel_test
+// under qemu-aarch64 in ci only, not on hardware
+//
+#if defined(__SSE2__)
+#define HAVE_SIMD_SSE2                  1
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON) && defined(WITH_NEON)
+#define HAVE_SIMD_NEON                  1
+#endif
+
+enum cpu_simd {
+        CPU_SIMD_NONE = 0,              // scalar reference kernels
+        CPU_SIMD_SSE2,
+        CPU_SIMD_NEON,
+        NUM_CPU_SIMDS,
+};
+
+extern char *cpu_simd_strs[];
+
+int cpu_simd_supported(int simd);
+int cpu_simd_detect(void);
+
+#endif // __TABLET_WALLPAPER_CPU_H__
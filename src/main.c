@@ -3,10 +3,12 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 
 #include <windows.h>
 #include <winuser.h>
 #include <wingdi.h>
+#include <wtsapi32.h>
 
 #include <wand/magick_wand.h>
 
@@ -16,12 +18,37 @@
 #include <libjj/iconv.h>
 #include <libjj/opts.h>
 
+#include "admission.h"
+#include "canvas.h"
+#include "collage.h"
+#include "cpu.h"
+#include "overlay.h"
+#include "pixel.h"
+#include "plan.h"
+#include "procedural.h"
+#include "prof.h"
+#include "schedule.h"
+#include "source_io.h"
+#include "vector.h"
+#include "video.h"
+#include "visibility.h"
+#include "worker.h"
+
 #define DEFAULT_OUTPUT_FMT              "bmp"
 #define DEFAULT_JSON_PATH               "config.json"
 #define DEFAULT_WORK_PATH               "."
 #define DEFAULT_BG_COLOR                "#000000"
 
 #define MONITOR_COUNT_MAX               8
+#define SOURCE_PREFETCH_BYTES_MAX       (256ULL << 20)  // held at once, rest is read by decoder
+#define OVERLAY_COUNT_MAX               16
+
+#define SCHEDULE_TIMER_ID               1
+#define SCHEDULE_TIMER_INTERVAL_MS      (60 * 1000)
+#define DEFAULT_SCHEDULE_DAWN           "07:00"
+#define DEFAULT_SCHEDULE_DUSK           "19:00"
+#define DEFAULT_SCHEDULE_TRANSITION     60              // minutes
+#define DEFAULT_SCHEDULE_STEP           1.0             // delta L*, about a just noticeable difference
 
 enum wallpaper_style {
         WALLPAPER_STYLE_FIT = 0,
@@ -31,6 +58,8 @@ enum wallpaper_style {
         WALLPAPER_STYLE_STRETCH,
         WALLPAPER_STYLE_TILE,
         WALLPAPER_STYLE_CENTER,
+        WALLPAPER_STYLE_COLLAGE,        // source path is a directory
+        WALLPAPER_STYLE_INTEGER_SCALE,
         NUM_WALLPAPER_STYLES,
 };
 
@@ -50,23 +79,59 @@ enum wallpaper_orientation {
         NUM_WALLPAPAER_ORIENTS,
 };
 
+enum wallpaper_source_type {
+        WALLPAPER_SOURCE_IMAGE = 0,
+        WALLPAPER_SOURCE_PROCEDURAL,
+        WALLPAPER_SOURCE_SCHEDULE,
+        WALLPAPER_SOURCE_VIDEO,         // still frame of a video file
+        NUM_WALLPAPER_SOURCE_TYPES,
+};
+
+enum output_mode {
+        OUTPUT_MODE_DESKTOP = 0,        // one composed file set as desktop wallpaper
+        OUTPUT_MODE_MONITORS,           // one file per monitor, e.g. for video walls
+        OUTPUT_MODE_BOTH,
+        NUM_OUTPUT_MODES,
+};
+
+enum simd_mode {
+        SIMD_MODE_AUTO = 0,
+        SIMD_MODE_SCALAR,
+        SIMD_MODE_NEON,
+        NUM_SIMD_MODES,
+};
+
 char *wallpaper_style_strs[] = {
         [WALLPAPER_STYLE_FIT]           = "fit_no_cut",
         [WALLPAPER_STYLE_FIT_EDGE_CUT]  = "fit_edge_cut",
         [WALLPAPER_STYLE_STRETCH]       = "stretch",
         [WALLPAPER_STYLE_TILE]          = "tile",
         [WALLPAPER_STYLE_CENTER]        = "center",
+        [WALLPAPER_STYLE_COLLAGE]       = "collage",
+        [WALLPAPER_STYLE_INTEGER_SCALE] = "integer_scale",
 };
 
-struct line {
-        int32_t s, e;
+char *wallpaper_source_type_strs[] = {
+        [WALLPAPER_SOURCE_IMAGE]        = "image",
+        [WALLPAPER_SOURCE_PROCEDURAL]   = "procedural",
+        [WALLPAPER_SOURCE_SCHEDULE]     = "schedule",
+        [WALLPAPER_SOURCE_VIDEO]        = "video",
+};
+
+char *output_mode_strs[] = {
+        [OUTPUT_MODE_DESKTOP]           = "desktop",
+        [OUTPUT_MODE_MONITORS]          = "monitors",
+        [OUTPUT_MODE_BOTH]              = "both",
 };
 
-struct rectangle {
-        int32_t x;
-        int32_t y;
-        uint32_t width;
-        uint32_t height;
+char *simd_mode_strs[] = {
+        [SIMD_MODE_AUTO]                = "auto",
+        [SIMD_MODE_SCALAR]              = "scalar",
+        [SIMD_MODE_NEON]                = "neon",
+};
+
+struct line {
+        int32_t s, e;
 };
 
 struct monitor {
@@ -91,8 +156,41 @@ struct monitor {
                 uint32_t        auto_rotate;
                 int             style;
                 char           *bg_color;
+                int             source_type;
                 char           *files[NUM_WALLPAPAER_ORIENTS];
+                char           *night_files[NUM_WALLPAPAER_ORIENTS];
+                struct procedural procedural;
+                struct collage  collage;
+                struct video    video;
+                uint32_t        greyscale;      // monochrome or e-ink panel
+                uint32_t        grey_levels;    // dither output to, 0: 256
+
+                struct {
+                        char           *keyframes;      // "HH:MM=night%, ...", replaces dawn and dusk
+                        char           *dawn;           // "HH:MM", night fades out from here
+                        char           *dusk;           // "HH:MM", night fades in from here
+                        uint32_t        transition;     // minutes
+                        double          step;           // minimal lightness change (delta L*) to re-apply
+                } schedule;
         } wallpaper;
+
+        // cached day/night endpoint renders of schedule source
+        struct {
+                struct canvas   endpoints[2];
+                char           *paths[2];       // rendered from
+                uint64_t        mtimes[2];      // of paths when rendered
+                double          contrast;       // mean delta L* between endpoints
+                uint32_t        orient;
+                int32_t         weight;         // last applied, -1: none
+        } blend;
+
+        uint64_t        video_slot;     // of frame last rendered
+
+        // per monitor output file
+        struct {
+                char            path[PATH_MAX];
+                uint64_t        fingerprint;    // of last written content
+        } output;
 };
 
 // y axi of virtual desktop is inverted:
@@ -107,18 +205,40 @@ struct config {
         char output_fmt[5];
         char workdir[PATH_MAX];
         char json_path[PATH_MAX];
+        struct procedural background;   // fills gaps of virtual desktop
+        int output_mode;
+        int simd_mode;
+        int upscale;
+        double upscale_sharpen;
+        uint32_t linear_light;
+        uint32_t explain;
 };
 
 static struct config g_config = {
         .json_path = DEFAULT_JSON_PATH,
+        .upscale_sharpen = RESAMPLE_UPSCALE_SHARPEN_DEFAULT,
 };
 
 static struct monitor monitors[MONITOR_COUNT_MAX];
+static struct overlay overlays[OVERLAY_COUNT_MAX];
+static struct canvas desktop_canvas;
+static struct visibility visibility;
+static HPOWERNOTIFY display_state_notify;
+
+// GUID_CONSOLE_DISPLAY_STATE, defined here to not depend on uuid import lib
+static const GUID display_state_guid = {
+        0x6fe69556, 0x704a, 0x47a0, { 0x8f, 0x24, 0xc2, 0x8d, 0x93, 0x6f, 0xda, 0x47 },
+};
+
+static struct source_blob source_prefetched[MONITOR_COUNT_MAX * 2];
+static size_t source_prefetched_cnt;
+static uint64_t source_prefetched_bytes;
 static jbuf_t jbuf_usrcfg;
 static char out_path[PATH_MAX] = { 0 };
 static wchar_t out_path_w[PATH_MAX] = { 0 };
 
 lsopt_strbuf(c, json_path, g_config.json_path, sizeof(g_config.json_path), "JSON config path");
+lopt_noarg_simple(explain, g_config.explain, "print render plan without rendering");
 
 static uint32_t dmdo_to_orien[] = {
         [DMDO_DEFAULT]  = ORIENT_0,
@@ -158,13 +278,69 @@ static int usrcfg_root_key_create(jbuf_t *b)
                                                        wallpaper_style_strs,
                                                        ARRAY_SIZE(wallpaper_style_strs));
                                 jbuf_offset_add(b, strptr, "bg_color", offsetof(struct monitor, wallpaper.bg_color));
+                                jbuf_offset_add(b, bool, "greyscale", offsetof(struct monitor, wallpaper.greyscale));
+                                jbuf_offset_add(b, uint32, "grey_levels", offsetof(struct monitor, wallpaper.grey_levels));
 
                                 void *source_obj = jbuf_offset_obj_open(b, "source", 0);
 
+                                jbuf_offset_strval_add(b, "type",
+                                                       offsetof(struct monitor, wallpaper.source_type),
+                                                       wallpaper_source_type_strs,
+                                                       ARRAY_SIZE(wallpaper_source_type_strs));
                                 jbuf_offset_add(b, strptr, "landscape", offsetof(struct monitor, wallpaper.files[WALLPAPER_LANDSCAPE]));
                                 jbuf_offset_add(b, strptr, "portrait", offsetof(struct monitor, wallpaper.files[WALLPAPER_PORTRAIT]));
 
                                 jbuf_obj_close(b, source_obj);
+
+                                void *night_obj = jbuf_offset_obj_open(b, "night_source", 0);
+
+                                jbuf_offset_add(b, strptr, "landscape", offsetof(struct monitor, wallpaper.night_files[WALLPAPER_LANDSCAPE]));
+                                jbuf_offset_add(b, strptr, "portrait", offsetof(struct monitor, wallpaper.night_files[WALLPAPER_PORTRAIT]));
+
+                                jbuf_obj_close(b, night_obj);
+
+                                void *schedule_obj = jbuf_offset_obj_open(b, "schedule", 0);
+
+                                jbuf_offset_add(b, strptr, "keyframes", offsetof(struct monitor, wallpaper.schedule.keyframes));
+                                jbuf_offset_add(b, strptr, "dawn", offsetof(struct monitor, wallpaper.schedule.dawn));
+                                jbuf_offset_add(b, strptr, "dusk", offsetof(struct monitor, wallpaper.schedule.dusk));
+                                jbuf_offset_add(b, uint32, "transition", offsetof(struct monitor, wallpaper.schedule.transition));
+                                jbuf_offset_add(b, double, "step", offsetof(struct monitor, wallpaper.schedule.step));
+
+                                jbuf_obj_close(b, schedule_obj);
+
+                                void *procedural_obj = jbuf_offset_obj_open(b, "procedural", 0);
+
+                                jbuf_offset_strval_add(b, "pattern",
+                                                       offsetof(struct monitor, wallpaper.procedural.pattern),
+                                                       procedural_pattern_strs,
+                                                       NUM_PROCEDURAL_PATTERNS);
+                                jbuf_offset_add(b, strptr, "color1", offsetof(struct monitor, wallpaper.procedural.colors[0]));
+                                jbuf_offset_add(b, strptr, "color2", offsetof(struct monitor, wallpaper.procedural.colors[1]));
+                                jbuf_offset_add(b, double, "angle", offsetof(struct monitor, wallpaper.procedural.angle));
+                                jbuf_offset_add(b, uint32, "size", offsetof(struct monitor, wallpaper.procedural.size));
+                                jbuf_offset_add(b, bool, "dither", offsetof(struct monitor, wallpaper.procedural.dither));
+
+                                jbuf_obj_close(b, procedural_obj);
+
+                                void *collage_obj = jbuf_offset_obj_open(b, "collage", 0);
+
+                                jbuf_offset_strval_add(b, "layout",
+                                                       offsetof(struct monitor, wallpaper.collage.layout),
+                                                       collage_layout_strs,
+                                                       NUM_COLLAGE_LAYOUTS);
+                                jbuf_offset_add(b, uint32, "count", offsetof(struct monitor, wallpaper.collage.count));
+                                jbuf_offset_add(b, uint32, "gap", offsetof(struct monitor, wallpaper.collage.gap));
+
+                                jbuf_obj_close(b, collage_obj);
+
+                                void *video_obj = jbuf_offset_obj_open(b, "video", 0);
+
+                                jbuf_offset_add(b, double, "position", offsetof(struct monitor, wallpaper.video.position));
+                                jbuf_offset_add(b, double, "step", offsetof(struct monitor, wallpaper.video.step));
+                                jbuf_offset_add(b, uint32, "refresh", offsetof(struct monitor, wallpaper.video.refresh));
+
+                                jbuf_obj_close(b, video_obj);
                         }
 
                         jbuf_obj_close(b, wallpaper_obj);
@@ -173,11 +349,68 @@ static int usrcfg_root_key_create(jbuf_t *b)
                 jbuf_obj_close(b, monitor_obj);
                 jbuf_arr_close(b, monitor_arr);
 
+                void *overlay_arr = jbuf_fixed_arr_open(b, "overlay");
+
+                jbuf_fixed_arr_setup(b, overlay_arr,
+                                     overlays,
+                                     ARRAY_SIZE(overlays),
+                                     sizeof(overlays[0]));
+                void *overlay_obj = jbuf_offset_obj_open(b, NULL, 0);
+
+                {
+                        jbuf_offset_add(b, int32, "monitor", offsetof(struct overlay, monitor));
+                        jbuf_offset_add(b, strptr, "image", offsetof(struct overlay, image));
+                        jbuf_offset_strval_add(b, "anchor",
+                                               offsetof(struct overlay, anchor),
+                                               overlay_anchor_strs,
+                                               NUM_OVERLAY_ANCHORS);
+                        jbuf_offset_add(b, int32, "offset_x", offsetof(struct overlay, offset_x));
+                        jbuf_offset_add(b, int32, "offset_y", offsetof(struct overlay, offset_y));
+                        jbuf_offset_add(b, double, "opacity", offsetof(struct overlay, opacity));
+                }
+
+                jbuf_obj_close(b, overlay_obj);
+                jbuf_arr_close(b, overlay_arr);
+
                 void *settings_obj = jbuf_obj_open(b, "settings");
 
                 {
                         jbuf_strbuf_add(b, "output_format", g_config.output_fmt, sizeof(g_config.output_fmt));
                         jbuf_strbuf_add(b, "workdir", g_config.workdir, sizeof(g_config.workdir));
+                        jbuf_strval_add(b, "output_mode", &g_config.output_mode, output_mode_strs, NUM_OUTPUT_MODES);
+                        jbuf_bool_add(b, "profile", &prof_enabled);
+                        jbuf_strval_add(b, "simd", &g_config.simd_mode, simd_mode_strs, NUM_SIMD_MODES);
+                        jbuf_strval_add(b, "upscale", &g_config.upscale, resample_upscale_strs, NUM_RESAMPLE_UPSCALES);
+                        jbuf_double_add(b, "upscale_sharpen", &g_config.upscale_sharpen);
+                        jbuf_bool_add(b, "linear_light", &g_config.linear_light);
+
+                        void *background_obj = jbuf_obj_open(b, "background");
+
+                        jbuf_strval_add(b, "pattern", &g_config.background.pattern, procedural_pattern_strs, NUM_PROCEDURAL_PATTERNS);
+                        jbuf_strptr_add(b, "color1", &g_config.background.colors[0]);
+                        jbuf_strptr_add(b, "color2", &g_config.background.colors[1]);
+                        jbuf_double_add(b, "angle", &g_config.background.angle);
+                        jbuf_u32_add(b, "size", &g_config.background.size);
+                        jbuf_bool_add(b, "dither", &g_config.background.dither);
+
+                        jbuf_obj_close(b, background_obj);
+
+                        void *cost_obj = jbuf_obj_open(b, "cost_model");
+
+                        for (size_t i = 0; i < NUM_PLAN_OPS; i++)
+                                jbuf_double_add(b, plan_op_strs[i], &plan_cost_ns[i]);
+
+                        jbuf_obj_close(b, cost_obj);
+
+                        void *admission_obj = jbuf_obj_open(b, "admission");
+
+                        jbuf_u32_add(b, "max_megapixels", &admission_limits.max_megapixels);
+                        jbuf_u32_add(b, "max_file_size", &admission_limits.max_file_size);
+                        jbuf_u32_add(b, "max_frames", &admission_limits.max_frames);
+                        jbuf_double_add(b, "max_ratio", &admission_limits.max_ratio);
+                        jbuf_strval_add(b, "oversize", &admission_limits.oversize, admission_oversize_strs, NUM_ADMISSION_OVERSIZES);
+
+                        jbuf_obj_close(b, admission_obj);
                 }
 
                 jbuf_obj_close(b, settings_obj);
@@ -196,6 +429,12 @@ static int usrcfg_init(void)
         if ((err = usrcfg_root_key_create(jbuf)))
                 return err;
 
+        // overlay without "monitor" key goes on all monitors, without "opacity" is opaque
+        for (size_t i = 0; i < ARRAY_SIZE(overlays); i++) {
+                overlays[i].monitor = -1;
+                overlays[i].opacity = -1.0;
+        }
+
         pr_info("json config: %s\n", g_config.json_path);
 
         if ((err = jbuf_load(jbuf, g_config.json_path)))
@@ -471,391 +710,1576 @@ static int virtual_desktop_position_reposition(void)
         return 0;
 }
 
-static int wallpaper_style_fit_apply(struct monitor *m, MagickWand *w)
+//
+// styles place source image into monitor area of canvas with built-in
+// pixel kernels, @rect is the monitor area in canvas coordinate
+//
+struct render_target {
+        struct canvas          *canvas;
+        struct rectangle        rect;
+        uint32_t                bg;
+};
+
+// fill bg where @dst does not cover, or all of it if image has alpha
+static void render_target_bg_fill(struct render_target *t, struct rectangle *dst, struct pixel_image *img)
 {
-        MagickPassFail status = MagickPass;
-        uint32_t pic_width, pic_height;
-        uint32_t mon_width, mon_height;
-        double scale, mon_aspect, pic_aspect;
-        const int FIT_WIDTH = 0, FIT_HEIGHT = 1;
-        int style;
-
-        mon_width = m->info.width;
-        mon_height = m->info.height;
-        pic_width = MagickGetImageWidth(w);
-        pic_height = MagickGetImageHeight(w);
-        mon_aspect = (double)mon_width / mon_height;
-        pic_aspect = (double)pic_width / pic_height;
-
-        if (pic_aspect > mon_aspect) {
-                style = FIT_WIDTH;
-                scale = (double)pic_width / m->info.width;
-        } else {
-                style = FIT_HEIGHT;
-                scale = (double)pic_height / m->info.height;
+        struct rectangle *r = &t->rect;
+        int64_t x0 = max((int64_t)dst->x, (int64_t)r->x);
+        int64_t y0 = max((int64_t)dst->y, (int64_t)r->y);
+        int64_t x1 = min((int64_t)dst->x + dst->width, (int64_t)r->x + r->width);
+        int64_t y1 = min((int64_t)dst->y + dst->height, (int64_t)r->y + r->height);
+
+        if (img->alpha || x1 <= x0 || y1 <= y0) {
+                canvas_fill(t->canvas, r, t->bg);
+                return;
         }
 
-        pr_info("fit %s\n", style == FIT_WIDTH ? "width" : "height");
+        // top, bottom, left, right
+        canvas_fill(t->canvas, &(struct rectangle){ r->x, r->y, r->width, (uint32_t)(y0 - r->y) }, t->bg);
+        canvas_fill(t->canvas, &(struct rectangle){ r->x, (int32_t)y1, r->width, (uint32_t)(r->y + r->height - y1) }, t->bg);
+        canvas_fill(t->canvas, &(struct rectangle){ r->x, (int32_t)y0, (uint32_t)(x0 - r->x), (uint32_t)(y1 - y0) }, t->bg);
+        canvas_fill(t->canvas, &(struct rectangle){ (int32_t)x1, (int32_t)y0, (uint32_t)(r->x + r->width - x1), (uint32_t)(y1 - y0) }, t->bg);
+}
 
-        status = MagickScaleImage(w, (unsigned long)(pic_width / scale), (unsigned long)(pic_height / scale));
-        if (status != MagickPass)
-                return -EFAULT;
+//
+// where the scaled source lands in monitor area @mon, shared by styles and
+// render planner, tile covers the whole monitor with copies of the source
+//
+static void wallpaper_style_geometry(int style, struct rectangle *mon,
+                                     uint32_t pic_width, uint32_t pic_height,
+                                     struct rectangle *dst)
+{
+        double mon_aspect = (double)mon->width / mon->height;
+        double pic_aspect = (double)pic_width / pic_height;
+        double scale;
+        uint32_t k;
 
-        if (style == FIT_WIDTH) {
-                uint32_t scaled_height = MagickGetImageHeight(w);
-                if (scaled_height < mon_height) {
-                        status = MagickExtentImage(w, mon_width, mon_height, 0, (mon_height - scaled_height) / 2);
-                        if (status != MagickPass)
-                                return -EFAULT;
-                }
-        } else if (style == FIT_HEIGHT) {
-                uint32_t scaled_width = MagickGetImageWidth(w);
-                if (scaled_width < mon_width) {
-                        status = MagickExtentImage(w, mon_width, mon_height, (mon_width - scaled_width) / 2, 0);
-                        if (status != MagickPass)
-                                return -EFAULT;
+        switch (style) {
+        case WALLPAPER_STYLE_FIT:
+        case WALLPAPER_STYLE_FIT_EDGE_CUT:
+                // fit matches the longer side, edge cut the shorter one
+                if ((pic_aspect > mon_aspect) == (style == WALLPAPER_STYLE_FIT))
+                        scale = (double)pic_width / mon->width;
+                else
+                        scale = (double)pic_height / mon->height;
+
+                dst->width = max(1U, (uint32_t)(pic_width / scale));
+                dst->height = max(1U, (uint32_t)(pic_height / scale));
+
+                // scaled image covers monitor, edges are cut by clipping
+                if (style == WALLPAPER_STYLE_FIT_EDGE_CUT) {
+                        dst->width = max(mon->width, dst->width);
+                        dst->height = max(mon->height, dst->height);
                 }
+
+                break;
+
+        case WALLPAPER_STYLE_STRETCH:
+        case WALLPAPER_STYLE_TILE:
+                dst->width = mon->width;
+                dst->height = mon->height;
+                break;
+
+        case WALLPAPER_STYLE_INTEGER_SCALE:
+                k = max(1U, min(mon->width / pic_width, mon->height / pic_height));
+                dst->width = pic_width * k;
+                dst->height = pic_height * k;
+                break;
+
+        case WALLPAPER_STYLE_CENTER:
+        default:
+                dst->width = pic_width;
+                dst->height = pic_height;
+                break;
         }
 
-        return 0;
+        dst->x = mon->x + ((int64_t)mon->width - dst->width) / 2;
+        dst->y = mon->y + ((int64_t)mon->height - dst->height) / 2;
 }
 
-static int wallpaper_style_fit_edge_cut_apply(struct monitor *m, MagickWand *w)
+static int wallpaper_style_fit_apply(struct render_target *t, struct pixel_image *img)
 {
-        MagickPassFail status = MagickPass;
-        uint32_t pic_width, pic_height;
-        uint32_t mon_width, mon_height;
-        double scale, mon_aspect, pic_aspect;
-        const int FIT_WIDTH = 0, FIT_HEIGHT = 1;
-        int style;
-
-        mon_width = m->info.width;
-        mon_height = m->info.height;
-        pic_width = MagickGetImageWidth(w);
-        pic_height = MagickGetImageHeight(w);
-        mon_aspect = (double)mon_width / mon_height;
-        pic_aspect = (double)pic_width / pic_height;
-
-        if (pic_aspect > mon_aspect) {
-                style = FIT_HEIGHT;
-                scale = (double)pic_height / m->info.height;
-        } else {
-                style = FIT_WIDTH;
-                scale = (double)pic_width / m->info.width;
-        }
+        struct rectangle dst;
 
-        pr_info("fit %s\n", style == FIT_WIDTH ? "width" : "height");
+        wallpaper_style_geometry(WALLPAPER_STYLE_FIT, &t->rect, img->width, img->height, &dst);
 
-        status = MagickScaleImage(w, (unsigned long)(pic_width / scale), (unsigned long)(pic_height / scale));
-        if (status != MagickPass)
-                return -EFAULT;
+        pr_info("fit %ux%u\n", dst.width, dst.height);
 
-        if (style == FIT_WIDTH) {
-                status = MagickCropImage(w, mon_width, mon_height, 0, (MagickGetImageHeight(w) - mon_height) / 2);
-        } else if (style == FIT_HEIGHT) {
-                status = MagickCropImage(w, mon_width, mon_height, (MagickGetImageWidth(w) - mon_width) / 2, 0);
-        }
+        render_target_bg_fill(t, &dst, img);
 
-        if (status != MagickPass)
-                return -EFAULT;
+        return pixel_resample(t->canvas, &t->rect, &dst, img);
+}
 
-        return 0;
+static int wallpaper_style_fit_edge_cut_apply(struct render_target *t, struct pixel_image *img)
+{
+        struct rectangle dst;
+
+        wallpaper_style_geometry(WALLPAPER_STYLE_FIT_EDGE_CUT, &t->rect, img->width, img->height, &dst);
+
+        pr_info("fit %ux%u\n", dst.width, dst.height);
+
+        if (img->alpha)
+                render_target_bg_fill(t, &dst, img);
+
+        return pixel_resample(t->canvas, &t->rect, &dst, img);
 }
 
-static int wallpaper_style_stretch_apply(struct monitor *m, MagickWand *w)
+static int wallpaper_style_stretch_apply(struct render_target *t, struct pixel_image *img)
 {
-        MagickPassFail status = MagickPass;
+        if (img->alpha)
+                render_target_bg_fill(t, &t->rect, img);
 
-        status = MagickScaleImage(w, m->info.width, m->info.height);
-        if (status != MagickPass)
-                return -EFAULT;
+        return pixel_resample(t->canvas, &t->rect, &t->rect, img);
+}
+
+static int wallpaper_style_tile_apply(struct render_target *t, struct pixel_image *img)
+{
+        uint32_t pic_width = img->width;
+        uint32_t pic_height = img->height;
+        uint32_t mon_width = t->rect.width;
+        uint32_t mon_height = t->rect.height;
+
+        if (img->alpha)
+                canvas_fill(t->canvas, &t->rect, t->bg);
+
+        // picture larger than monitor is cut at right and bottom by clipping
+        for (uint32_t y = 0; y < mon_height; y += pic_height) {
+                for (uint32_t x = 0; x < mon_width; x += pic_width) {
+                        pixel_blit(t->canvas, &t->rect, t->rect.x + x, t->rect.y + y, img);
+                }
+        }
 
         return 0;
 }
 
-static int wallpaper_style_tile_apply(struct monitor *m, MagickWand *w)
+static int wallpaper_style_center_apply(struct render_target *t, struct pixel_image *img)
 {
-        MagickWand *orig;
-        MagickPassFail status = MagickPass;
-        uint32_t pic_width = MagickGetImageWidth(w);
-        uint32_t pic_height = MagickGetImageHeight(w);
-        uint32_t mon_width = m->info.width;
-        uint32_t mon_height = m->info.height;
-        uint32_t x = 0, y = 0, filled_height = 0;
-        int err = 0;
+        struct rectangle dst;
 
-        if (pic_width >= mon_width && pic_height >= mon_height) {
-                status = MagickCropImage(w, m->info.width, m->info.height, 0, 0);
-                if (status != MagickPass)
-                        return -EFAULT;
+        wallpaper_style_geometry(WALLPAPER_STYLE_CENTER, &t->rect, img->width, img->height, &dst);
+        render_target_bg_fill(t, &dst, img);
 
-                return 0;
-        }
+        return pixel_blit(t->canvas, &t->rect, dst.x, dst.y, img);
+}
 
-        orig = CloneMagickWand(w);
-        status = MagickExtentImage(w, mon_width, mon_height, mon_width, mon_height); // blank image
-        if (status != MagickPass)
-                return -EFAULT;
+//
+// largest whole multiple which fits, pixels are replicated without filtering
+// so pixel art stays sharp, larger than monitor is cut like center style
+//
+static int wallpaper_style_integer_scale_apply(struct render_target *t, struct pixel_image *img)
+{
+        struct rectangle dst;
+        uint32_t k;
 
-        while (filled_height < mon_height) {
-                status = MagickCompositeImage(w, orig, OverCompositeOp, x, y);
-                if (status != MagickPass) {
-                        err = -EFAULT;
-                        goto out;
-                }
+        wallpaper_style_geometry(WALLPAPER_STYLE_INTEGER_SCALE, &t->rect, img->width, img->height, &dst);
+        k = dst.width / img->width;
 
-                x += pic_width;
+        pr_info("integer scale x%u\n", k);
 
-                if (x >= mon_width) {
-                        x = 0;
-                        y += pic_height;
-                        filled_height += pic_height;
-                }
-        }
+        render_target_bg_fill(t, &dst, img);
 
-out:
-        DestroyMagickWand(orig);
+        return pixel_scale_nearest(t->canvas, &t->rect, dst.x, dst.y, k, img);
+}
 
-        return err;
+static int wallpaper_orient_get(struct monitor *m)
+{
+        return m->info.is_landscape ? WALLPAPER_LANDSCAPE : WALLPAPER_PORTRAIT;
+}
+
+static int monitor_prof_scope(struct monitor *m)
+{
+        return (int)(m - monitors) + 1;
+}
+
+//
+// size a vector or video source is produced at, so styles which scale get
+// it at final size, center and tile keep native size
+//
+static void wallpaper_styled_size(int style, struct rectangle *mon,
+                                  uint32_t pic_width, uint32_t pic_height,
+                                  uint32_t *width, uint32_t *height)
+{
+        struct rectangle dst;
+
+        switch (style) {
+        case WALLPAPER_STYLE_FIT:
+        case WALLPAPER_STYLE_FIT_EDGE_CUT:
+        case WALLPAPER_STYLE_STRETCH:
+        case WALLPAPER_STYLE_INTEGER_SCALE:
+                wallpaper_style_geometry(style, mon, pic_width, pic_height, &dst);
+                *width = dst.width;
+                *height = dst.height;
+                break;
+
+        default:
+                *width = pic_width;
+                *height = pic_height;
+                break;
+        }
 }
 
-static int wallpaper_style_center_apply(struct monitor *m, MagickWand *w)
+static int wallpaper_decode(char *wallpaper_path, MagickWand **out)
 {
         MagickPassFail status = MagickPass;
-        uint32_t pic_width, pic_height;
-        uint32_t mon_width, mon_height;
-        long x, y;
+        struct source_blob *blob = NULL;
+        struct admission_hint hint;
+        MagickWand *w = NULL;
+        int err;
+
+        if (!wallpaper_path || wallpaper_path[0] == '\0') {
+                pr_err("wallpaper is not defined\n");
+                return -ENODATA;
+        }
 
-        mon_width = m->info.width;
-        mon_height = m->info.height;
-        pic_width = MagickGetImageWidth(w);
-        pic_height = MagickGetImageHeight(w);
+        for (size_t i = 0; i < source_prefetched_cnt; i++) {
+                struct source_blob *b = &source_prefetched[i];
 
-        if (mon_width == pic_width && mon_height == pic_width)
-                return 0;
+                if (b->err || !b->data || strcmp(b->path, wallpaper_path))
+                        continue;
+
+                blob = b;
+                break;
+        }
+
+        // header of prefetched copy, file is read once
+        if (blob)
+                err = admission_ping_blob(wallpaper_path, blob->data, blob->size, &hint);
+        else
+                err = admission_ping(wallpaper_path, &hint);
+
+        if (err)
+                goto blob_release;
+
+        w = NewMagickWand();
 
-        if (pic_width > mon_width && pic_height > mon_height) {
-                x = (pic_width / 2) - (mon_width / 2);
-                y = (pic_height / 2) - (mon_height / 2);
-                status = MagickCropImage(w, mon_width, mon_height, x, y);
+        if (hint.width)
+                MagickSetSize(w, hint.width, hint.height);
+
+        if (blob) {
+                MagickSetFilename(w, wallpaper_path);
+                status = MagickReadImageBlob(w, blob->data, blob->size);
         } else {
-                x = (mon_width / 2) - (pic_width / 2);
-                y = (mon_height / 2) - (pic_height / 2);
-                status = MagickExtentImage(w, mon_width, mon_height, x, y);
+                status = MagickReadImage(w, wallpaper_path);
         }
 
-        if (status != MagickPass)
-                return -EFAULT;
+blob_release:
+        // decoder has its own copy, release once last user is done
+        if (blob && --blob->users == 0)
+                source_blob_free(blob);
+
+        if (err)
+                return err;
+
+        if (status != MagickPass) {
+                pr_err("failed to open wallpaper file: %s\n", wallpaper_path);
+                DestroyMagickWand(w);
+                return -EIO;
+        }
+
+        *out = w;
 
         return 0;
 }
 
-static int wallpaper_load(struct monitor *m, MagickWand **out)
+//
+// decode @wallpaper_path and render it with monitor style into canvas
+// area of monitor size at (@x, @y)
+//
+static int wallpaper_image_render(struct monitor *m, char *wallpaper_path,
+                                  struct canvas *canvas, int32_t x, int32_t y)
 {
-        MagickPassFail status = MagickPass;
+        struct render_target t = {
+                .canvas = canvas,
+                .rect = { .x = x, .y = y, .width = m->info.width, .height = m->info.height },
+        };
+        struct pixel_image img = { 0 }, *src = &img;
+        struct prof_sample ps;
         MagickWand *w = NULL;
-        PixelWand *bg = NULL;
-        int orient = m->info.is_landscape ? WALLPAPER_LANDSCAPE : WALLPAPER_PORTRAIT;
-        char *wallpaper_path;
+        int scope = monitor_prof_scope(m);
         int err = 0;
 
         if (!m->active)
                 return -ENODATA;
 
-        w = NewMagickWand();
-        wallpaper_path = m->wallpaper.files[orient];
+        if (color_parse(m->wallpaper.bg_color, &t.bg))
+                color_parse(DEFAULT_BG_COLOR, &t.bg);
 
-        if (!wallpaper_path || wallpaper_path[0] == '\0') {
-                pr_err("wallpaper is not defined\n");
-                return -ENODATA;
-        }
+        // collage decodes every image of directory at cell size by itself
+        if (m->wallpaper.style == WALLPAPER_STYLE_COLLAGE) {
+                prof_begin(&ps);
+                err = collage_render(canvas, &t.rect, wallpaper_path, &m->wallpaper.collage, t.bg);
+                prof_end(scope, PROF_STAGE_STYLE, &ps, (uint64_t)t.rect.width * t.rect.height);
 
-        status = MagickReadImage(w, wallpaper_path);
-        if (status != MagickPass) {
-                pr_err("failed to open wallpaper file: %s\n", wallpaper_path);
-                err = -EIO;
-                goto out_err;
+                return err;
         }
 
-        bg = NewPixelWand();
+        prof_begin(&ps);
+
+        // rasterised at the size style needs, raster is owned by vector cache
+        if (vector_path_is_vector(wallpaper_path)) {
+                uint32_t pic_width, pic_height, width, height;
 
-        PixelSetColor(bg, DEFAULT_BG_COLOR);
+                if ((err = vector_size_get(wallpaper_path, &pic_width, &pic_height)))
+                        return err;
 
-        if (m->wallpaper.bg_color && m->wallpaper.bg_color[0] != '\0') {
-                status = PixelSetColor(bg, m->wallpaper.bg_color);
-                if (status != MagickPass)
-                        PixelSetColor(bg, DEFAULT_BG_COLOR);
+                wallpaper_styled_size(m->wallpaper.style, &t.rect, pic_width, pic_height, &width, &height);
+
+                if ((err = vector_image_get(wallpaper_path, pic_width, pic_height, width, height,
+                                            m->wallpaper.greyscale, &src)))
+                        return err;
+
+                prof_end(scope, PROF_STAGE_DECODE, &ps, (uint64_t)width * height);
+
+                goto style_apply;
         }
 
-        status = MagickSetImageBackgroundColor(w, bg);
-        if (status != MagickPass) {
-                err = -EFAULT;
-                goto out_err;
+        // extracted frame is owned by video cache
+        if (m->wallpaper.source_type == WALLPAPER_SOURCE_VIDEO) {
+                uint64_t slot = video_slot_get(&m->wallpaper.video);
+                double ts = video_timestamp_get(&m->wallpaper.video, slot);
+                uint32_t pic_width, pic_height, width, height;
+
+                if ((err = video_size_get(wallpaper_path, &pic_width, &pic_height)))
+                        return err;
+
+                wallpaper_styled_size(m->wallpaper.style, &t.rect, pic_width, pic_height, &width, &height);
+
+                if ((err = video_frame_get(wallpaper_path, ts, width, height, m->wallpaper.greyscale, &src)))
+                        return err;
+
+                prof_end(scope, PROF_STAGE_DECODE, &ps, (uint64_t)src->width * src->height);
+
+                m->video_slot = slot;
+
+                goto style_apply;
         }
 
+        if ((err = wallpaper_decode(wallpaper_path, &w)))
+                return err;
+
+        prof_end(scope, PROF_STAGE_DECODE, &ps,
+                 (uint64_t)MagickGetImageWidth(w) * MagickGetImageHeight(w));
+
+        prof_begin(&ps);
+
+        if (m->wallpaper.greyscale)
+                err = pixel_image_from_wand_luma(&img, w);
+        else
+                err = pixel_image_from_wand(&img, w);
+
+        // release decoder memory before styling
+        DestroyMagickWand(w);
+
+        if (err)
+                return err;
+
+        prof_end(scope, PROF_STAGE_EXPORT, &ps, (uint64_t)img.width * img.height);
+
+style_apply:
+        pr_info("source %ux%u %s%s\n", src->width, src->height,
+                src->ops->name, src->alpha ? " (alpha)" : "");
+
+        prof_begin(&ps);
+
         switch (m->wallpaper.style) {
         case WALLPAPER_STYLE_FIT:
-                err = wallpaper_style_fit_apply(m, w);
+                err = wallpaper_style_fit_apply(&t, src);
                 break;
 
         case WALLPAPER_STYLE_FIT_EDGE_CUT:
-                err = wallpaper_style_fit_edge_cut_apply(m, w);
+                err = wallpaper_style_fit_edge_cut_apply(&t, src);
                 break;
 
         case WALLPAPER_STYLE_STRETCH:
-                err = wallpaper_style_stretch_apply(m, w);
+                err = wallpaper_style_stretch_apply(&t, src);
                 break;
 
         case WALLPAPER_STYLE_TILE:
-                err = wallpaper_style_tile_apply(m, w);
+                err = wallpaper_style_tile_apply(&t, src);
                 break;
 
         case WALLPAPER_STYLE_CENTER:
-                err = wallpaper_style_center_apply(m, w);
+                err = wallpaper_style_center_apply(&t, src);
+                break;
+
+        case WALLPAPER_STYLE_INTEGER_SCALE:
+                err = wallpaper_style_integer_scale_apply(&t, src);
                 break;
 
         default:
                 pr_err("unknown wallpaper style\n");
                 err = -EINVAL;
-                goto out_err;
+                break;
         }
 
-        if (out)
-                *out = w;
+        prof_end(scope, PROF_STAGE_STYLE, &ps, (uint64_t)t.rect.width * t.rect.height);
 
-        if (bg)
-                DestroyPixelWand(bg);
+        pixel_image_free(&img);
 
         return err;
+}
 
-out_err:
-        if (bg)
-                DestroyPixelWand(bg);
+static void wallpaper_blend_cache_drop(struct monitor *m)
+{
+        for (size_t i = 0; i < ARRAY_SIZE(m->blend.endpoints); i++) {
+                canvas_deinit(&m->blend.endpoints[i]);
+                m->blend.paths[i] = NULL;
+                m->blend.mtimes[i] = 0;
+        }
 
-        DestroyMagickWand(w);
+        m->blend.contrast = 0.0;
 
-        return err;
+        m->blend.weight = -1;
 }
 
-static int wallpaper_generate(void)
+static int wallpaper_blend_endpoint_render(struct monitor *m, char *path, struct canvas *out)
 {
-        struct rectangle *virt_desk = &virtual_desktop;
-        MagickWand *wallpapers[MONITOR_COUNT_MAX] = { 0 };
-        MagickWand *canvas = NULL;
-        PixelWand *canvas_bg = NewPixelWand();
-        MagickPassFail status = MagickPass;
-        int err = 0;
+        int err;
 
-        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
-                struct monitor *m = &monitors[i];
+        if ((err = canvas_init(out, m->info.width, m->info.height)))
+                return err;
 
-                if (!m->active)
-                        continue;
+        if ((err = wallpaper_image_render(m, path, out, 0, 0)))
+                canvas_deinit(out);
 
-                if ((err = wallpaper_load(m, &wallpapers[i]))) {
-                        pr_err("failed to load wallpaper of monitor %zu\n", i);
-                        continue;
-                }
+        return err;
+}
 
-//                {
-//                        char path[PATH_MAX] = { 0 };
-//                        snprintf(path, sizeof(path), "R:/%zu.bmp", i);
-//                        status = MagickWriteImage(wallpapers[i], path);
-//                        if (status != MagickPass)
-//                                pr_err("failed to write image %s\n", path);
-//                }
-        }
+static void wallpaper_blend_paths_get(struct monitor *m, char *paths[2])
+{
+        uint32_t orient = wallpaper_orient_get(m);
 
-        canvas = NewMagickWand();
-        status = MagickReadImage(canvas, "XC:"); // create a blank image
-        if (status != MagickPass)
-                goto out_free_canvas;
+        paths[0] = m->wallpaper.files[orient];
+        paths[1] = m->wallpaper.night_files[orient];
+}
 
-        PixelSetColor(canvas_bg, DEFAULT_BG_COLOR);
-        MagickSetImageBackgroundColor(canvas, canvas_bg);
+//
+// decode and style both endpoints once, intermediate frames are blended
+// from cache, so the cost of a transition does not depend on its smoothness
+//
+static int wallpaper_blend_cache_valid(struct monitor *m)
+{
+        struct canvas *day = &m->blend.endpoints[0];
+        struct canvas *night = &m->blend.endpoints[1];
+        char *paths[2];
 
-        status = MagickExtentImage(canvas, virt_desk->width, virt_desk->height, 0, 0);
-        if (status != MagickPass)
-                goto out_free_canvas;
+        if (!day->pixels || !night->pixels ||
+            day->width != m->info.width || day->height != m->info.height ||
+            m->blend.orient != (uint32_t)wallpaper_orient_get(m))
+                return 0;
 
-        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
-                struct monitor *m = &monitors[i];
+        wallpaper_blend_paths_get(m, paths);
 
-                if (!m->active || !wallpapers[i])
-                        continue;
+        // endpoint files edited on disk are rendered again
+        for (size_t i = 0; i < ARRAY_SIZE(m->blend.endpoints); i++) {
+                uint64_t mtime = 0;
 
-                status = MagickCompositeImage(canvas, wallpapers[i], OverCompositeOp, m->virt_pos.x, m->virt_pos.y);
-                if (status != MagickPass) {
-                        pr_err("failed to composite %zu wallpaper into canvas\n", i);
-                        goto out_free_canvas;
-                }
-        }
+                if (m->blend.paths[i] != paths[i])
+                        return 0;
 
-        status = MagickWriteImage(canvas, out_path);
-        if (status != MagickPass) {
-                pr_mb_err("failed to save wallpaper image to %s\n", out_path);
-                err = -EIO;
-                goto out_free_canvas;
+                if (source_stat(paths[i], NULL, &mtime) || mtime != m->blend.mtimes[i])
+                        return 0;
         }
 
-out_free_canvas:
-        DestroyMagickWand(canvas);
+        return 1;
+}
 
-        for (size_t i = 0; i < ARRAY_SIZE(wallpapers); i++) {
-                if (wallpapers[i])
-                        DestroyMagickWand(wallpapers[i]);
-        }
+// sampled on a 4x4 grid, only the magnitude matters
+static double wallpaper_blend_contrast(struct canvas *a, struct canvas *b)
+{
+        double sum = 0.0;
+        uint32_t rows = 0;
 
-        DestroyPixelWand(canvas_bg);
+        for (uint32_t y = 0; y < a->height; y += 4, rows++)
+                sum += schedule_lightness_diff(canvas_pixel(a, 0, y), canvas_pixel(b, 0, y), a->width, 4);
 
-        return err;
+        return rows ? sum / rows : 0.0;
 }
 
-static int wallpaper_update(void)
+static int wallpaper_blend_cache_update(struct monitor *m)
 {
+        struct canvas *day = &m->blend.endpoints[0];
+        struct canvas *night = &m->blend.endpoints[1];
+        uint32_t orient = wallpaper_orient_get(m);
+        uint64_t mtimes[2] = { 0 };
+        char *paths[2];
         int err;
 
-        display_info_update();
-        virtual_desktop_reset();
-        virtual_desktop_update();
-        virtual_desktop_position_reposition();
+        if (wallpaper_blend_cache_valid(m))
+                return 0;
 
-        if ((err = wallpaper_generate())) {
-                pr_mb_err("wallpaper_generate() failed\n");
+        wallpaper_blend_paths_get(m, paths);
+
+        wallpaper_blend_cache_drop(m);
+
+        // taken before decode, a write racing with it renders again next time
+        for (size_t i = 0; i < ARRAY_SIZE(paths); i++)
+                source_stat(paths[i], NULL, &mtimes[i]);
+
+        if ((err = wallpaper_blend_endpoint_render(m, paths[0], day)))
                 return err;
-        }
 
-        if ((err = desktop_wallpaper_set(out_path_w))) {
-                pr_mb_err("desktop_wallpaper_set() failed\n");
+        if ((err = wallpaper_blend_endpoint_render(m, paths[1], night))) {
+                wallpaper_blend_cache_drop(m);
                 return err;
         }
 
+        for (size_t i = 0; i < ARRAY_SIZE(paths); i++) {
+                m->blend.paths[i] = paths[i];
+                m->blend.mtimes[i] = mtimes[i];
+        }
+
+        m->blend.contrast = wallpaper_blend_contrast(day, night);
+        m->blend.orient = orient;
+
+        pr_info("monitor %d: endpoints differ by %.1f L* on average\n", (int)(m - monitors), m->blend.contrast);
+
         return 0;
 }
 
-static LRESULT CALLBACK notify_wnd_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+static double schedule_time_get(char *str, char *def)
 {
-        if (msg != WM_DISPLAYCHANGE)
-                goto def_proc;
+        double minute;
 
-        pr_info("display mode changed\n");
-        // pr_info("display changed: bit: %lld %ux%u\n", wparam, LOWORD(lparam), HIWORD(lparam));
+        if (str && str[0] != '\0') {
+                if (!schedule_time_parse(str, &minute))
+                        return minute;
 
-        wallpaper_update();
+                pr_err("invalid schedule time: \"%s\"\n", str);
+        }
 
-        return TRUE;
+        schedule_time_parse(def, &minute);
 
-def_proc:
-        return DefWindowProc(hwnd, msg, wparam, lparam);
+        return minute;
 }
 
-static HANDLE notify_wnd_create(void)
+// keyframes list if given, else dawn and dusk fades
+static size_t schedule_keyframes_get(struct monitor *m, struct schedule_keyframe *kf)
 {
-        HWND wnd = NULL;
-        WNDCLASSEX wc = { 0 };
+        double transition;
+        int n;
 
-        wc.cbSize              = sizeof(WNDCLASSEX);
-        wc.lpfnWndProc         = notify_wnd_proc;
+        if (m->wallpaper.schedule.keyframes && m->wallpaper.schedule.keyframes[0] != '\0') {
+                n = schedule_keyframes_parse(m->wallpaper.schedule.keyframes, kf, SCHEDULE_KEYFRAME_MAX);
+                if (n > 0)
+                        return (size_t)n;
+
+                pr_err("schedule keyframes unusable, fall back to dawn and dusk\n");
+        }
+
+        transition = m->wallpaper.schedule.transition ? m->wallpaper.schedule.transition : DEFAULT_SCHEDULE_TRANSITION;
+
+        return schedule_keyframes_from_times(kf,
+                                             schedule_time_get(m->wallpaper.schedule.dawn, DEFAULT_SCHEDULE_DAWN),
+                                             schedule_time_get(m->wallpaper.schedule.dusk, DEFAULT_SCHEDULE_DUSK),
+                                             transition);
+}
+
+// night weight of current local time, in [0, 256]
+static uint32_t schedule_weight_get(struct monitor *m)
+{
+        struct schedule_keyframe kf[SCHEDULE_KEYFRAME_MAX];
+        size_t n = schedule_keyframes_get(m, kf);
+        SYSTEMTIME t;
+        double now;
+
+        GetLocalTime(&t);
+        now = t.wHour * 60 + t.wMinute + t.wSecond / 60.0;
+
+        return (uint32_t)(schedule_night_at(kf, n, now) * 256.0 + 0.5);
+}
+
+//
+// minimal weight change worth re-applying, step is given as change of
+// lightness (delta L*), which depends on how far apart the endpoints are
+//
+static uint32_t schedule_step_get(struct monitor *m)
+{
+        double step = m->wallpaper.schedule.step > 0.0 ? m->wallpaper.schedule.step : DEFAULT_SCHEDULE_STEP;
+        uint32_t s;
+
+        // endpoints closer than a step, only land on them
+        if (m->blend.contrast <= step)
+                return 256;
+
+        s = (uint32_t)(step * 256.0 / m->blend.contrast + 0.5);
+
+        return s ? s : 1;
+}
+
+static int wallpaper_schedule_render(struct monitor *m, struct canvas *canvas)
+{
+        struct prof_sample ps;
+        uint32_t weight;
+        int err;
+
+        if ((err = wallpaper_blend_cache_update(m)))
+                return err;
+
+        weight = schedule_weight_get(m);
+
+        prof_begin(&ps);
+
+        if ((err = canvas_lerp(canvas, m->virt_pos.x, m->virt_pos.y,
+                               &m->blend.endpoints[0], &m->blend.endpoints[1], weight)))
+                return err;
+
+        prof_end(monitor_prof_scope(m), PROF_STAGE_STYLE, &ps,
+                 (uint64_t)m->info.width * m->info.height);
+
+        m->blend.weight = (int32_t)weight;
+
+        return 0;
+}
+
+static void wallpaper_background_render(struct canvas *canvas)
+{
+        struct rectangle full = {
+                .x = 0,
+                .y = 0,
+                .width = canvas->width,
+                .height = canvas->height,
+        };
+        uint32_t bg = 0;
+
+        if (g_config.background.pattern != PROCEDURAL_NONE) {
+                if (procedural_render(canvas, &full, &g_config.background) == 0)
+                        return;
+
+                pr_err("failed to render background pattern\n");
+        }
+
+        color_parse(DEFAULT_BG_COLOR, &bg);
+        canvas_fill(canvas, &full, bg);
+}
+
+static void wallpaper_overlays_render(struct monitor *m, struct canvas *canvas)
+{
+        struct rectangle rect = {
+                .x = m->virt_pos.x,
+                .y = m->virt_pos.y,
+                .width = m->info.width,
+                .height = m->info.height,
+        };
+        int32_t idx = (int32_t)(m - monitors);
+        struct prof_sample ps;
+
+        prof_begin(&ps);
+
+        for (size_t i = 0; i < ARRAY_SIZE(overlays); i++) {
+                struct overlay *o = &overlays[i];
+
+                if (!o->image || o->image[0] == '\0')
+                        continue;
+
+                if (o->monitor != -1 && o->monitor != idx)
+                        continue;
+
+                if (overlay_render(canvas, &rect, o))
+                        pr_err("failed to render overlay %zu on monitor %d\n", i, idx);
+        }
+
+        prof_end(monitor_prof_scope(m), PROF_STAGE_OVERLAY, &ps, 0);
+}
+
+static int wallpaper_monitor_source_render(struct monitor *m, struct canvas *canvas)
+{
+        if (m->wallpaper.source_type == WALLPAPER_SOURCE_PROCEDURAL) {
+                struct rectangle rect = {
+                        .x = m->virt_pos.x,
+                        .y = m->virt_pos.y,
+                        .width = m->info.width,
+                        .height = m->info.height,
+                };
+                struct prof_sample ps;
+                int err;
+
+                prof_begin(&ps);
+                err = procedural_render(canvas, &rect, &m->wallpaper.procedural);
+                prof_end(monitor_prof_scope(m), PROF_STAGE_STYLE, &ps, (uint64_t)rect.width * rect.height);
+
+                return err;
+        }
+
+        if (m->wallpaper.source_type == WALLPAPER_SOURCE_SCHEDULE)
+                return wallpaper_schedule_render(m, canvas);
+
+        return wallpaper_image_render(m, m->wallpaper.files[wallpaper_orient_get(m)],
+                                      canvas, m->virt_pos.x, m->virt_pos.y);
+}
+
+static int wallpaper_monitor_render(struct monitor *m, struct canvas *canvas)
+{
+        int err;
+
+        if ((err = wallpaper_monitor_source_render(m, canvas)))
+                return err;
+
+        wallpaper_overlays_render(m, canvas);
+
+        return 0;
+}
+
+static void source_prefetch_add(char *path)
+{
+        uint64_t size = 0;
+
+        if (!path || path[0] == '\0')
+                return;
+
+        // vector rasteriser reads file at target density by itself
+        if (vector_path_is_vector(path))
+                return;
+
+        for (size_t i = 0; i < source_prefetched_cnt; i++) {
+                if (!strcmp(source_prefetched[i].path, path)) {
+                        source_prefetched[i].users++;
+                        return;
+                }
+        }
+
+        // left to decoder, which rejects it
+        if (admission_file_check(path, &size))
+                return;
+
+        if (source_prefetched_cnt >= ARRAY_SIZE(source_prefetched))
+                return;
+
+        // over budget is read from path by decoder
+        if (source_prefetched_bytes + size > SOURCE_PREFETCH_BYTES_MAX)
+                return;
+
+        source_prefetched_bytes += size;
+        source_prefetched[source_prefetched_cnt++] = (struct source_blob){ .path = path, .users = 1 };
+}
+
+// read all sources this render is going to decode in parallel
+static void source_prefetch(void)
+{
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
+                struct monitor *m = &monitors[i];
+                int orient = wallpaper_orient_get(m);
+
+                if (!m->active)
+                        continue;
+
+                // directory, images are read by collage workers
+                if (m->wallpaper.style == WALLPAPER_STYLE_COLLAGE)
+                        continue;
+
+                switch (m->wallpaper.source_type) {
+                case WALLPAPER_SOURCE_IMAGE:
+                        source_prefetch_add(m->wallpaper.files[orient]);
+                        break;
+
+                case WALLPAPER_SOURCE_SCHEDULE:
+                        if (wallpaper_blend_cache_valid(m))
+                                break;
+
+                        source_prefetch_add(m->wallpaper.files[orient]);
+                        source_prefetch_add(m->wallpaper.night_files[orient]);
+                        break;
+
+                default:
+                        break;
+                }
+        }
+
+        // failed ones are decoded from path as fallback
+        source_blobs_read(source_prefetched, source_prefetched_cnt);
+}
+
+static void source_prefetch_drop(void)
+{
+        for (size_t i = 0; i < source_prefetched_cnt; i++)
+                source_blob_free(&source_prefetched[i]);
+
+        source_prefetched_cnt = 0;
+        source_prefetched_bytes = 0;
+}
+
+//
+// desktop file goes greyscale only when every active monitor is, dithered
+// to the coarsest levels among them
+//
+static int wallpaper_desktop_greyscale_get(uint32_t *levels)
+{
+        int cnt = 0;
+
+        *levels = 0;
+
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
+                struct monitor *m = &monitors[i];
+                uint32_t l = m->wallpaper.grey_levels;
+
+                if (!m->active)
+                        continue;
+
+                if (!m->wallpaper.greyscale)
+                        return 0;
+
+                if (l >= 2 && l < 256 && (!*levels || l < *levels))
+                        *levels = l;
+
+                cnt++;
+        }
+
+        return cnt > 0;
+}
+
+static int wallpaper_desktop_output_write(struct canvas *canvas)
+{
+        struct rectangle full = { .x = 0, .y = 0, .width = canvas->width, .height = canvas->height };
+        MagickWand *output = NULL;
+        struct prof_sample ps;
+        uint32_t levels;
+        int err;
+
+        prof_begin(&ps);
+
+        if (wallpaper_desktop_greyscale_get(&levels))
+                err = canvas_rect_to_wand_grey(canvas, &full, levels, &output);
+        else
+                err = canvas_to_wand(canvas, &output);
+
+        if (err) {
+                pr_err("failed to convert canvas to image\n");
+                return err;
+        }
+
+        // runs on worker thread, caller reports failure
+        if (MagickWriteImage(output, out_path) != MagickPass)
+                err = -EIO;
+
+        DestroyMagickWand(output);
+
+        prof_end(PROF_SCOPE_DESKTOP, PROF_STAGE_ENCODE, &ps, (uint64_t)canvas->width * canvas->height);
+
+        return err;
+}
+
+// skipped if content is same as last written and file is still there
+static int wallpaper_monitor_output_write(struct canvas *canvas, struct monitor *m)
+{
+        struct rectangle rect = {
+                .x = m->virt_pos.x,
+                .y = m->virt_pos.y,
+                .width = m->info.width,
+                .height = m->info.height,
+        };
+        int idx = (int)(m - monitors);
+        uint64_t ts = prof_usec_now();
+        struct prof_sample ps;
+        MagickWand *output = NULL;
+        uint64_t fp;
+        int err;
+
+        fp = canvas_rect_hash(canvas, &rect);
+
+        if (fp == m->output.fingerprint && !source_stat(m->output.path, NULL, NULL)) {
+                pr_info("monitor %d: %s unchanged, skipped\n", idx, m->output.path);
+                return 0;
+        }
+
+        prof_begin(&ps);
+
+        if (m->wallpaper.greyscale)
+                err = canvas_rect_to_wand_grey(canvas, &rect, m->wallpaper.grey_levels, &output);
+        else
+                err = canvas_rect_to_wand(canvas, &rect, &output);
+
+        if (err) {
+                pr_err("failed to convert monitor %d to image\n", idx);
+                return err;
+        }
+
+        if (MagickWriteImage(output, m->output.path) != MagickPass) {
+                pr_err("failed to save monitor %d image to %s\n", idx, m->output.path);
+                err = -EIO;
+        }
+
+        DestroyMagickWand(output);
+
+        prof_end(monitor_prof_scope(m), PROF_STAGE_ENCODE, &ps, (uint64_t)rect.width * rect.height);
+
+        if (err)
+                return err;
+
+        m->output.fingerprint = fp;
+
+        pr_info("monitor %d: %s written in %llu us\n", idx, m->output.path,
+                (unsigned long long)(prof_usec_now() - ts));
+
+        return 0;
+}
+
+struct output_job {
+        struct canvas  *canvas;
+        struct monitor *monitor;        // NULL: composed desktop file
+        uint64_t        cost;           // predicted, in us
+        int             err;
+};
+
+static int output_job_cost_cmp(const void *a, const void *b)
+{
+        const struct output_job *ja = a, *jb = b;
+
+        return (ja->cost < jb->cost) - (ja->cost > jb->cost);
+}
+
+static void wallpaper_output_job(void *arg, size_t idx)
+{
+        struct output_job *job = &((struct output_job *)arg)[idx];
+
+        if (job->monitor)
+                job->err = wallpaper_monitor_output_write(job->canvas, job->monitor);
+        else
+                job->err = wallpaper_desktop_output_write(job->canvas);
+}
+
+// encode and write all output files of current mode in parallel
+static int wallpaper_output_write(struct canvas *canvas)
+{
+        struct output_job jobs[MONITOR_COUNT_MAX + 1];
+        size_t n = 0;
+        int err = 0;
+
+        if (g_config.output_mode != OUTPUT_MODE_MONITORS) {
+                jobs[n++] = (struct output_job){
+                        .canvas = canvas,
+                        .cost = plan_cost_usec(PLAN_OP_ENCODE, (uint64_t)canvas->width * canvas->height),
+                };
+        }
+
+        for (size_t i = 0; g_config.output_mode != OUTPUT_MODE_DESKTOP && i < ARRAY_SIZE(monitors); i++) {
+                struct monitor *m = &monitors[i];
+
+                if (!m->active)
+                        continue;
+
+                jobs[n++] = (struct output_job){
+                        .canvas = canvas,
+                        .monitor = m,
+                        .cost = plan_cost_usec(PLAN_OP_ENCODE, (uint64_t)m->info.width * m->info.height),
+                };
+        }
+
+        // longest first, so the big desktop file does not start last
+        qsort(jobs, n, sizeof(jobs[0]), output_job_cost_cmp);
+
+        worker_run(n, wallpaper_output_job, jobs);
+
+        // message box blocks, only raise it from calling thread
+        for (size_t i = 0; i < n; i++) {
+                if (!jobs[i].err)
+                        continue;
+
+                if (!jobs[i].monitor && jobs[i].err == -EIO)
+                        pr_mb_err("failed to save wallpaper image to %s\n", out_path);
+
+                if (!err)
+                        err = jobs[i].err;
+        }
+
+        return err;
+}
+
+static const char *path_basename(const char *path)
+{
+        const char *p = strrchr(path, '/');
+        const char *q = strrchr(path, '\\');
+
+        if (q > p)
+                p = q;
+
+        return p ? p + 1 : path;
+}
+
+static uint64_t rect_overlap_area(struct rectangle *a, struct rectangle *b)
+{
+        int64_t x0 = max((int64_t)a->x, (int64_t)b->x);
+        int64_t y0 = max((int64_t)a->y, (int64_t)b->y);
+        int64_t x1 = min((int64_t)a->x + a->width, (int64_t)b->x + b->width);
+        int64_t y1 = min((int64_t)a->y + a->height, (int64_t)b->y + b->height);
+
+        if (x1 <= x0 || y1 <= y0)
+                return 0;
+
+        return (uint64_t)(x1 - x0) * (uint64_t)(y1 - y0);
+}
+
+//
+// same steps as wallpaper_image_render(), sizes come from image header,
+// which is all the planner reads of a source
+//
+static int wallpaper_image_plan(struct plan *p, struct monitor *m, char *path, struct rectangle *rect)
+{
+        int scope = monitor_prof_scope(m);
+        uint64_t mon_area = (uint64_t)rect->width * rect->height;
+        uint64_t pic_area, vis_area, fill_area, file_size = 0;
+        uint32_t pic_width, pic_height;
+        struct rectangle dst;
+        uint32_t export_bpp;
+        const char *name;
+        MagickWand *w;
+        struct admission_hint hint;
+        int video = m->wallpaper.source_type == WALLPAPER_SOURCE_VIDEO;
+        int alpha, err;
+
+        if (!path || path[0] == '\0')
+                return -ENODATA;
+
+        name = path_basename(path);
+
+        if (m->wallpaper.style == WALLPAPER_STYLE_COLLAGE) {
+                char **paths = NULL;
+                size_t cnt = 0;
+
+                if (source_dir_list(path, 0, &paths, &cnt))
+                        return -EIO;
+
+                source_dir_list_free(paths, cnt);
+
+                if (m->wallpaper.collage.count && cnt > m->wallpaper.collage.count)
+                        cnt = m->wallpaper.collage.count;
+
+                // decoded near cell size, cells add up to about monitor area
+                plan_add(p, scope, PLAN_OP_FILL, mon_area, 0, 0, "collage background");
+                plan_add(p, scope, PLAN_OP_DECODE, mon_area, mon_area * sizeof(PixelPacket), 1,
+                         "collage of up to %zu files in %s", cnt, name);
+                plan_add(p, scope, PLAN_OP_RESAMPLE, mon_area, 0, 1, "collage cells");
+
+                return 0;
+        }
+
+        // rasterised once at styled size, so no resample pass
+        if (vector_path_is_vector(path)) {
+                uint32_t width, height;
+                uint64_t area;
+
+                if (vector_size_get(path, &pic_width, &pic_height))
+                        return -EIO;
+
+                wallpaper_styled_size(m->wallpaper.style, rect, pic_width, pic_height, &width, &height);
+                wallpaper_style_geometry(m->wallpaper.style, rect, width, height, &dst);
+                area = (uint64_t)width * height;
+                export_bpp = m->wallpaper.greyscale ? 1 : 4;
+
+                plan_add(p, scope, PLAN_OP_FILL, mon_area, 0, 0, "bg %s", m->wallpaper.bg_color ? m->wallpaper.bg_color : DEFAULT_BG_COLOR);
+                plan_add(p, scope, PLAN_OP_DECODE, area, area * (sizeof(PixelPacket) + export_bpp), 0,
+                         "vector %s %ux%u at %ux%u", name, pic_width, pic_height, width, height);
+                plan_add(p, scope, PLAN_OP_COPY, rect_overlap_area(&dst, rect), 0, 0,
+                         "%s", wallpaper_style_strs[m->wallpaper.style]);
+
+                return 0;
+        }
+
+        if (video) {
+                if (video_size_get(path, &pic_width, &pic_height))
+                        return -EIO;
+
+                alpha = 0;
+        } else {
+                if (source_stat(path, &file_size, NULL))
+                        return -ENOENT;
+
+                w = NewMagickWand();
+
+                if (MagickPingImage(w, path) != MagickPass) {
+                        pr_err("failed to read header of %s\n", path);
+                        DestroyMagickWand(w);
+                        return -EIO;
+                }
+
+                pic_width = MagickGetImageWidth(w);
+                pic_height = MagickGetImageHeight(w);
+                alpha = MagickGetImageMatte(w) ? 1 : 0;
+                err = admission_check(w, path, file_size, &hint);
+
+                DestroyMagickWand(w);
+
+                if (err)
+                        return err;
+
+                // decoder reduces while decoding
+                if (hint.width) {
+                        pic_width = hint.width;
+                        pic_height = hint.height;
+                }
+        }
+
+        if (!pic_width || !pic_height)
+                return -EINVAL;
+
+        pic_area = (uint64_t)pic_width * pic_height;
+
+        wallpaper_style_geometry(m->wallpaper.style, rect, pic_width, pic_height, &dst);
+        vis_area = rect_overlap_area(&dst, rect);
+        fill_area = alpha ? mon_area : mon_area - vis_area;
+
+        if (video) {
+                // decoder reads by itself, a frame of yuv 4:2:0 at most
+                plan_add(p, scope, PLAN_OP_DECODE, pic_area, pic_area * 3 / 2, 0,
+                         "%s frame at %.3fs from keyframe, %ux%u", name,
+                         video_timestamp_get(&m->wallpaper.video, video_slot_get(&m->wallpaper.video)),
+                         pic_width, pic_height);
+        } else {
+                // prefetched blob is held until all monitors are rendered
+                p->mem_resident += file_size;
+
+                plan_add(p, scope, PLAN_OP_READ, file_size, 0, 1, "%s", name);
+                plan_add(p, scope, PLAN_OP_DECODE, pic_area, pic_area * sizeof(PixelPacket), 0,
+                         "%ux%u%s", pic_width, pic_height, alpha ? " alpha" : "");
+        }
+        export_bpp = alpha ? 4 : (m->wallpaper.greyscale ? 1 : 3);
+
+        plan_add(p, scope, PLAN_OP_EXPORT, pic_area, pic_area * (sizeof(PixelPacket) + export_bpp), 0,
+                 "%ux%u to %ubpp", pic_width, pic_height, export_bpp * 8);
+
+        if (fill_area)
+                plan_add(p, scope, PLAN_OP_FILL, fill_area, 0, 0, "bg %s", m->wallpaper.bg_color ? m->wallpaper.bg_color : DEFAULT_BG_COLOR);
+
+        switch (m->wallpaper.style) {
+        case WALLPAPER_STYLE_FIT:
+        case WALLPAPER_STYLE_FIT_EDGE_CUT:
+        case WALLPAPER_STYLE_STRETCH:
+                plan_add(p, scope,
+                         resample_upscale_used(pic_width, pic_height, dst.width, dst.height, alpha) ?
+                         PLAN_OP_UPSCALE : PLAN_OP_RESAMPLE,
+                         vis_area, pic_area * export_bpp, 0,
+                         "%s x%.3f/%.3f to %ux%u crop %ux%u",
+                         wallpaper_style_strs[m->wallpaper.style],
+                         (double)dst.width / pic_width, (double)dst.height / pic_height,
+                         dst.width, dst.height,
+                         min(dst.width, rect->width), min(dst.height, rect->height));
+                break;
+
+        default:
+                plan_add(p, scope, PLAN_OP_COPY, vis_area, pic_area * export_bpp, 0,
+                         "%s %ux%u to %ux%u crop %ux%u",
+                         wallpaper_style_strs[m->wallpaper.style],
+                         pic_width, pic_height, dst.width, dst.height,
+                         min(dst.width, rect->width), min(dst.height, rect->height));
+                break;
+        }
+
+        return 0;
+}
+
+static void wallpaper_monitor_plan(struct plan *p, struct monitor *m)
+{
+        struct rectangle rect = {
+                .x = m->virt_pos.x,
+                .y = m->virt_pos.y,
+                .width = m->info.width,
+                .height = m->info.height,
+        };
+        struct rectangle local = { .width = rect.width, .height = rect.height };
+        uint64_t mon_area = (uint64_t)rect.width * rect.height;
+        int32_t idx = (int32_t)(m - monitors);
+        int scope = monitor_prof_scope(m);
+        int orient = wallpaper_orient_get(m);
+        int err = 0;
+
+        switch (m->wallpaper.source_type) {
+        case WALLPAPER_SOURCE_PROCEDURAL:
+                plan_add(p, scope, PLAN_OP_PROCEDURAL, mon_area, 0, 0, "%s %ux%u",
+                         procedural_pattern_strs[m->wallpaper.procedural.pattern],
+                         rect.width, rect.height);
+                break;
+
+        case WALLPAPER_SOURCE_SCHEDULE:
+                // endpoints are kept between renders
+                p->mem_resident += mon_area * CANVAS_BPP * 2;
+
+                if (!wallpaper_blend_cache_valid(m)) {
+                        err = wallpaper_image_plan(p, m, m->wallpaper.files[orient], &local);
+                        if (!err)
+                                err = wallpaper_image_plan(p, m, m->wallpaper.night_files[orient], &local);
+                }
+
+                plan_add(p, scope, PLAN_OP_LERP, mon_area, 0, 0, "day/night %ux%u", rect.width, rect.height);
+                break;
+
+        default:
+                err = wallpaper_image_plan(p, m, m->wallpaper.files[orient], &rect);
+                break;
+        }
+
+        if (err)
+                pr_err("monitor %d: source can not be planned, err = %d\n", idx, err);
+
+        for (size_t i = 0; i < ARRAY_SIZE(overlays); i++) {
+                struct overlay *o = &overlays[i];
+                uint32_t width = 0, height = 0;
+                MagickWand *w;
+
+                if (!o->image || o->image[0] == '\0')
+                        continue;
+
+                if (o->monitor != -1 && o->monitor != idx)
+                        continue;
+
+                w = NewMagickWand();
+
+                if (MagickPingImage(w, o->image) == MagickPass) {
+                        width = MagickGetImageWidth(w);
+                        height = MagickGetImageHeight(w);
+                }
+
+                DestroyMagickWand(w);
+
+                // premultiplied cache stays after render
+                p->mem_resident += (uint64_t)width * height * 4;
+
+                plan_add(p, scope, PLAN_OP_OVERLAY, min((uint64_t)width * height, mon_area), 0, 0,
+                         "%s %ux%u %s", path_basename(o->image), width, height,
+                         overlay_anchor_strs[o->anchor]);
+        }
+}
+
+//
+// every operation a render of current layout and config performs, output
+// files are encoded on worker pool, the rest runs on main thread
+//
+static void wallpaper_plan_build(struct plan *p)
+{
+        struct rectangle *virt_desk = &virtual_desktop;
+        uint64_t desk_area = (uint64_t)virt_desk->width * virt_desk->height;
+
+        memset(p, 0, sizeof(*p));
+
+        p->mem_resident = desk_area * CANVAS_BPP;
+
+        if (g_config.background.pattern != PROCEDURAL_NONE)
+                plan_add(p, PROF_SCOPE_DESKTOP, PLAN_OP_PROCEDURAL, desk_area, 0, 0, "background %s",
+                         procedural_pattern_strs[g_config.background.pattern]);
+        else
+                plan_add(p, PROF_SCOPE_DESKTOP, PLAN_OP_FILL, desk_area, 0, 0, "background %s", DEFAULT_BG_COLOR);
+
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
+                if (monitors[i].active)
+                        wallpaper_monitor_plan(p, &monitors[i]);
+        }
+
+        if (g_config.output_mode != OUTPUT_MODE_MONITORS)
+                plan_add(p, PROF_SCOPE_DESKTOP, PLAN_OP_ENCODE, desk_area, desk_area * sizeof(PixelPacket), 1,
+                         "%ux%u %s", virt_desk->width, virt_desk->height, path_basename(out_path));
+
+        for (size_t i = 0; g_config.output_mode != OUTPUT_MODE_DESKTOP && i < ARRAY_SIZE(monitors); i++) {
+                struct monitor *m = &monitors[i];
+                uint64_t area = (uint64_t)m->info.width * m->info.height;
+
+                if (!m->active)
+                        continue;
+
+                plan_add(p, monitor_prof_scope(m), PLAN_OP_ENCODE, area, area * sizeof(PixelPacket), 1,
+                         "%ux%u %s", m->info.width, m->info.height, path_basename(m->output.path));
+        }
+}
+
+static void wallpaper_explain(void)
+{
+        static struct plan plan;
+
+        display_info_update();
+        virtual_desktop_reset();
+        virtual_desktop_update();
+        virtual_desktop_position_reposition();
+
+        pr_rawlvl(INFO, "virtual desktop: %ux%u\n", virtual_desktop.width, virtual_desktop.height);
+
+        wallpaper_plan_build(&plan);
+        plan_print(&plan);
+}
+
+static int wallpaper_desktop_set(void)
+{
+        if (g_config.output_mode == OUTPUT_MODE_MONITORS)
+                return 0;
+
+        return desktop_wallpaper_set(out_path_w);
+}
+
+static int wallpaper_generate(void)
+{
+        struct rectangle *virt_desk = &virtual_desktop;
+        struct canvas *canvas = &desktop_canvas;
+        struct prof_sample ps;
+        int err = 0;
+
+        prof_reset();
+
+        // canvas is kept after rendering for partial updates of schedule sources
+        canvas_deinit(canvas);
+
+        if ((err = canvas_init(canvas, virt_desk->width, virt_desk->height)))
+                return err;
+
+        prof_begin(&ps);
+        wallpaper_background_render(canvas);
+        prof_end(PROF_SCOPE_DESKTOP, PROF_STAGE_BACKGROUND, &ps, (uint64_t)canvas->width * canvas->height);
+
+        prof_begin(&ps);
+        source_prefetch();
+        prof_end(PROF_SCOPE_DESKTOP, PROF_STAGE_PREFETCH, &ps, 0);
+
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
+                struct monitor *m = &monitors[i];
+
+                if (!m->active)
+                        continue;
+
+                if (wallpaper_monitor_render(m, canvas)) {
+                        pr_err("failed to render wallpaper of monitor %zu\n", i);
+                        continue;
+                }
+        }
+
+        source_prefetch_drop();
+
+        if ((err = wallpaper_output_write(canvas)))
+                canvas_deinit(canvas);
+
+        prof_report();
+
+        return err;
+}
+
+static int wallpaper_update(void)
+{
+        int err;
+
+        display_info_update();
+        virtual_desktop_reset();
+        virtual_desktop_update();
+        virtual_desktop_position_reposition();
+
+        if ((err = wallpaper_generate())) {
+                pr_mb_err("wallpaper_generate() failed\n");
+                return err;
+        }
+
+        if ((err = wallpaper_desktop_set())) {
+                pr_mb_err("desktop_wallpaper_set() failed\n");
+                return err;
+        }
+
+        return 0;
+}
+
+//
+// re-blend schedule sources in place, wallpaper is re-applied only when any
+// blend has moved by more than its perceptual step since last applied, or
+// a video source is due for its next frame
+//
+static int wallpaper_schedule_refresh(void)
+{
+        struct canvas *canvas = &desktop_canvas;
+        int dirty = 0;
+        int err;
+
+        if (!canvas->pixels)
+                return wallpaper_update();
+
+        prof_reset();
+
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
+                struct monitor *m = &monitors[i];
+                int32_t weight, delta;
+
+                if (!m->active)
+                        continue;
+
+                // next frame of video is due
+                if (m->wallpaper.source_type == WALLPAPER_SOURCE_VIDEO) {
+                        if (video_slot_get(&m->wallpaper.video) == m->video_slot)
+                                continue;
+
+                        if ((err = wallpaper_monitor_render(m, canvas))) {
+                                pr_err("failed to render video frame of monitor %zu\n", i);
+                                continue;
+                        }
+
+                        dirty = 1;
+
+                        continue;
+                }
+
+                if (m->wallpaper.source_type != WALLPAPER_SOURCE_SCHEDULE)
+                        continue;
+
+                weight = (int32_t)schedule_weight_get(m);
+                delta = abs(weight - m->blend.weight);
+
+                // an edited endpoint file shows up even when blend stands still
+                if (wallpaper_blend_cache_valid(m)) {
+                        if (delta == 0)
+                                continue;
+
+                        // always land exactly on endpoints
+                        if (delta < (int32_t)schedule_step_get(m) && weight != 0 && weight != 256)
+                                continue;
+                }
+
+                if ((err = wallpaper_schedule_render(m, canvas))) {
+                        pr_err("failed to blend wallpaper of monitor %zu\n", i);
+                        continue;
+                }
+
+                // blending rewrote the whole monitor area
+                wallpaper_overlays_render(m, canvas);
+
+                pr_info("monitor %zu blend: %d/256\n", i, weight);
+
+                dirty = 1;
+        }
+
+        if (!dirty)
+                return 0;
+
+        if ((err = wallpaper_output_write(canvas)))
+                return err;
+
+        prof_report();
+
+        return wallpaper_desktop_set();
+}
+
+static int wallpaper_schedule_timer_setup(HWND wnd)
+{
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
+                struct monitor *m = &monitors[i];
+
+                if (m->wallpaper.source_type == WALLPAPER_SOURCE_VIDEO) {
+                        if (!m->wallpaper.video.refresh || m->wallpaper.video.step == 0.0)
+                                continue;
+                } else if (m->wallpaper.source_type != WALLPAPER_SOURCE_SCHEDULE) {
+                        continue;
+                }
+
+                if (0 == SetTimer(wnd, SCHEDULE_TIMER_ID, SCHEDULE_TIMER_INTERVAL_MS, NULL)) {
+                        pr_err("SetTimer() failed\n");
+                        return -EFAULT;
+                }
+
+                break;
+        }
+
+        return 0;
+}
+
+//
+// renders skipped while nobody could see the desktop, run before anything
+// else is dispatched and above normal priority, so unlock does not show a
+// stale wallpaper for long
+//
+static void wallpaper_deferred_run(uint32_t pending)
+{
+        HANDLE thread = GetCurrentThread();
+        int prio = GetThreadPriority(thread);
+
+        if (!pending)
+                return;
+
+        SetThreadPriority(thread, THREAD_PRIORITY_HIGHEST);
+
+        if (pending & VISIBILITY_RENDER_UPDATE)
+                wallpaper_update();
+        else if (pending & VISIBILITY_RENDER_REFRESH)
+                wallpaper_schedule_refresh();
+
+        SetThreadPriority(thread, prio);
+}
+
+static void visibility_notify_register(HWND wnd)
+{
+        visibility_init(&visibility);
+
+        if (!WTSRegisterSessionNotification(wnd, NOTIFY_FOR_THIS_SESSION))
+                pr_err("WTSRegisterSessionNotification() failed, err = %lu\n", GetLastError());
+
+        // current state is sent right away
+        display_state_notify = RegisterPowerSettingNotification(wnd, &display_state_guid,
+                                                                DEVICE_NOTIFY_WINDOW_HANDLE);
+        if (!display_state_notify)
+                pr_err("RegisterPowerSettingNotification() failed, err = %lu\n", GetLastError());
+}
+
+static void visibility_notify_unregister(HWND wnd)
+{
+        if (display_state_notify)
+                UnregisterPowerSettingNotification(display_state_notify);
+
+        WTSUnRegisterSessionNotification(wnd);
+}
+
+static LRESULT CALLBACK notify_wnd_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+        POWERBROADCAST_SETTING *ps;
+
+        switch (msg) {
+        case WM_DISPLAYCHANGE:
+                pr_info("display mode changed\n");
+                // pr_info("display changed: bit: %lld %ux%u\n", wparam, LOWORD(lparam), HIWORD(lparam));
+
+                if (visibility_defer(&visibility, VISIBILITY_RENDER_UPDATE)) {
+                        pr_info("desktop not visible, render deferred\n");
+                        return TRUE;
+                }
+
+                wallpaper_update();
+
+                return TRUE;
+
+        case WM_TIMER:
+                if (wparam != SCHEDULE_TIMER_ID)
+                        goto def_proc;
+
+                if (visibility_defer(&visibility, VISIBILITY_RENDER_REFRESH))
+                        return 0;
+
+                wallpaper_schedule_refresh();
+
+                return 0;
+
+        case WM_WTSSESSION_CHANGE:
+                if (wparam == WTS_SESSION_LOCK)
+                        wallpaper_deferred_run(visibility_lock_set(&visibility, 1));
+                else if (wparam == WTS_SESSION_UNLOCK)
+                        wallpaper_deferred_run(visibility_lock_set(&visibility, 0));
+
+                return 0;
+
+        case WM_POWERBROADCAST:
+                if (wparam != PBT_POWERSETTINGCHANGE)
+                        goto def_proc;
+
+                ps = (POWERBROADCAST_SETTING *)lparam;
+
+                if (!IsEqualGUID(&ps->PowerSetting, &display_state_guid) ||
+                    ps->DataLength < sizeof(DWORD))
+                        goto def_proc;
+
+                wallpaper_deferred_run(visibility_display_set(&visibility, *(DWORD *)ps->Data));
+
+                return TRUE;
+
+        default:
+                break;
+        }
+
+def_proc:
+        return DefWindowProc(hwnd, msg, wparam, lparam);
+}
+
+static HANDLE notify_wnd_create(void)
+{
+        HWND wnd = NULL;
+        WNDCLASSEX wc = { 0 };
+
+        wc.cbSize              = sizeof(WNDCLASSEX);
+        wc.lpfnWndProc         = notify_wnd_proc;
         wc.hInstance           = GetModuleHandle(NULL);
         wc.lpszClassName       = L"NotifyWnd";
         if (!RegisterClassEx(&wc)) {
@@ -909,6 +2333,16 @@ static int output_path_set(void)
 
         snprintf(out_path, sizeof(out_path), "%s/wallpaper_generated.%s", workdir, fmt);
 
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++) {
+                int len = snprintf(monitors[i].output.path, sizeof(monitors[i].output.path),
+                                   "%s/wallpaper_monitor%zu.%s", workdir, i, fmt);
+
+                if (len < 0 || (size_t)len >= sizeof(monitors[i].output.path)) {
+                        pr_err("monitor output path too long in workdir \"%s\"\n", workdir);
+                        return -ENAMETOOLONG;
+                }
+        }
+
         if ((err = iconv_utf82wc(out_path, sizeof(out_path), out_path_w, sizeof(out_path_w))))
                 return err;
 
@@ -921,6 +2355,35 @@ static int output_path_set(void)
         return 0;
 }
 
+// "scalar" forces reference kernels, to compare output of vector kernels against
+static void simd_init(void)
+{
+        int simd = CPU_SIMD_NONE;
+
+        switch (g_config.simd_mode) {
+        case SIMD_MODE_AUTO:
+                simd = cpu_simd_detect();
+                break;
+
+        case SIMD_MODE_NEON:
+                if (cpu_simd_supported(CPU_SIMD_NEON))
+                        simd = CPU_SIMD_NEON;
+                else
+                        pr_warn("neon kernels not built (WITH_NEON) or not supported, using scalar\n");
+
+                break;
+
+        default:
+                break;
+        }
+
+        pixel_simd_init(simd);
+        resample_simd_init(simd);
+        procedural_simd_init(simd);
+
+        pr_info("pixel kernels: %s\n", cpu_simd_strs[simd]);
+}
+
 int wmain(int wargc, wchar_t *wargv[])
 {
         HWND notify_wnd = NULL;
@@ -952,17 +2415,45 @@ int wmain(int wargc, wchar_t *wargv[])
         if ((err = output_path_set()))
                 goto exit_usrcfg;
 
+        simd_init();
+        resample_upscale_set(g_config.upscale);
+        resample_upscale_sharpen_set(g_config.upscale_sharpen);
+        resample_linear_set(g_config.linear_light);
+
         InitializeMagick(NULL);
+        vector_init();
+
+        if (g_config.explain) {
+                wallpaper_explain();
+                goto exit_magick;
+        }
 
         if (NULL == (notify_wnd = notify_wnd_create()))
                 goto exit_magick;
 
+        visibility_notify_register(notify_wnd);
+
         wallpaper_update();
 
+        wallpaper_schedule_timer_setup(notify_wnd);
+
         main_thread_wnd_process(1);
 
+        KillTimer(notify_wnd, SCHEDULE_TIMER_ID);
+        visibility_notify_unregister(notify_wnd);
         DestroyWindow(notify_wnd);
 
+        canvas_deinit(&desktop_canvas);
+
+        for (size_t i = 0; i < ARRAY_SIZE(monitors); i++)
+                wallpaper_blend_cache_drop(&monitors[i]);
+
+        for (size_t i = 0; i < ARRAY_SIZE(overlays); i++)
+                overlay_cache_drop(&overlays[i]);
+
+        vector_cache_drop();
+        video_cache_drop();
+
 exit_magick:
         DestroyMagick();
 
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <windows.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "mem.h"
+
+static int large_page_usable = -1;
+
+void *mem_aligned_alloc(size_t size)
+{
+        return _aligned_malloc(ALIGN_UP(size, MEM_ALIGN), MEM_ALIGN);
+}
+
+void mem_aligned_free(void *p)
+{
+        _aligned_free(p);
+}
+
+// large pages need SeLockMemoryPrivilege granted to user, try once
+static int large_page_privilege_acquire(void)
+{
+        TOKEN_PRIVILEGES tp = { .PrivilegeCount = 1 };
+        HANDLE token;
+        int ok = 0;
+
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+                return 0;
+
+        if (LookupPrivilegeValueW(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid)) {
+                tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+                // succeeds with ERROR_NOT_ALL_ASSIGNED if privilege is not held
+                if (AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL) &&
+                    GetLastError() == ERROR_SUCCESS)
+                        ok = 1;
+        }
+
+        CloseHandle(token);
+
+        if (!ok)
+                pr_info("large pages are not available, SeLockMemoryPrivilege is not held\n");
+
+        return ok;
+}
+
+//
+// page aligned and zeroed, backed by large pages when os allows,
+// for buffers which are streamed through by every render pass
+//
+void *mem_huge_alloc(size_t size, uint32_t *large_page)
+{
+        size_t lp_size = GetLargePageMinimum();
+        void *p;
+
+        if (large_page_usable < 0)
+                large_page_usable = lp_size ? large_page_privilege_acquire() : 0;
+
+        if (large_page_usable && size >= lp_size) {
+                p = VirtualAlloc(NULL, ALIGN_UP(size, lp_size),
+                                 MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                 PAGE_READWRITE);
+                if (p) {
+                        if (large_page)
+                                *large_page = 1;
+
+                        return p;
+                }
+
+                // physical memory is too fragmented to get contiguous pages
+                pr_dbg("large page allocation failed, err = %lu\n", GetLastError());
+        }
+
+        if (large_page)
+                *large_page = 0;
+
+        return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void mem_huge_free(void *p)
+{
+        if (p)
+                VirtualFree(p, 0, MEM_RELEASE);
+}
@@ -0,0 +1,19 @@
+#ifndef __TABLET_WALLPAPER_MEM_H__
+#define __TABLET_WALLPAPER_MEM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MEM_ALIGN                       64      // cache line, widest vector load
+
+#ifndef ALIGN_UP
+#define ALIGN_UP(x, a)                  (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+#endif
+
+void *mem_aligned_alloc(size_t size);
+void mem_aligned_free(void *p);
+
+void *mem_huge_alloc(size_t size, uint32_t *large_page);
+void mem_huge_free(void *p);
+
+#endif // __TABLET_WALLPAPER_MEM_H__
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <wand/magick_wand.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "admission.h"
+#include "canvas.h"
+#include "pixel.h"
+#include "source_io.h"
+#include "overlay.h"
+
+char *overlay_anchor_strs[] = {
+        [OVERLAY_ANCHOR_TOP_LEFT]       = "top_left",
+        [OVERLAY_ANCHOR_TOP]            = "top",
+        [OVERLAY_ANCHOR_TOP_RIGHT]      = "top_right",
+        [OVERLAY_ANCHOR_LEFT]           = "left",
+        [OVERLAY_ANCHOR_CENTER]         = "center",
+        [OVERLAY_ANCHOR_RIGHT]          = "right",
+        [OVERLAY_ANCHOR_BOTTOM_LEFT]    = "bottom_left",
+        [OVERLAY_ANCHOR_BOTTOM]         = "bottom",
+        [OVERLAY_ANCHOR_BOTTOM_RIGHT]   = "bottom_right",
+};
+
+// negative: not set in config, opaque
+static double overlay_opacity_get(struct overlay *o)
+{
+        if (o->opacity < 0.0 || o->opacity > 1.0)
+                return 1.0;
+
+        return o->opacity;
+}
+
+void overlay_cache_drop(struct overlay *o)
+{
+        pixel_image_free(&o->cache.img);
+
+        o->cache.mtime = 0;
+        o->cache.opacity = -1.0;
+}
+
+//
+// decode asset into BGRA32 with color premultiplied by alpha and opacity,
+// so blending is a single premultiplied over per pixel
+//
+static int overlay_cache_build(struct overlay *o, double opacity)
+{
+        struct pixel_image src = { 0 };
+        struct pixel_image *img = &o->cache.img;
+        uint32_t op = (uint32_t)(opacity * 255.0 + 0.5);
+        struct admission_hint hint;
+        MagickWand *w;
+        int err;
+
+        if ((err = admission_ping(o->image, &hint)))
+                return err;
+
+        w = NewMagickWand();
+
+        if (hint.width)
+                MagickSetSize(w, hint.width, hint.height);
+
+        if (MagickReadImage(w, o->image) != MagickPass) {
+                pr_err("failed to open overlay image: %s\n", o->image);
+                DestroyMagickWand(w);
+                return -EIO;
+        }
+
+        err = pixel_image_from_wand(&src, w);
+        DestroyMagickWand(w);
+
+        if (err)
+                return err;
+
+        if ((err = pixel_image_init(img, src.width, src.height, PIXEL_BGRA32, 1)))
+                goto out;
+
+        for (uint32_t y = 0; y < src.height; y++) {
+                uint8_t *p = img->data + (size_t)y * img->stride;
+
+                src.ops->swizzle(p, pixel_image_row(&src, y), src.width);
+
+                for (uint32_t x = 0; x < src.width; x++, p += 4) {
+                        uint32_t a = (p[3] * op + 127) / 255;
+
+                        p[0] = (uint8_t)((p[0] * a + 127) / 255);
+                        p[1] = (uint8_t)((p[1] * a + 127) / 255);
+                        p[2] = (uint8_t)((p[2] * a + 127) / 255);
+                        p[3] = (uint8_t)a;
+                }
+        }
+
+        pr_info("overlay cached: %s %ux%u\n", o->image, img->width, img->height);
+
+out:
+        pixel_image_free(&src);
+
+        return err;
+}
+
+static int overlay_cache_update(struct overlay *o)
+{
+        double opacity = overlay_opacity_get(o);
+        uint64_t mtime = 0;
+        int err;
+
+        if ((err = source_stat(o->image, NULL, &mtime))) {
+                pr_err("overlay image not found: %s\n", o->image);
+                return err;
+        }
+
+        if (o->cache.img.data && o->cache.mtime == mtime && o->cache.opacity == opacity)
+                return 0;
+
+        overlay_cache_drop(o);
+
+        if ((err = overlay_cache_build(o, opacity)))
+                return err;
+
+        o->cache.mtime = mtime;
+        o->cache.opacity = opacity;
+
+        return 0;
+}
+
+// 0: start, 1: center, 2: end of axis
+static int32_t overlay_axis_pos(int32_t start, uint32_t len, uint32_t size, int align, int32_t offset)
+{
+        switch (align) {
+        case 1:
+                return start + ((int32_t)len - (int32_t)size) / 2 + offset;
+        case 2:
+                return start + (int32_t)len - (int32_t)size - offset;
+        default:
+                return start + offset;
+        }
+}
+
+// blend cached overlay over monitor area @mon, only its bounding box is touched
+int overlay_render(struct canvas *c, struct rectangle *mon, struct overlay *o)
+{
+        struct pixel_image *img = &o->cache.img;
+        struct rectangle rc;
+        int64_t x0, y0, x1, y1;
+        int32_t x, y;
+        int err;
+
+        if (!o->image || o->image[0] == '\0')
+                return -ENODATA;
+
+        if (o->anchor < 0 || o->anchor >= NUM_OVERLAY_ANCHORS)
+                return -EINVAL;
+
+        // fully transparent, nothing to decode or blend
+        if (overlay_opacity_get(o) == 0.0)
+                return 0;
+
+        if ((err = overlay_cache_update(o)))
+                return err;
+
+        x = overlay_axis_pos(mon->x, mon->width, img->width, o->anchor % 3, o->offset_x);
+        y = overlay_axis_pos(mon->y, mon->height, img->height, o->anchor / 3, o->offset_y);
+
+        x0 = max((int64_t)x, (int64_t)mon->x);
+        y0 = max((int64_t)y, (int64_t)mon->y);
+        x1 = min((int64_t)x + img->width, (int64_t)mon->x + mon->width);
+        y1 = min((int64_t)y + img->height, (int64_t)mon->y + mon->height);
+
+        if (x1 <= x0 || y1 <= y0)
+                return 0;
+
+        rc = (struct rectangle){ (int32_t)x0, (int32_t)y0, (uint32_t)(x1 - x0), (uint32_t)(y1 - y0) };
+
+        if (canvas_rect_clip(c, &rc))
+                return 0;
+
+        for (uint32_t i = 0; i < rc.height; i++) {
+                const uint8_t *src = pixel_image_row(img, rc.y - y + i) + (size_t)(rc.x - x) * 4;
+
+                pixel_blend_premul_row(canvas_pixel(c, rc.x, rc.y + i), src, rc.width);
+        }
+
+        return 0;
+}
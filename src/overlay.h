@@ -0,0 +1,43 @@
+#ifndef __TABLET_WALLPAPER_OVERLAY_H__
+#define __TABLET_WALLPAPER_OVERLAY_H__
+
+#include <stdint.h>
+
+#include "canvas.h"
+#include "pixel.h"
+
+enum overlay_anchor {
+        OVERLAY_ANCHOR_TOP_LEFT = 0,
+        OVERLAY_ANCHOR_TOP,
+        OVERLAY_ANCHOR_TOP_RIGHT,
+        OVERLAY_ANCHOR_LEFT,
+        OVERLAY_ANCHOR_CENTER,
+        OVERLAY_ANCHOR_RIGHT,
+        OVERLAY_ANCHOR_BOTTOM_LEFT,
+        OVERLAY_ANCHOR_BOTTOM,
+        OVERLAY_ANCHOR_BOTTOM_RIGHT,
+        NUM_OVERLAY_ANCHORS,
+};
+
+extern char *overlay_anchor_strs[];
+
+struct overlay {
+        int32_t         monitor;        // index in monitor list, -1: all
+        char           *image;
+        int             anchor;
+        int32_t         offset_x;       // towards monitor center from anchored edge
+        int32_t         offset_y;
+        double          opacity;        // [0, 1], -1: not set, opaque
+
+        // decoded once, premultiplied with opacity applied
+        struct {
+                struct pixel_image      img;
+                uint64_t                mtime;
+                double                  opacity;
+        } cache;
+};
+
+int overlay_render(struct canvas *c, struct rectangle *mon, struct overlay *o);
+void overlay_cache_drop(struct overlay *o);
+
+#endif // __TABLET_WALLPAPER_OVERLAY_H__
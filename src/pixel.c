@@ -0,0 +1,969 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "cpu.h"
+
+#ifdef HAVE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef HAVE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#include <wand/magick_wand.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "mem.h"
+#include "canvas.h"
+#include "pixel.h"
+
+//
+// byte offset of each channel per layout, layouts without alpha
+// channel read constant 0xff, grey replicates into all channels
+//
+#define RGB24_BPP                       3
+#define RGB24_B                         2
+#define RGB24_G                         1
+#define RGB24_R                         0
+#define RGB24_A                         0
+#define RGB24_HAS_A                     0
+#define RGB24_MAP                       "RGB"
+
+#define RGBA32_BPP                      4
+#define RGBA32_B                        2
+#define RGBA32_G                        1
+#define RGBA32_R                        0
+#define RGBA32_A                        3
+#define RGBA32_HAS_A                    1
+#define RGBA32_MAP                      "RGBA"
+
+#define BGRA32_BPP                      4
+#define BGRA32_B                        0
+#define BGRA32_G                        1
+#define BGRA32_R                        2
+#define BGRA32_A                        3
+#define BGRA32_HAS_A                    1
+#define BGRA32_MAP                      "BGRA"
+
+#define GREY8_BPP                       1
+#define GREY8_B                         0
+#define GREY8_G                         0
+#define GREY8_R                         0
+#define GREY8_A                         0
+#define GREY8_HAS_A                     0
+#define GREY8_MAP                       "I"
+
+#define PX_B(L, p)                      ((p)[L##_B])
+#define PX_G(L, p)                      ((p)[L##_G])
+#define PX_R(L, p)                      ((p)[L##_R])
+#define PX_A(L, p)                      (L##_HAS_A ? (p)[L##_A] : 0xff)
+
+static inline uint32_t div255(uint32_t v)
+{
+        v += 128;
+
+        return (v + (v >> 8)) >> 8;
+}
+
+static inline uint8_t bgra_luma(uint32_t bgra)
+{
+        uint32_t b = bgra & 0xff, g = (bgra >> 8) & 0xff, r = (bgra >> 16) & 0xff;
+
+        // BT.601, 8bit fixed point
+        return (uint8_t)((r * 77 + g * 150 + b * 29 + 128) >> 8);
+}
+
+#define DEFINE_BLIT_OPAQUE(L)                                                   \
+static void blit_##L##_opaque(uint8_t *dst, const uint8_t *src, uint32_t n)    \
+{                                                                               \
+        for (uint32_t i = 0; i < n; i++, dst += 4, src += L##_BPP) {           \
+                dst[0] = PX_B(L, src);                                          \
+                dst[1] = PX_G(L, src);                                          \
+                dst[2] = PX_R(L, src);                                          \
+                dst[3] = 0xff;                                                  \
+        }                                                                       \
+}
+
+#define DEFINE_BLIT_ALPHA(L)                                                    \
+static void blit_##L##_alpha(uint8_t *dst, const uint8_t *src, uint32_t n)     \
+{                                                                               \
+        for (uint32_t i = 0; i < n; i++, dst += 4, src += L##_BPP) {           \
+                uint32_t a = PX_A(L, src);                                      \
+                                                                                \
+                dst[0] = (uint8_t)div255(PX_B(L, src) * a + dst[0] * (0xff - a)); \
+                dst[1] = (uint8_t)div255(PX_G(L, src) * a + dst[1] * (0xff - a)); \
+                dst[2] = (uint8_t)div255(PX_R(L, src) * a + dst[2] * (0xff - a)); \
+                dst[3] = 0xff;                                                  \
+        }                                                                       \
+}
+
+#define DEFINE_FILL(L)                                                          \
+static void fill_##L(uint8_t *dst, uint32_t n, uint32_t bgra)                   \
+{                                                                               \
+        uint8_t px[4] = { 0 };                                                  \
+                                                                                \
+        if (L##_BPP == 1) {                                                     \
+                memset(dst, bgra_luma(bgra), n);                                \
+                return;                                                         \
+        }                                                                       \
+                                                                                \
+        px[L##_B] = bgra & 0xff;                                                \
+        px[L##_G] = (bgra >> 8) & 0xff;                                         \
+        px[L##_R] = (bgra >> 16) & 0xff;                                        \
+        if (L##_HAS_A)                                                          \
+                px[L##_A] = (bgra >> 24) & 0xff;                                \
+                                                                                \
+        for (uint32_t i = 0; i < n; i++, dst += L##_BPP)                        \
+                memcpy(dst, px, L##_BPP);                                       \
+}
+
+#define DEFINE_SWIZZLE(L, ALPHA)                                                \
+static void swizzle_##L##_##ALPHA(uint8_t *dst, const uint8_t *src, uint32_t n) \
+{                                                                               \
+        for (uint32_t i = 0; i < n; i++, dst += 4, src += L##_BPP) {           \
+                dst[0] = PX_B(L, src);                                          \
+                dst[1] = PX_G(L, src);                                          \
+                dst[2] = PX_R(L, src);                                          \
+                dst[3] = ALPHA ? PX_A(L, src) : 0xff;                           \
+        }                                                                       \
+}
+
+//
+// horizontal pass, output is BGRA in RESAMPLE_INTER_BITS fixed point,
+// alpha variants premultiply on load so transparent pixels do not bleed
+//
+#define DEFINE_RESAMPLE_H(L, ALPHA)                                             \
+static void resample_h_##L##_##ALPHA(uint16_t *dst, const uint8_t *src,        \
+                                     const struct resample_axis *ax,            \
+                                     uint32_t cnt)                              \
+{                                                                               \
+        const int32_t shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_INTER_BITS;       \
+        const int32_t round = 1 << (shift - 1);                                 \
+                                                                                \
+        for (uint32_t x = 0; x < cnt; x++, dst += 4) {                          \
+                const int16_t *w = &ax->weights[(size_t)x * ax->taps];          \
+                const uint8_t *p = src + (size_t)ax->start[x] * L##_BPP;        \
+                int32_t b = 0, g = 0, r = 0, a = 0;                             \
+                                                                                \
+                for (uint32_t j = 0; j < ax->count[x]; j++, p += L##_BPP) {     \
+                        if (ALPHA) {                                            \
+                                uint32_t pa = PX_A(L, p);                       \
+                                                                                \
+                                b += w[j] * (int32_t)div255(PX_B(L, p) * pa);   \
+                                g += w[j] * (int32_t)div255(PX_G(L, p) * pa);   \
+                                r += w[j] * (int32_t)div255(PX_R(L, p) * pa);   \
+                                a += w[j] * (int32_t)pa;                        \
+                        } else {                                                \
+                                b += w[j] * PX_B(L, p);                         \
+                                g += w[j] * PX_G(L, p);                         \
+                                r += w[j] * PX_R(L, p);                         \
+                        }                                                       \
+                }                                                               \
+                                                                                \
+                dst[0] = (uint16_t)((b + round) >> shift);                      \
+                dst[1] = (uint16_t)((g + round) >> shift);                      \
+                dst[2] = (uint16_t)((r + round) >> shift);                      \
+                dst[3] = ALPHA ? (uint16_t)((a + round) >> shift) :             \
+                                 (uint16_t)(0xff << RESAMPLE_INTER_BITS);       \
+        }                                                                       \
+}
+
+//
+// linear light variant for opaque sources, table lookup is fused into
+// load, weights sum to 1 << RESAMPLE_WEIGHT_BITS so 15bit input fits int32
+//
+#define DEFINE_RESAMPLE_H_LINEAR(L)                                             \
+static void resample_h_linear_##L(uint16_t *dst, const uint8_t *src,           \
+                                  const struct resample_axis *ax,               \
+                                  uint32_t cnt)                                 \
+{                                                                               \
+        const uint16_t *lut = resample_srgb_linear;                             \
+        const int32_t round = 1 << (RESAMPLE_WEIGHT_BITS - 1);                  \
+                                                                                \
+        for (uint32_t x = 0; x < cnt; x++, dst += 4) {                          \
+                const int16_t *w = &ax->weights[(size_t)x * ax->taps];          \
+                const uint8_t *p = src + (size_t)ax->start[x] * L##_BPP;        \
+                int32_t b = 0, g = 0, r = 0;                                    \
+                                                                                \
+                for (uint32_t j = 0; j < ax->count[x]; j++, p += L##_BPP) {     \
+                        b += w[j] * lut[PX_B(L, p)];                            \
+                        g += w[j] * lut[PX_G(L, p)];                            \
+                        r += w[j] * lut[PX_R(L, p)];                            \
+                }                                                               \
+                                                                                \
+                dst[0] = (uint16_t)((b + round) >> RESAMPLE_WEIGHT_BITS);       \
+                dst[1] = (uint16_t)((g + round) >> RESAMPLE_WEIGHT_BITS);       \
+                dst[2] = (uint16_t)((r + round) >> RESAMPLE_WEIGHT_BITS);       \
+                dst[3] = (uint16_t)(0xff << RESAMPLE_INTER_BITS);               \
+        }                                                                       \
+}
+
+#define DEFINE_LAYOUT_KERNELS(L)                                                \
+        DEFINE_BLIT_OPAQUE(L)                                                   \
+        DEFINE_FILL(L)                                                          \
+        DEFINE_SWIZZLE(L, 0)                                                    \
+        DEFINE_RESAMPLE_H(L, 0)                                                 \
+        DEFINE_RESAMPLE_H_LINEAR(L)
+
+// only layouts which carry an alpha channel
+#define DEFINE_LAYOUT_ALPHA_KERNELS(L)                                          \
+        DEFINE_BLIT_ALPHA(L)                                                    \
+        DEFINE_SWIZZLE(L, 1)                                                    \
+        DEFINE_RESAMPLE_H(L, 1)
+
+DEFINE_LAYOUT_KERNELS(RGB24)
+DEFINE_LAYOUT_KERNELS(RGBA32)
+DEFINE_LAYOUT_KERNELS(BGRA32)
+DEFINE_LAYOUT_KERNELS(GREY8)
+
+DEFINE_LAYOUT_ALPHA_KERNELS(RGBA32)
+DEFINE_LAYOUT_ALPHA_KERNELS(BGRA32)
+
+// dst = src + dst * (1 - src.a), src is premultiplied
+static void blend_premul_scalar(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        for (uint32_t i = 0; i < n; i++) {
+                const uint8_t *s = &src[i * 4];
+                uint8_t *d = &dst[i * 4];
+                uint32_t ia = 0xff - s[3];
+
+                for (int ch = 0; ch < 4; ch++)
+                        d[ch] = (uint8_t)min(0xffU, s[ch] + div255(d[ch] * ia));
+        }
+}
+
+// dst = a + (b - a) * weight / 256, n is in bytes
+static void lerp_scalar(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n, uint32_t weight)
+{
+        uint32_t inv = 256 - weight;
+
+        for (size_t i = 0; i < n; i++)
+                dst[i] = (uint8_t)((a[i] * inv + b[i] * weight) >> 8);
+}
+
+// repeat every BGRA pixel @k times
+static void replicate_scalar(uint32_t *dst, const uint32_t *src, uint32_t n, uint32_t k)
+{
+        for (uint32_t i = 0; i < n; i++) {
+                for (uint32_t j = 0; j < k; j++)
+                        *dst++ = src[i];
+        }
+}
+
+// BGRA row to 8bit luma, same weights as bgra_luma()
+static void luma_scalar(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        for (uint32_t i = 0; i < n; i++, src += 4)
+                dst[i] = (uint8_t)((src[2] * 77 + src[1] * 150 + src[0] * 29 + 128) >> 8);
+}
+
+#ifdef HAVE_SIMD_SSE2
+static void blit_BGRA32_opaque_sse2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        const __m128i opaque = _mm_set1_epi32((int)0xff000000U);
+        uint32_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)&src[i * 4]);
+
+                _mm_storeu_si128((__m128i *)&dst[i * 4], _mm_or_si128(v, opaque));
+        }
+
+        blit_BGRA32_opaque(&dst[i * 4], &src[i * 4], n - i);
+}
+
+static void blit_RGBA32_opaque_sse2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        const __m128i opaque = _mm_set1_epi32((int)0xff000000U);
+        const __m128i mask_g = _mm_set1_epi32(0x0000ff00);
+        const __m128i mask_b = _mm_set1_epi32(0x000000ff);
+        uint32_t i = 0;
+
+        // swap R and B within each dword
+        for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)&src[i * 4]);
+                __m128i g = _mm_and_si128(v, mask_g);
+                __m128i r = _mm_and_si128(v, mask_b);
+                __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), mask_b);
+
+                v = _mm_or_si128(_mm_or_si128(g, b), _mm_or_si128(_mm_slli_epi32(r, 16), opaque));
+                _mm_storeu_si128((__m128i *)&dst[i * 4], v);
+        }
+
+        blit_RGBA32_opaque(&dst[i * 4], &src[i * 4], n - i);
+}
+
+static inline __m128i div255_epu16(__m128i v)
+{
+        v = _mm_add_epi16(v, _mm_set1_epi16(128));
+
+        return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+static void blit_BGRA32_alpha_sse2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i v255 = _mm_set1_epi16(0xff);
+        const __m128i opaque = _mm_set1_epi32((int)0xff000000U);
+        uint32_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+                __m128i s = _mm_loadu_si128((const __m128i *)&src[i * 4]);
+                __m128i d = _mm_loadu_si128((const __m128i *)&dst[i * 4]);
+                __m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero);
+                __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+                __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xff), 0xff);
+                __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xff), 0xff);
+
+                s_lo = _mm_add_epi16(_mm_mullo_epi16(s_lo, a_lo), _mm_mullo_epi16(d_lo, _mm_sub_epi16(v255, a_lo)));
+                s_hi = _mm_add_epi16(_mm_mullo_epi16(s_hi, a_hi), _mm_mullo_epi16(d_hi, _mm_sub_epi16(v255, a_hi)));
+
+                d = _mm_packus_epi16(div255_epu16(s_lo), div255_epu16(s_hi));
+                _mm_storeu_si128((__m128i *)&dst[i * 4], _mm_or_si128(d, opaque));
+        }
+
+        blit_BGRA32_alpha(&dst[i * 4], &src[i * 4], n - i);
+}
+
+static void blend_premul_sse2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i v255 = _mm_set1_epi16(0xff);
+        uint32_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+                __m128i s = _mm_loadu_si128((const __m128i *)&src[i * 4]);
+                __m128i d = _mm_loadu_si128((const __m128i *)&dst[i * 4]);
+                __m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero);
+                __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+                __m128i ia_lo = _mm_sub_epi16(v255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xff), 0xff));
+                __m128i ia_hi = _mm_sub_epi16(v255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xff), 0xff));
+
+                d_lo = div255_epu16(_mm_mullo_epi16(d_lo, ia_lo));
+                d_hi = div255_epu16(_mm_mullo_epi16(d_hi, ia_hi));
+
+                _mm_storeu_si128((__m128i *)&dst[i * 4], _mm_adds_epu8(s, _mm_packus_epi16(d_lo, d_hi)));
+        }
+
+        blend_premul_scalar(&dst[i * 4], &src[i * 4], n - i);
+}
+
+static void lerp_sse2(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n, uint32_t weight)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i vw = _mm_set1_epi16((int16_t)weight);
+        const __m128i vinv = _mm_set1_epi16((int16_t)(256 - weight));
+        size_t i = 0;
+
+        // a * inv + b * w <= 255 * 256, fits in unsigned 16 bits
+        for (; i + 16 <= n; i += 16) {
+                __m128i va = _mm_loadu_si128((const __m128i *)&a[i]);
+                __m128i vb = _mm_loadu_si128((const __m128i *)&b[i]);
+                __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), vinv),
+                                           _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), vw));
+                __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), vinv),
+                                           _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), vw));
+
+                _mm_storeu_si128((__m128i *)&dst[i],
+                                 _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+        }
+
+        lerp_scalar(&dst[i], &a[i], &b[i], n - i, weight);
+}
+
+static void replicate_sse2(uint32_t *dst, const uint32_t *src, uint32_t n, uint32_t k)
+{
+        uint32_t i = 0;
+
+        if (k == 2) {
+                for (; i + 4 <= n; i += 4, dst += 8) {
+                        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+
+                        _mm_storeu_si128((__m128i *)&dst[0], _mm_unpacklo_epi32(v, v));
+                        _mm_storeu_si128((__m128i *)&dst[4], _mm_unpackhi_epi32(v, v));
+                }
+        } else if (k == 3) {
+                for (; i + 4 <= n; i += 4, dst += 12) {
+                        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+
+                        _mm_storeu_si128((__m128i *)&dst[0], _mm_shuffle_epi32(v, 0x40));
+                        _mm_storeu_si128((__m128i *)&dst[4], _mm_shuffle_epi32(v, 0xa5));
+                        _mm_storeu_si128((__m128i *)&dst[8], _mm_shuffle_epi32(v, 0xfe));
+                }
+        } else if (k >= 4) {
+                // last splat overlaps the previous one instead of a scalar tail
+                for (; i < n; i++, dst += k) {
+                        __m128i v = _mm_set1_epi32((int)src[i]);
+                        uint32_t j = 0;
+
+                        for (; j + 4 < k; j += 4)
+                                _mm_storeu_si128((__m128i *)&dst[j], v);
+
+                        _mm_storeu_si128((__m128i *)&dst[k - 4], v);
+                }
+        }
+
+        replicate_scalar(dst, &src[i], n - i, k);
+}
+
+static void luma_sse2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        const __m128i wt = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+        const __m128i vround = _mm_set1_epi32(128);
+        const __m128i zero = _mm_setzero_si128();
+        uint32_t i = 0;
+
+        // madd gives b+g and r+a per pixel, fold the pairs with a 64bit shift
+        for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)&src[i * 4]);
+                __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), wt);
+                __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), wt);
+                __m128i y;
+                int32_t out;
+
+                lo = _mm_shuffle_epi32(_mm_add_epi32(lo, _mm_srli_epi64(lo, 32)), _MM_SHUFFLE(3, 3, 2, 0));
+                hi = _mm_shuffle_epi32(_mm_add_epi32(hi, _mm_srli_epi64(hi, 32)), _MM_SHUFFLE(3, 3, 2, 0));
+                y = _mm_srli_epi32(_mm_add_epi32(_mm_unpacklo_epi64(lo, hi), vround), 8);
+                y = _mm_packus_epi16(_mm_packs_epi32(y, y), zero);
+                out = _mm_cvtsi128_si32(y);
+
+                memcpy(&dst[i], &out, sizeof(out));
+        }
+
+        luma_scalar(&dst[i], &src[i * 4], n - i);
+}
+#endif
+
+#ifdef HAVE_SIMD_NEON
+//
+// BGRA opaque blit only ORs in alpha, plain vld1/vst1 of 4 pixels,
+// kernels below which touch single channels use vld4/vst4 to
+// deinterleave 16 pixels into one register per channel
+//
+static void blit_BGRA32_opaque_neon(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        const uint32x4_t opaque = vdupq_n_u32(0xff000000U);
+        uint32_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+                uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(&src[i * 4]));
+
+                vst1q_u8(&dst[i * 4], vreinterpretq_u8_u32(vorrq_u32(v, opaque)));
+        }
+
+        blit_BGRA32_opaque(&dst[i * 4], &src[i * 4], n - i);
+}
+
+static void blit_RGBA32_opaque_neon(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        uint32_t i = 0;
+
+        for (; i + 16 <= n; i += 16) {
+                uint8x16x4_t s = vld4q_u8(&src[i * 4]);
+                uint8x16x4_t d;
+
+                d.val[0] = s.val[2];
+                d.val[1] = s.val[1];
+                d.val[2] = s.val[0];
+                d.val[3] = vdupq_n_u8(0xff);
+
+                vst4q_u8(&dst[i * 4], d);
+        }
+
+        blit_RGBA32_opaque(&dst[i * 4], &src[i * 4], n - i);
+}
+
+// (v + 128 + ((v + 128) >> 8)) >> 8, same rounding as div255()
+static inline uint8x8_t div255_u16_neon(uint16x8_t v)
+{
+        return vrshrn_n_u16(vrsraq_n_u16(v, v, 8), 8);
+}
+
+static inline uint8x16_t blend_ch_neon(uint8x16_t s, uint8x16_t d, uint8x16_t a, uint8x16_t ia)
+{
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(s), vget_low_u8(a)), vget_low_u8(d), vget_low_u8(ia));
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(s), vget_high_u8(a)), vget_high_u8(d), vget_high_u8(ia));
+
+        return vcombine_u8(div255_u16_neon(lo), div255_u16_neon(hi));
+}
+
+static void blit_BGRA32_alpha_neon(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        uint32_t i = 0;
+
+        for (; i + 16 <= n; i += 16) {
+                uint8x16x4_t s = vld4q_u8(&src[i * 4]);
+                uint8x16x4_t d = vld4q_u8(&dst[i * 4]);
+                uint8x16_t a = s.val[3];
+                uint8x16_t ia = vmvnq_u8(a);
+
+                for (int ch = 0; ch < 3; ch++)
+                        d.val[ch] = blend_ch_neon(s.val[ch], d.val[ch], a, ia);
+
+                d.val[3] = vdupq_n_u8(0xff);
+
+                vst4q_u8(&dst[i * 4], d);
+        }
+
+        blit_BGRA32_alpha(&dst[i * 4], &src[i * 4], n - i);
+}
+
+static void blend_premul_neon(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        uint32_t i = 0;
+
+        for (; i + 16 <= n; i += 16) {
+                uint8x16x4_t s = vld4q_u8(&src[i * 4]);
+                uint8x16x4_t d = vld4q_u8(&dst[i * 4]);
+                uint8x16_t ia = vmvnq_u8(s.val[3]);
+
+                for (int ch = 0; ch < 4; ch++) {
+                        uint16x8_t lo = vmull_u8(vget_low_u8(d.val[ch]), vget_low_u8(ia));
+                        uint16x8_t hi = vmull_u8(vget_high_u8(d.val[ch]), vget_high_u8(ia));
+
+                        d.val[ch] = vqaddq_u8(s.val[ch], vcombine_u8(div255_u16_neon(lo),
+                                                                     div255_u16_neon(hi)));
+                }
+
+                vst4q_u8(&dst[i * 4], d);
+        }
+
+        blend_premul_scalar(&dst[i * 4], &src[i * 4], n - i);
+}
+
+static void lerp_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n, uint32_t weight)
+{
+        const uint16_t w = (uint16_t)weight, inv = (uint16_t)(256 - weight);
+        size_t i = 0;
+
+        // weights may be 256, widen before multiply instead of vmull_u8
+        for (; i + 16 <= n; i += 16) {
+                uint8x16_t va = vld1q_u8(&a[i]);
+                uint8x16_t vb = vld1q_u8(&b[i]);
+                uint16x8_t lo = vmlaq_n_u16(vmulq_n_u16(vmovl_u8(vget_low_u8(va)), inv),
+                                            vmovl_u8(vget_low_u8(vb)), w);
+                uint16x8_t hi = vmlaq_n_u16(vmulq_n_u16(vmovl_u8(vget_high_u8(va)), inv),
+                                            vmovl_u8(vget_high_u8(vb)), w);
+
+                vst1q_u8(&dst[i], vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+        }
+
+        lerp_scalar(&dst[i], &a[i], &b[i], n - i, weight);
+}
+
+static void replicate_neon(uint32_t *dst, const uint32_t *src, uint32_t n, uint32_t k)
+{
+        uint32_t i = 0;
+
+        // interleaving stores of the same register repeat each lane
+        if (k == 2) {
+                for (; i + 4 <= n; i += 4, dst += 8) {
+                        uint32x4_t v = vld1q_u32(&src[i]);
+
+                        vst2q_u32(dst, (uint32x4x2_t){ { v, v } });
+                }
+        } else if (k == 3) {
+                for (; i + 4 <= n; i += 4, dst += 12) {
+                        uint32x4_t v = vld1q_u32(&src[i]);
+
+                        vst3q_u32(dst, (uint32x4x3_t){ { v, v, v } });
+                }
+        } else if (k >= 4) {
+                for (; i < n; i++, dst += k) {
+                        uint32x4_t v = vdupq_n_u32(src[i]);
+                        uint32_t j = 0;
+
+                        for (; j + 4 < k; j += 4)
+                                vst1q_u32(&dst[j], v);
+
+                        vst1q_u32(&dst[k - 4], v);
+                }
+        }
+
+        replicate_scalar(dst, &src[i], n - i, k);
+}
+
+static void luma_neon(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        uint32_t i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+                uint8x8x4_t v = vld4_u8(&src[i * 4]);
+                uint16x8_t acc = vmull_u8(v.val[2], vdup_n_u8(77));
+
+                acc = vmlal_u8(acc, v.val[1], vdup_n_u8(150));
+                acc = vmlal_u8(acc, v.val[0], vdup_n_u8(29));
+
+                vst1_u8(&dst[i], vrshrn_n_u16(acc, 8));
+        }
+
+        luma_scalar(&dst[i], &src[i * 4], n - i);
+}
+#endif
+
+static void (*blend_premul)(uint8_t *dst, const uint8_t *src, uint32_t n) = blend_premul_scalar;
+static void (*lerp)(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n, uint32_t weight) = lerp_scalar;
+static void (*replicate)(uint32_t *dst, const uint32_t *src, uint32_t n, uint32_t k) = replicate_scalar;
+static void (*luma)(uint8_t *dst, const uint8_t *src, uint32_t n) = luma_scalar;
+
+void pixel_blend_premul_row(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        blend_premul(dst, src, n);
+}
+
+void pixel_lerp_row(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n, uint32_t weight)
+{
+        lerp(dst, a, b, n, weight);
+}
+
+void pixel_luma_row(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        luma(dst, src, n);
+}
+
+static const uint8_t bayer4[16] = {
+         0,  8,  2, 10,
+        12,  4, 14,  6,
+         3, 11,  1,  9,
+        15,  7, 13,  5,
+};
+
+//
+// ordered dither, unlike error diffusion a pixel only depends on its own
+// position, so unchanged areas stay identical between renders and e-ink
+// partial refresh does not shimmer, @levels out of [2, 255] disables it
+//
+void pixel_dither_init(struct pixel_dither *d, uint32_t levels)
+{
+        d->levels = levels >= 2 && levels < 256 ? levels : 0;
+
+        for (uint32_t t = 0; t < ARRAY_SIZE(d->lut); t++) {
+                double th = (bayer4[t] + 0.5) / 16.0;
+
+                for (uint32_t v = 0; v < 256; v++) {
+                        double q;
+
+                        if (!d->levels) {
+                                d->lut[t][v] = (uint8_t)v;
+                                continue;
+                        }
+
+                        q = floor(v * (d->levels - 1) / 255.0 + th);
+                        q = min(q, (double)(d->levels - 1));
+                        d->lut[t][v] = (uint8_t)lround(q * 255.0 / (d->levels - 1));
+                }
+        }
+}
+
+// @x0, @y are position of row, keep pattern fixed to panel
+void pixel_dither_row(const struct pixel_dither *d, uint8_t *row, uint32_t n, uint32_t x0, uint32_t y)
+{
+        const uint8_t (*lut)[256] = &d->lut[(y & 3) * 4];
+
+        if (!d->levels)
+                return;
+
+        for (uint32_t i = 0; i < n; i++)
+                row[i] = lut[(x0 + i) & 3][row[i]];
+}
+
+#define PIXEL_OPS(L, ALPHA, BLIT)                                               \
+        {                                                                       \
+                .name           = #L,                                           \
+                .map            = L##_MAP,                                      \
+                .bpp            = L##_BPP,                                      \
+                .alpha          = ALPHA,                                        \
+                .blit           = BLIT,                                         \
+                .fill           = fill_##L,                                     \
+                .swizzle        = swizzle_##L##_##ALPHA,                        \
+                .resample_h     = resample_h_##L##_##ALPHA,                     \
+                .resample_h_linear = ALPHA ? NULL : resample_h_linear_##L,      \
+                .store          = ALPHA ? blend_premul_scalar : blit_BGRA32_opaque, \
+        }
+
+// scalar reference kernels, patched by pixel_simd_init()
+static struct pixel_ops pixel_ops_table[NUM_PIXEL_LAYOUTS][2] = {
+        [PIXEL_RGB24] = {
+                PIXEL_OPS(RGB24, 0, blit_RGB24_opaque),
+                PIXEL_OPS(RGB24, 0, blit_RGB24_opaque),
+        },
+        [PIXEL_RGBA32] = {
+                PIXEL_OPS(RGBA32, 0, blit_RGBA32_opaque),
+                PIXEL_OPS(RGBA32, 1, blit_RGBA32_alpha),
+        },
+        [PIXEL_BGRA32] = {
+                PIXEL_OPS(BGRA32, 0, blit_BGRA32_opaque),
+                PIXEL_OPS(BGRA32, 1, blit_BGRA32_alpha),
+        },
+        [PIXEL_GREY8] = {
+                PIXEL_OPS(GREY8, 0, blit_GREY8_opaque),
+                PIXEL_OPS(GREY8, 0, blit_GREY8_opaque),
+        },
+};
+
+//
+// select kernel set once at startup, must be called before any render,
+// layouts without a vector kernel keep their scalar one
+//
+void pixel_simd_init(int simd)
+{
+        void (*blit_bgra_opaque)(uint8_t *, const uint8_t *, uint32_t) = blit_BGRA32_opaque;
+        void (*blit_rgba_opaque)(uint8_t *, const uint8_t *, uint32_t) = blit_RGBA32_opaque;
+        void (*blit_bgra_alpha)(uint8_t *, const uint8_t *, uint32_t) = blit_BGRA32_alpha;
+
+        blend_premul = blend_premul_scalar;
+        lerp = lerp_scalar;
+        replicate = replicate_scalar;
+        luma = luma_scalar;
+
+        switch (simd) {
+#ifdef HAVE_SIMD_SSE2
+        case CPU_SIMD_SSE2:
+                blit_bgra_opaque = blit_BGRA32_opaque_sse2;
+                blit_rgba_opaque = blit_RGBA32_opaque_sse2;
+                blit_bgra_alpha = blit_BGRA32_alpha_sse2;
+                blend_premul = blend_premul_sse2;
+                lerp = lerp_sse2;
+                replicate = replicate_sse2;
+                luma = luma_sse2;
+                break;
+#endif
+
+#ifdef HAVE_SIMD_NEON
+        case CPU_SIMD_NEON:
+                blit_bgra_opaque = blit_BGRA32_opaque_neon;
+                blit_rgba_opaque = blit_RGBA32_opaque_neon;
+                blit_bgra_alpha = blit_BGRA32_alpha_neon;
+                blend_premul = blend_premul_neon;
+                lerp = lerp_neon;
+                replicate = replicate_neon;
+                luma = luma_neon;
+                break;
+#endif
+
+        default:
+                break;
+        }
+
+        pixel_ops_table[PIXEL_RGBA32][0].blit = blit_rgba_opaque;
+        pixel_ops_table[PIXEL_BGRA32][0].blit = blit_bgra_opaque;
+        pixel_ops_table[PIXEL_BGRA32][1].blit = blit_bgra_alpha;
+
+        for (int l = 0; l < NUM_PIXEL_LAYOUTS; l++) {
+                for (int a = 0; a < 2; a++) {
+                        struct pixel_ops *ops = &pixel_ops_table[l][a];
+
+                        ops->store = ops->alpha ? blend_premul : blit_bgra_opaque;
+                }
+        }
+}
+
+//
+// pick kernels once per image, hot loops then run without per-pixel
+// branches on layout or alpha
+//
+const struct pixel_ops *pixel_ops_get(int layout, int alpha)
+{
+        if (layout < 0 || layout >= NUM_PIXEL_LAYOUTS)
+                return NULL;
+
+        return &pixel_ops_table[layout][!!alpha];
+}
+
+int pixel_image_init(struct pixel_image *img, uint32_t width, uint32_t height, int layout, int alpha)
+{
+        const struct pixel_ops *ops = pixel_ops_get(layout, alpha);
+
+        if (!ops || !width || !height)
+                return -EINVAL;
+
+        img->width = width;
+        img->height = height;
+        img->layout = layout;
+        img->alpha = ops->alpha;
+        img->ops = ops;
+        img->stride = ALIGN_UP((size_t)width * ops->bpp, MEM_ALIGN);
+        img->data = mem_aligned_alloc(img->stride * height);
+        if (!img->data) {
+                pr_err("failed to allocate image %ux%u\n", width, height);
+                return -ENOMEM;
+        }
+
+        return 0;
+}
+
+static int pixel_image_export(struct pixel_image *img, MagickWand *w, int layout, int matte)
+{
+        uint32_t width = MagickGetImageWidth(w);
+        uint32_t height = MagickGetImageHeight(w);
+        int err;
+
+        if ((err = pixel_image_init(img, width, height, layout, matte)))
+                return err;
+
+        // rows are padded to alignment, export row by row unless they happen to be packed
+        if (img->stride == (size_t)width * img->ops->bpp) {
+                if (MagickPass != MagickGetImagePixels(w, 0, 0, width, height,
+                                                       img->ops->map, CharPixel, img->data))
+                        goto out_err;
+
+                return 0;
+        }
+
+        for (uint32_t y = 0; y < height; y++) {
+                if (MagickPass != MagickGetImagePixels(w, 0, y, width, 1, img->ops->map,
+                                                       CharPixel, img->data + (size_t)y * img->stride))
+                        goto out_err;
+        }
+
+        return 0;
+
+out_err:
+        pr_err("failed to export image pixels\n");
+        pixel_image_free(img);
+
+        return -EFAULT;
+}
+
+// export the current image of wand in the smallest layout which keeps it intact
+int pixel_image_from_wand(struct pixel_image *img, MagickWand *w)
+{
+        int matte = MagickGetImageMatte(w);
+        ImageType type = MagickGetImageType(w);
+        int layout;
+
+        if (matte)
+                layout = PIXEL_BGRA32;
+        else if (type == GrayscaleType || type == BilevelType)
+                layout = PIXEL_GREY8;
+        else
+                layout = PIXEL_RGB24;
+
+        return pixel_image_export(img, w, layout, matte);
+}
+
+//
+// for greyscale monitors, decoder computes luma while exporting, so one
+// byte per pixel is exported and resampled, alpha sources stay BGRA
+//
+int pixel_image_from_wand_luma(struct pixel_image *img, MagickWand *w)
+{
+        int matte = MagickGetImageMatte(w);
+
+        return pixel_image_export(img, w, matte ? PIXEL_BGRA32 : PIXEL_GREY8, matte);
+}
+
+void pixel_image_free(struct pixel_image *img)
+{
+        if (img->data)
+                mem_aligned_free(img->data);
+
+        memset(img, 0, sizeof(*img));
+}
+
+// copy image at (x, y) of canvas without scaling, clipped by @clip
+int pixel_blit(struct canvas *c, struct rectangle *clip, int32_t x, int32_t y,
+               struct pixel_image *img)
+{
+        struct rectangle rc = { .x = x, .y = y, .width = img->width, .height = img->height };
+        int64_t x0, y0, x1, y1;
+
+        x0 = max((int64_t)rc.x, (int64_t)clip->x);
+        y0 = max((int64_t)rc.y, (int64_t)clip->y);
+        x1 = min((int64_t)rc.x + rc.width, (int64_t)clip->x + clip->width);
+        y1 = min((int64_t)rc.y + rc.height, (int64_t)clip->y + clip->height);
+
+        if (x1 <= x0 || y1 <= y0)
+                return 0;
+
+        rc = (struct rectangle){ (int32_t)x0, (int32_t)y0, (uint32_t)(x1 - x0), (uint32_t)(y1 - y0) };
+
+        if (canvas_rect_clip(c, &rc))
+                return 0;
+
+        for (uint32_t i = 0; i < rc.height; i++) {
+                const uint8_t *src = pixel_image_row(img, rc.y - y + i) +
+                                     (size_t)(rc.x - x) * img->ops->bpp;
+
+                img->ops->blit(canvas_pixel(c, rc.x, rc.y + i), src, rc.width);
+        }
+
+        return 0;
+}
+
+//
+// nearest neighbour upscale by integer factor @k with top left at (@x, @y),
+// each source row is converted and widened once, then copied into every
+// canvas row it covers
+//
+int pixel_scale_nearest(struct canvas *c, struct rectangle *clip, int32_t x, int32_t y,
+                        uint32_t k, struct pixel_image *img)
+{
+        const struct pixel_ops *blend = pixel_ops_get(PIXEL_BGRA32, 1);
+        struct rectangle rc;
+        int64_t x0, y0, x1, y1;
+        uint32_t sx0, sx1, lead;
+        uint32_t *row = NULL, *wide = NULL;
+        int32_t last_sy = -1;
+        int err = 0;
+
+        if (!k)
+                return -EINVAL;
+
+        x0 = max((int64_t)x, (int64_t)clip->x);
+        y0 = max((int64_t)y, (int64_t)clip->y);
+        x1 = min((int64_t)x + (int64_t)img->width * k, (int64_t)clip->x + clip->width);
+        y1 = min((int64_t)y + (int64_t)img->height * k, (int64_t)clip->y + clip->height);
+
+        if (x1 <= x0 || y1 <= y0)
+                return 0;
+
+        rc = (struct rectangle){ (int32_t)x0, (int32_t)y0, (uint32_t)(x1 - x0), (uint32_t)(y1 - y0) };
+
+        if (canvas_rect_clip(c, &rc))
+                return 0;
+
+        // source columns touched by visible area
+        sx0 = (uint32_t)(rc.x - x) / k;
+        sx1 = (uint32_t)(rc.x - x + rc.width - 1) / k + 1;
+        lead = (uint32_t)(rc.x - x) - sx0 * k;
+
+        row = mem_aligned_alloc((size_t)(sx1 - sx0) * 4);
+        wide = mem_aligned_alloc((size_t)(sx1 - sx0) * k * 4);
+        if (!row || !wide) {
+                err = -ENOMEM;
+                goto out;
+        }
+
+        for (uint32_t i = 0; i < rc.height; i++) {
+                int32_t sy = (int32_t)((uint32_t)(rc.y - y + i) / k);
+                uint8_t *dst = canvas_pixel(c, rc.x, rc.y + i);
+
+                if (sy != last_sy) {
+                        img->ops->swizzle((uint8_t *)row, pixel_image_row(img, sy) +
+                                          (size_t)sx0 * img->ops->bpp, sx1 - sx0);
+                        replicate(wide, row, sx1 - sx0, k);
+                        last_sy = sy;
+                }
+
+                if (img->alpha)
+                        blend->blit(dst, (uint8_t *)&wide[lead], rc.width);
+                else
+                        memcpy(dst, &wide[lead], (size_t)rc.width * 4);
+        }
+
+out:
+        if (wide)
+                mem_aligned_free(wide);
+        if (row)
+                mem_aligned_free(row);
+
+        return err;
+}
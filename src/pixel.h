@@ -0,0 +1,124 @@
+#ifndef __TABLET_WALLPAPER_PIXEL_H__
+#define __TABLET_WALLPAPER_PIXEL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <wand/magick_wand.h>
+
+#include "canvas.h"
+
+enum pixel_layout {
+        PIXEL_RGB24 = 0,
+        PIXEL_RGBA32,
+        PIXEL_BGRA32,
+        PIXEL_GREY8,
+        NUM_PIXEL_LAYOUTS,
+};
+
+struct resample_axis;
+
+//
+// kernels specialized for one source layout and opaque/alpha case,
+// destination is always the BGRA32 canvas
+//
+struct pixel_ops {
+        const char     *name;
+        const char     *map;            // GraphicsMagick export map
+        uint32_t        bpp;
+        uint32_t        alpha;
+
+        // convert a row into canvas, alpha variants blend over
+        void (*blit)(uint8_t *dst, const uint8_t *src, uint32_t n);
+        // fill a row of this layout with a BGRA color
+        void (*fill)(uint8_t *dst, uint32_t n, uint32_t bgra);
+        // convert a row into BGRA32, no blending
+        void (*swizzle)(uint8_t *dst, const uint8_t *src, uint32_t n);
+        // horizontal resample pass into 15bit BGRA intermediate (premultiplied if alpha)
+        void (*resample_h)(uint16_t *dst, const uint8_t *src,
+                           const struct resample_axis *ax, uint32_t cnt);
+        // same in linear light through resample_srgb_linear[], NULL for alpha variants
+        void (*resample_h_linear)(uint16_t *dst, const uint8_t *src,
+                                  const struct resample_axis *ax, uint32_t cnt);
+        // store a resampled BGRA row into canvas, alpha variants blend premultiplied over
+        void (*store)(uint8_t *dst, const uint8_t *src, uint32_t n);
+};
+
+struct pixel_image {
+        uint8_t        *data;
+        uint32_t        width;
+        uint32_t        height;
+        size_t          stride;
+        int             layout;
+        uint32_t        alpha;
+        const struct pixel_ops *ops;
+};
+
+static inline const uint8_t *pixel_image_row(const struct pixel_image *img, uint32_t y)
+{
+        return img->data + (size_t)y * img->stride;
+}
+
+void pixel_simd_init(int simd);
+const struct pixel_ops *pixel_ops_get(int layout, int alpha);
+
+int pixel_image_init(struct pixel_image *img, uint32_t width, uint32_t height, int layout, int alpha);
+int pixel_image_from_wand(struct pixel_image *img, MagickWand *w);
+int pixel_image_from_wand_luma(struct pixel_image *img, MagickWand *w);
+void pixel_image_free(struct pixel_image *img);
+
+void pixel_blend_premul_row(uint8_t *dst, const uint8_t *src, uint32_t n);
+void pixel_lerp_row(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n, uint32_t weight);
+void pixel_luma_row(uint8_t *dst, const uint8_t *src, uint32_t n);
+
+// ordered dither of 8bit grey to fewer levels, 4x4 bayer thresholds
+struct pixel_dither {
+        uint32_t        levels;         // 0: off
+        uint8_t         lut[16][256];
+};
+
+void pixel_dither_init(struct pixel_dither *d, uint32_t levels);
+void pixel_dither_row(const struct pixel_dither *d, uint8_t *row, uint32_t n, uint32_t x0, uint32_t y);
+
+int pixel_blit(struct canvas *c, struct rectangle *clip, int32_t x, int32_t y,
+               struct pixel_image *img);
+int pixel_scale_nearest(struct canvas *c, struct rectangle *clip, int32_t x, int32_t y,
+                        uint32_t k, struct pixel_image *img);
+
+// resample.c
+struct resample_axis {
+        int32_t        *start;          // first source index of each output
+        uint32_t       *count;          // taps used by each output
+        int16_t        *weights;        // [output][taps], sum to 1 << RESAMPLE_WEIGHT_BITS
+        uint32_t        taps;
+};
+
+#define RESAMPLE_WEIGHT_BITS            14
+#define RESAMPLE_INTER_BITS             7       // 8bit value << 7, fits in int16
+
+// filter used when scale factor is above 1 on both axes
+enum resample_upscale {
+        RESAMPLE_UPSCALE_EDGE = 0,      // cubic, edge directed on diagonal edges
+        RESAMPLE_UPSCALE_CUBIC,         // Keys cubic, clamped to nearest samples
+        RESAMPLE_UPSCALE_LINEAR,        // triangle filter, same as downscaling
+        NUM_RESAMPLE_UPSCALES,
+};
+
+// unsharp mask after edge and cubic upscale, 0: off
+#define RESAMPLE_UPSCALE_SHARPEN_DEFAULT        1.0
+
+extern char *resample_upscale_strs[];
+
+// 8bit sRGB to linear light in RESAMPLE_INTER_BITS fixed point
+extern uint16_t resample_srgb_linear[256];
+
+void resample_simd_init(int simd);
+void resample_upscale_set(int mode);
+void resample_upscale_sharpen_set(double strength);
+void resample_linear_set(uint32_t enable);
+int resample_upscale_used(uint32_t src_width, uint32_t src_height,
+                          uint32_t dst_width, uint32_t dst_height, uint32_t alpha);
+int pixel_resample(struct canvas *c, struct rectangle *clip, struct rectangle *dst,
+                   struct pixel_image *img);
+
+#endif // __TABLET_WALLPAPER_PIXEL_H__
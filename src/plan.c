@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "prof.h"
+#include "worker.h"
+#include "plan.h"
+
+char *plan_op_strs[] = {
+        [PLAN_OP_READ]                  = "read",
+        [PLAN_OP_FILL]                  = "fill",
+        [PLAN_OP_PROCEDURAL]            = "procedural",
+        [PLAN_OP_DECODE]                = "decode",
+        [PLAN_OP_EXPORT]                = "export",
+        [PLAN_OP_RESAMPLE]              = "resample",
+        [PLAN_OP_UPSCALE]               = "upscale",
+        [PLAN_OP_COPY]                  = "copy",
+        [PLAN_OP_LERP]                  = "lerp",
+        [PLAN_OP_OVERLAY]               = "overlay",
+        [PLAN_OP_ENCODE]                = "encode",
+};
+
+//
+// single core figures of a mid-range x86 laptop, replace them with ns/px
+// of matching stages in profile report (settings.profile) to calibrate
+//
+static const double plan_cost_ns_default[NUM_PLAN_OPS] = {
+        [PLAN_OP_READ]                  = 0.5,  // ~2 GB/s, warm cache or nvme
+        [PLAN_OP_FILL]                  = 0.2,
+        [PLAN_OP_PROCEDURAL]            = 1.5,
+        [PLAN_OP_DECODE]                = 9.0,  // jpeg, png is about twice
+        [PLAN_OP_EXPORT]                = 1.5,
+        [PLAN_OP_RESAMPLE]              = 3.3,  // linear, 1080p -> 4k measured 3.26
+        [PLAN_OP_UPSCALE]               = 9.5,  // edge + sharpen, ~2.7x clamped cubic (3.47)
+        [PLAN_OP_COPY]                  = 0.4,
+        [PLAN_OP_LERP]                  = 0.4,
+        [PLAN_OP_OVERLAY]               = 0.6,
+        [PLAN_OP_ENCODE]                = 2.5,  // bmp, png is ~10x
+};
+
+double plan_cost_ns[NUM_PLAN_OPS];
+
+uint64_t plan_cost_usec(int op, uint64_t units)
+{
+        double ns;
+
+        if (op < 0 || op >= NUM_PLAN_OPS)
+                return 0;
+
+        ns = plan_cost_ns[op] > 0.0 ? plan_cost_ns[op] : plan_cost_ns_default[op];
+
+        return (uint64_t)(units * ns / 1000.0);
+}
+
+void plan_add(struct plan *p, int scope, int op, uint64_t units, uint64_t mem,
+              uint32_t parallel, const char *fmt, ...)
+{
+        struct plan_item *it;
+        va_list ap;
+
+        if (p->n >= ARRAY_SIZE(p->items))
+                return;
+
+        it = &p->items[p->n++];
+        it->scope = scope;
+        it->op = op;
+        it->units = units;
+        it->mem = mem;
+        it->parallel = parallel;
+
+        va_start(ap, fmt);
+        vsnprintf(it->desc, sizeof(it->desc), fmt, ap);
+        va_end(ap);
+}
+
+static void plan_scope_name(int scope, char *buf, size_t len)
+{
+        if (scope == PROF_SCOPE_DESKTOP)
+                snprintf(buf, len, "desktop");
+        else
+                snprintf(buf, len, "mon%d", scope - 1);
+}
+
+//
+// serial items add up, parallel items are spread over workers but can
+// not finish before the longest one
+//
+void plan_print(struct plan *p)
+{
+        uint64_t serial = 0, par_sum = 0, par_max = 0, mem_peak = 0;
+        unsigned workers = worker_count_get();
+
+        pr_rawlvl(INFO, "%-8s %-10s %-60s %12s %10s %10s\n",
+                  "scope", "op", "detail", "units", "est(us)", "mem(KiB)");
+
+        for (size_t i = 0; i < p->n; i++) {
+                struct plan_item *it = &p->items[i];
+                uint64_t usec = plan_cost_usec(it->op, it->units);
+                char name[16];
+
+                plan_scope_name(it->scope, name, sizeof(name));
+
+                pr_rawlvl(INFO, "%-8s %-10s %-60s %12llu %10llu %10llu%s\n",
+                          name, plan_op_strs[it->op], it->desc,
+                          (unsigned long long)it->units,
+                          (unsigned long long)usec,
+                          (unsigned long long)(it->mem >> 10),
+                          it->parallel ? " *" : "");
+
+                if (it->parallel) {
+                        par_sum += usec;
+                        par_max = max(par_max, usec);
+                } else {
+                        serial += usec;
+                }
+
+                mem_peak = max(mem_peak, it->mem);
+        }
+
+        if (workers)
+                par_sum = max(par_sum / workers, par_max);
+
+        pr_rawlvl(INFO, "estimated: %llu us (%llu serial, %llu parallel on %u workers), "
+                  "peak memory %llu KiB (%llu resident)\n",
+                  (unsigned long long)(serial + par_sum),
+                  (unsigned long long)serial,
+                  (unsigned long long)par_sum, workers,
+                  (unsigned long long)((p->mem_resident + mem_peak) >> 10),
+                  (unsigned long long)(p->mem_resident >> 10));
+}
@@ -0,0 +1,49 @@
+#ifndef __TABLET_WALLPAPER_PLAN_H__
+#define __TABLET_WALLPAPER_PLAN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum plan_op_id {
+        PLAN_OP_READ = 0,               // unit is byte, others are pixel
+        PLAN_OP_FILL,
+        PLAN_OP_PROCEDURAL,
+        PLAN_OP_DECODE,
+        PLAN_OP_EXPORT,
+        PLAN_OP_RESAMPLE,               // output pixels
+        PLAN_OP_UPSCALE,
+        PLAN_OP_COPY,                   // blit, tile, integer scale
+        PLAN_OP_LERP,
+        PLAN_OP_OVERLAY,
+        PLAN_OP_ENCODE,
+        NUM_PLAN_OPS,
+};
+
+extern char *plan_op_strs[];
+
+// nanoseconds per unit on one core, 0: use built-in default
+extern double plan_cost_ns[NUM_PLAN_OPS];
+
+struct plan_item {
+        int             scope;          // same as prof scope
+        int             op;
+        uint64_t        units;
+        uint64_t        mem;            // bytes held while this item runs
+        uint32_t        parallel;       // runs on worker pool with other parallel items
+        char            desc[96];
+};
+
+#define PLAN_ITEM_MAX                   128
+
+struct plan {
+        struct plan_item items[PLAN_ITEM_MAX];
+        size_t          n;
+        uint64_t        mem_resident;   // held through whole render
+};
+
+uint64_t plan_cost_usec(int op, uint64_t units);
+void plan_add(struct plan *p, int scope, int op, uint64_t units, uint64_t mem,
+              uint32_t parallel, const char *fmt, ...);
+void plan_print(struct plan *p);
+
+#endif // __TABLET_WALLPAPER_PLAN_H__
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "cpu.h"
+
+#ifdef HAVE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef HAVE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "canvas.h"
+#include "procedural.h"
+
+#define PROCEDURAL_DEFAULT_SIZE         64
+
+char *procedural_pattern_strs[] = {
+        [PROCEDURAL_NONE]               = "none",
+        [PROCEDURAL_LINEAR_GRADIENT]    = "linear_gradient",
+        [PROCEDURAL_RADIAL_GRADIENT]    = "radial_gradient",
+        [PROCEDURAL_CHECKER]            = "checker",
+        [PROCEDURAL_STRIPES]            = "stripes",
+};
+
+// ordered dither thresholds, gradients of 8bpc band heavily on large panels
+static const uint8_t bayer4x4[4][4] = {
+        {  0,  8,  2, 10 },
+        { 12,  4, 14,  6 },
+        {  3, 11,  1,  9 },
+        { 15,  7, 13,  5 },
+};
+
+struct shader {
+        float c0[3];    // b, g, r
+        float dc[3];
+};
+
+static void shader_init(struct shader *s, uint32_t from, uint32_t to)
+{
+        for (int ch = 0; ch < 3; ch++) {
+                float a = (float)((from >> (ch * 8)) & 0xff);
+                float b = (float)((to >> (ch * 8)) & 0xff);
+
+                s->c0[ch] = a;
+                s->dc[ch] = b - a;
+        }
+}
+
+static void dither_row_get(float d[4], uint32_t y, int enabled)
+{
+        for (int i = 0; i < 4; i++)
+                d[i] = enabled ? (bayer4x4[y & 3][i] + 0.5f) / 16.0f : 0.5f;
+}
+
+static inline uint32_t shade1(const struct shader *s, float t, float d)
+{
+        uint32_t px = 0xff000000U;
+
+        if (t < 0.0f)
+                t = 0.0f;
+        if (t > 1.0f)
+                t = 1.0f;
+
+        for (int ch = 0; ch < 3; ch++) {
+                float v = s->c0[ch] + s->dc[ch] * t + d;
+
+                if (v > 255.0f)
+                        v = 255.0f;
+                if (v < 0.0f)
+                        v = 0.0f;
+
+                px |= (uint32_t)v << (ch * 8);
+        }
+
+        return px;
+}
+
+// t(x) = t0 + x * dt
+static void linear_row_scalar(uint32_t *dst, uint32_t n, float t0, float dt,
+                              const struct shader *s, const float d[4])
+{
+        for (uint32_t x = 0; x < n; x++)
+                dst[x] = shade1(s, t0 + (float)x * dt, d[x & 3]);
+}
+
+// t(x) = sqrt((x0 + x)^2 + dy^2) / radius
+static void radial_row_scalar(uint32_t *dst, uint32_t n, float x0, float dy, float inv_r,
+                              const struct shader *s, const float d[4])
+{
+        float dy2 = dy * dy;
+
+        for (uint32_t x = 0; x < n; x++) {
+                float dx = x0 + (float)x;
+
+                dst[x] = shade1(s, sqrtf(dx * dx + dy2) * inv_r, d[x & 3]);
+        }
+}
+
+#ifdef HAVE_SIMD_SSE2
+static inline __m128i shade4_sse2(const struct shader *s, __m128 t, __m128 d)
+{
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 max = _mm_set1_ps(255.0f);
+        __m128i b, g, r;
+        __m128 v;
+
+        t = _mm_min_ps(_mm_max_ps(t, zero), _mm_set1_ps(1.0f));
+
+        v = _mm_add_ps(_mm_add_ps(_mm_set1_ps(s->c0[0]), _mm_mul_ps(_mm_set1_ps(s->dc[0]), t)), d);
+        b = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, zero), max));
+
+        v = _mm_add_ps(_mm_add_ps(_mm_set1_ps(s->c0[1]), _mm_mul_ps(_mm_set1_ps(s->dc[1]), t)), d);
+        g = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, zero), max));
+
+        v = _mm_add_ps(_mm_add_ps(_mm_set1_ps(s->c0[2]), _mm_mul_ps(_mm_set1_ps(s->dc[2]), t)), d);
+        r = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, zero), max));
+
+        return _mm_or_si128(_mm_or_si128(_mm_set1_epi32((int)0xff000000U), b),
+                            _mm_or_si128(_mm_slli_epi32(g, 8), _mm_slli_epi32(r, 16)));
+}
+
+static void linear_row_sse2(uint32_t *dst, uint32_t n, float t0, float dt,
+                            const struct shader *s, const float d[4])
+{
+        __m128 dv = _mm_loadu_ps(d);
+        __m128 fx = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        __m128 vt0 = _mm_set1_ps(t0), vdt = _mm_set1_ps(dt);
+        uint32_t x = 0;
+
+        for (; x + 4 <= n; x += 4) {
+                __m128 t = _mm_add_ps(vt0, _mm_mul_ps(fx, vdt));
+
+                _mm_storeu_si128((__m128i *)&dst[x], shade4_sse2(s, t, dv));
+                fx = _mm_add_ps(fx, _mm_set1_ps(4.0f));
+        }
+
+        for (; x < n; x++)
+                dst[x] = shade1(s, t0 + (float)x * dt, d[x & 3]);
+}
+
+static void radial_row_sse2(uint32_t *dst, uint32_t n, float x0, float dy, float inv_r,
+                            const struct shader *s, const float d[4])
+{
+        __m128 dv = _mm_loadu_ps(d);
+        __m128 fx = _mm_add_ps(_mm_set1_ps(x0), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+        __m128 vdy2 = _mm_set1_ps(dy * dy), vinv = _mm_set1_ps(inv_r);
+        uint32_t x = 0;
+
+        for (; x + 4 <= n; x += 4) {
+                __m128 t = _mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(fx, fx), vdy2)), vinv);
+
+                _mm_storeu_si128((__m128i *)&dst[x], shade4_sse2(s, t, dv));
+                fx = _mm_add_ps(fx, _mm_set1_ps(4.0f));
+        }
+
+        for (; x < n; x++) {
+                float dx = x0 + (float)x;
+
+                dst[x] = shade1(s, sqrtf(dx * dx + dy * dy) * inv_r, d[x & 3]);
+        }
+}
+#endif
+
+#ifdef HAVE_SIMD_NEON
+static inline uint32x4_t shade4_neon(const struct shader *s, float32x4_t t, float32x4_t d)
+{
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t max = vdupq_n_f32(255.0f);
+        uint32x4_t b, g, r;
+        float32x4_t v;
+
+        t = vminq_f32(vmaxq_f32(t, zero), vdupq_n_f32(1.0f));
+
+        v = vaddq_f32(vmlaq_n_f32(vdupq_n_f32(s->c0[0]), t, s->dc[0]), d);
+        b = vcvtq_u32_f32(vminq_f32(vmaxq_f32(v, zero), max));
+
+        v = vaddq_f32(vmlaq_n_f32(vdupq_n_f32(s->c0[1]), t, s->dc[1]), d);
+        g = vcvtq_u32_f32(vminq_f32(vmaxq_f32(v, zero), max));
+
+        v = vaddq_f32(vmlaq_n_f32(vdupq_n_f32(s->c0[2]), t, s->dc[2]), d);
+        r = vcvtq_u32_f32(vminq_f32(vmaxq_f32(v, zero), max));
+
+        return vorrq_u32(vorrq_u32(vdupq_n_u32(0xff000000U), b),
+                         vorrq_u32(vshlq_n_u32(g, 8), vshlq_n_u32(r, 16)));
+}
+
+static void linear_row_neon(uint32_t *dst, uint32_t n, float t0, float dt,
+                            const struct shader *s, const float d[4])
+{
+        static const float lane[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+        float32x4_t dv = vld1q_f32(d);
+        float32x4_t fx = vld1q_f32(lane);
+        float32x4_t vt0 = vdupq_n_f32(t0);
+        uint32_t x = 0;
+
+        for (; x + 4 <= n; x += 4) {
+                float32x4_t t = vmlaq_n_f32(vt0, fx, dt);
+
+                vst1q_u32(&dst[x], shade4_neon(s, t, dv));
+                fx = vaddq_f32(fx, vdupq_n_f32(4.0f));
+        }
+
+        for (; x < n; x++)
+                dst[x] = shade1(s, t0 + (float)x * dt, d[x & 3]);
+}
+
+static void radial_row_neon(uint32_t *dst, uint32_t n, float x0, float dy, float inv_r,
+                            const struct shader *s, const float d[4])
+{
+        static const float lane[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+        float32x4_t dv = vld1q_f32(d);
+        float32x4_t fx = vaddq_f32(vdupq_n_f32(x0), vld1q_f32(lane));
+        float32x4_t vdy2 = vdupq_n_f32(dy * dy);
+        uint32_t x = 0;
+
+        for (; x + 4 <= n; x += 4) {
+                float32x4_t t = vmulq_n_f32(vsqrtq_f32(vmlaq_f32(vdy2, fx, fx)), inv_r);
+
+                vst1q_u32(&dst[x], shade4_neon(s, t, dv));
+                fx = vaddq_f32(fx, vdupq_n_f32(4.0f));
+        }
+
+        for (; x < n; x++) {
+                float dx = x0 + (float)x;
+
+                dst[x] = shade1(s, sqrtf(dx * dx + dy * dy) * inv_r, d[x & 3]);
+        }
+}
+#endif
+
+static void (*linear_row)(uint32_t *dst, uint32_t n, float t0, float dt,
+                          const struct shader *s, const float d[4]) = linear_row_scalar;
+static void (*radial_row)(uint32_t *dst, uint32_t n, float x0, float dy, float inv_r,
+                          const struct shader *s, const float d[4]) = radial_row_scalar;
+
+void procedural_simd_init(int simd)
+{
+        switch (simd) {
+#ifdef HAVE_SIMD_SSE2
+        case CPU_SIMD_SSE2:
+                linear_row = linear_row_sse2;
+                radial_row = radial_row_sse2;
+                break;
+#endif
+
+#ifdef HAVE_SIMD_NEON
+        case CPU_SIMD_NEON:
+                linear_row = linear_row_neon;
+                radial_row = radial_row_neon;
+                break;
+#endif
+
+        default:
+                linear_row = linear_row_scalar;
+                radial_row = radial_row_scalar;
+                break;
+        }
+}
+
+static void checker_row(uint32_t *dst, uint32_t n, uint32_t x0, uint32_t y,
+                        uint32_t size, const uint32_t colors[2])
+{
+        uint32_t parity = (y / size) & 1;
+        uint32_t x = 0;
+
+        while (x < n) {
+                uint32_t cell = (x0 + x) / size;
+                uint32_t run = (cell + 1) * size - (x0 + x);
+                uint32_t c = colors[(cell & 1) ^ parity];
+
+                if (run > n - x)
+                        run = n - x;
+
+                for (uint32_t i = 0; i < run; i++)
+                        dst[x + i] = c;
+
+                x += run;
+        }
+}
+
+// u(x) = (u0 + x * du), stripe index is floor(u)
+static void stripes_row(uint32_t *dst, uint32_t n, float u0, float du,
+                        const uint32_t colors[2])
+{
+        for (uint32_t x = 0; x < n; x++)
+                dst[x] = colors[(int32_t)floorf(u0 + (float)x * du) & 1];
+}
+
+int procedural_render(struct canvas *c, struct rectangle *r, struct procedural *p)
+{
+        struct rectangle rc = *r;
+        struct shader s;
+        uint32_t colors[2] = { 0xff000000U, 0xff000000U };
+        uint32_t size = p->size ? p->size : PROCEDURAL_DEFAULT_SIZE;
+        float rad = (float)(p->angle * M_PI / 180.0);
+        float ca = cosf(rad), sa = sinf(rad);
+        float cx = (float)r->width / 2.0f, cy = (float)r->height / 2.0f;
+        uint32_t ox, oy;
+
+        if (p->pattern <= PROCEDURAL_NONE || p->pattern >= NUM_PROCEDURAL_PATTERNS)
+                return -ENODATA;
+
+        color_parse(p->colors[0], &colors[0]);
+        if (color_parse(p->colors[1], &colors[1]))
+                colors[1] = colors[0];
+
+        shader_init(&s, colors[0], colors[1]);
+
+        if (canvas_rect_clip(c, &rc))
+                return 0;
+
+        // pattern is anchored at unclipped rectangle
+        ox = rc.x - r->x;
+        oy = rc.y - r->y;
+
+        for (uint32_t i = 0; i < rc.height; i++) {
+                uint32_t *row = (uint32_t *)canvas_pixel(c, rc.x, rc.y + i);
+                uint32_t y = oy + i;
+                float fy = (float)y + 0.5f - cy;
+                float fx = (float)ox + 0.5f - cx;
+                float d[4];
+
+                dither_row_get(d, y, p->dither);
+
+                switch (p->pattern) {
+                case PROCEDURAL_LINEAR_GRADIENT: {
+                        // projection onto gradient axis, normalized by the extent of the rectangle on it
+                        float extent = fabsf(r->width * ca) + fabsf(r->height * sa);
+                        float inv = extent > 0.0f ? 1.0f / extent : 0.0f;
+                        float t0 = (fx * ca + fy * sa) * inv + 0.5f;
+
+                        linear_row(row, rc.width, t0, ca * inv, &s, d);
+                        break;
+                }
+
+                case PROCEDURAL_RADIAL_GRADIENT: {
+                        float radius = p->size ? (float)p->size : sqrtf(cx * cx + cy * cy);
+
+                        radial_row(row, rc.width, fx, fy, 1.0f / radius, &s, d);
+                        break;
+                }
+
+                case PROCEDURAL_CHECKER:
+                        checker_row(row, rc.width, ox, y, size, colors);
+                        break;
+
+                case PROCEDURAL_STRIPES: {
+                        float inv = 1.0f / (float)size;
+
+                        // offset by a large even number to keep floor() away from sign flip
+                        stripes_row(row, rc.width, (fx * ca + fy * sa) * inv + 65536.0f, ca * inv, colors);
+                        break;
+                }
+                }
+        }
+
+        return 0;
+}
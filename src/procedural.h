@@ -0,0 +1,30 @@
+#ifndef __TABLET_WALLPAPER_PROCEDURAL_H__
+#define __TABLET_WALLPAPER_PROCEDURAL_H__
+
+#include <stdint.h>
+
+#include "canvas.h"
+
+enum procedural_pattern {
+        PROCEDURAL_NONE = 0,
+        PROCEDURAL_LINEAR_GRADIENT,
+        PROCEDURAL_RADIAL_GRADIENT,
+        PROCEDURAL_CHECKER,
+        PROCEDURAL_STRIPES,
+        NUM_PROCEDURAL_PATTERNS,
+};
+
+extern char *procedural_pattern_strs[];
+
+struct procedural {
+        int             pattern;
+        char           *colors[2];
+        double          angle;          // degree, clockwise from +x axis
+        uint32_t        size;           // checker/stripe size, radius of radial gradient
+        uint32_t        dither;
+};
+
+void procedural_simd_init(int simd);
+int procedural_render(struct canvas *c, struct rectangle *r, struct procedural *p);
+
+#endif // __TABLET_WALLPAPER_PROCEDURAL_H__
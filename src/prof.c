@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "prof.h"
+
+struct prof_stage {
+        uint32_t        calls;
+        uint64_t        usec;
+        uint64_t        cycles;
+        uint64_t        faults;
+        uint64_t        pixels;
+};
+
+static const char *prof_stage_strs[] = {
+        [PROF_STAGE_PREFETCH]   = "prefetch",
+        [PROF_STAGE_BACKGROUND] = "background",
+        [PROF_STAGE_DECODE]     = "decode",
+        [PROF_STAGE_EXPORT]     = "export",
+        [PROF_STAGE_STYLE]      = "style",
+        [PROF_STAGE_OVERLAY]    = "overlay",
+        [PROF_STAGE_ENCODE]     = "encode",
+};
+
+uint32_t prof_enabled;
+
+static struct prof_stage prof_stages[PROF_SCOPE_MAX][NUM_PROF_STAGES];
+
+static void prof_sample_get(struct prof_sample *s)
+{
+        PROCESS_MEMORY_COUNTERS pmc = { .cb = sizeof(pmc) };
+        ULONG64 cycles = 0;
+
+        s->usec = prof_usec_now();
+
+        // stages begin and end on same thread, parallel jobs must not count each other
+        if (QueryThreadCycleTime(GetCurrentThread(), &cycles))
+                s->cycles = cycles;
+
+        // soft faults mostly, first touch of fresh pages and TLB pressure show here
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+                s->faults = pmc.PageFaultCount;
+}
+
+void prof_begin(struct prof_sample *s)
+{
+        if (!prof_enabled)
+                return;
+
+        prof_sample_get(s);
+}
+
+void prof_end(int scope, int stage, struct prof_sample *s, uint64_t pixels)
+{
+        struct prof_sample now;
+        struct prof_stage *p;
+
+        if (!prof_enabled)
+                return;
+
+        if (scope < 0 || scope >= PROF_SCOPE_MAX || stage < 0 || stage >= NUM_PROF_STAGES)
+                return;
+
+        prof_sample_get(&now);
+
+        p = &prof_stages[scope][stage];
+        p->calls++;
+        p->usec += now.usec - s->usec;
+        p->cycles += now.cycles - s->cycles;
+        p->faults += now.faults - s->faults;
+        p->pixels += pixels;
+}
+
+void prof_reset(void)
+{
+        memset(prof_stages, 0, sizeof(prof_stages));
+}
+
+//
+// cycles against wall time tells whether a stage is busy on cpu or is
+// stalled (io, page faults), cycles per pixel compares kernels across sizes
+//
+void prof_report(void)
+{
+        if (!prof_enabled)
+                return;
+
+        pr_rawlvl(INFO, "cycles: stage thread only, helper threads of a stage are not counted; "
+                        "faults: process wide\n");
+
+        pr_rawlvl(INFO, "%-8s %-10s %5s %10s %10s %8s %8s %8s\n",
+                  "scope", "stage", "calls", "wall(us)", "Mcycles", "cyc/px", "ns/px", "faults");
+
+        for (int scope = 0; scope < PROF_SCOPE_MAX; scope++) {
+                for (int stage = 0; stage < NUM_PROF_STAGES; stage++) {
+                        struct prof_stage *p = &prof_stages[scope][stage];
+                        char name[16];
+
+                        if (!p->calls)
+                                continue;
+
+                        if (scope == PROF_SCOPE_DESKTOP)
+                                snprintf(name, sizeof(name), "desktop");
+                        else
+                                snprintf(name, sizeof(name), "mon%d", scope - 1);
+
+                        pr_rawlvl(INFO, "%-8s %-10s %5u %10llu %10.1f %8.2f %8.2f %8llu\n",
+                                  name, prof_stage_strs[stage], p->calls,
+                                  (unsigned long long)p->usec,
+                                  p->cycles / 1e6,
+                                  p->pixels ? (double)p->cycles / p->pixels : 0.0,
+                                  p->pixels ? p->usec * 1000.0 / p->pixels : 0.0,
+                                  (unsigned long long)p->faults);
+                }
+        }
+}
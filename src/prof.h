@@ -0,0 +1,49 @@
+#ifndef __TABLET_WALLPAPER_PROF_H__
+#define __TABLET_WALLPAPER_PROF_H__
+
+#include <stdint.h>
+
+#include <windows.h>
+
+enum prof_stage_id {
+        PROF_STAGE_PREFETCH = 0,
+        PROF_STAGE_BACKGROUND,
+        PROF_STAGE_DECODE,
+        PROF_STAGE_EXPORT,
+        PROF_STAGE_STYLE,
+        PROF_STAGE_OVERLAY,
+        PROF_STAGE_ENCODE,
+        NUM_PROF_STAGES,
+};
+
+#define PROF_SCOPE_DESKTOP              0       // monitor i is scope i + 1
+#define PROF_SCOPE_MAX                  9
+
+struct prof_sample {
+        uint64_t        usec;
+        uint64_t        cycles;         // of calling thread only
+        uint64_t        faults;
+};
+
+static inline uint64_t prof_usec_now(void)
+{
+        static LARGE_INTEGER freq = { 0 };
+        LARGE_INTEGER now;
+
+        if (freq.QuadPart == 0)
+                QueryPerformanceFrequency(&freq);
+
+        QueryPerformanceCounter(&now);
+
+        return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000ULL +
+               (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000ULL / freq.QuadPart;
+}
+
+extern uint32_t prof_enabled;
+
+void prof_begin(struct prof_sample *s);
+void prof_end(int scope, int stage, struct prof_sample *s, uint64_t pixels);
+void prof_reset(void);
+void prof_report(void);
+
+#endif // __TABLET_WALLPAPER_PROF_H__
@@ -0,0 +1,1436 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "cpu.h"
+
+#ifdef HAVE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef HAVE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "mem.h"
+#include "canvas.h"
+#include "pixel.h"
+
+static void resample_axis_deinit(struct resample_axis *ax)
+{
+        if (ax->start)
+                free(ax->start);
+        if (ax->count)
+                free(ax->count);
+        if (ax->weights)
+                free(ax->weights);
+
+        memset(ax, 0, sizeof(*ax));
+}
+
+//
+// triangle filter, support widens with downscale ratio so every source
+// pixel contributes (area-like), and degrades to bilinear when upscaling,
+// outputs [off, off + cnt) of a @dst_len long axis are computed
+//
+static int resample_axis_init(struct resample_axis *ax, uint32_t src_len, uint32_t dst_len,
+                              uint32_t off, uint32_t cnt)
+{
+        double scale = (double)src_len / dst_len;
+        double support = scale > 1.0 ? scale : 1.0;
+        double *fw;
+
+        memset(ax, 0, sizeof(*ax));
+
+        ax->taps = (uint32_t)ceil(support * 2.0) + 1;
+        ax->start = calloc(cnt, sizeof(*ax->start));
+        ax->count = calloc(cnt, sizeof(*ax->count));
+        ax->weights = calloc((size_t)cnt * ax->taps, sizeof(*ax->weights));
+        fw = calloc(ax->taps, sizeof(*fw));
+
+        if (!ax->start || !ax->count || !ax->weights || !fw) {
+                resample_axis_deinit(ax);
+                if (fw)
+                        free(fw);
+                return -ENOMEM;
+        }
+
+        for (uint32_t i = 0; i < cnt; i++) {
+                double center = (off + i + 0.5) * scale - 0.5;
+                int64_t lo = (int64_t)floor(center - support) + 1;
+                int64_t hi = (int64_t)ceil(center + support) - 1;
+                int16_t *w = &ax->weights[(size_t)i * ax->taps];
+                double sum = 0.0;
+                int32_t isum = 0;
+                uint32_t n, peak = 0;
+
+                if (lo < 0)
+                        lo = 0;
+                if (hi > (int64_t)src_len - 1)
+                        hi = (int64_t)src_len - 1;
+                if (hi < lo)
+                        hi = lo;
+
+                n = (uint32_t)(hi - lo + 1);
+                if (n > ax->taps)
+                        n = ax->taps;
+
+                for (uint32_t j = 0; j < n; j++) {
+                        double d = fabs((double)(lo + j) - center) / support;
+
+                        fw[j] = d < 1.0 ? 1.0 - d : 0.0;
+                        sum += fw[j];
+                }
+
+                // edge taps may all fall outside of filter
+                if (sum <= 0.0) {
+                        fw[0] = sum = 1.0;
+                        n = 1;
+                }
+
+                for (uint32_t j = 0; j < n; j++) {
+                        w[j] = (int16_t)lround(fw[j] / sum * (1 << RESAMPLE_WEIGHT_BITS));
+                        isum += w[j];
+
+                        if (w[j] > w[peak])
+                                peak = j;
+                }
+
+                // keep unity gain exact
+                w[peak] += (int16_t)((1 << RESAMPLE_WEIGHT_BITS) - isum);
+
+                ax->start[i] = (int32_t)lo;
+                ax->count[i] = n;
+        }
+
+        free(fw);
+
+        return 0;
+}
+
+#define RESAMPLE_V_SHIFT                (RESAMPLE_WEIGHT_BITS + RESAMPLE_INTER_BITS)
+
+// vertical pass, 15bit intermediate rows to 8bit BGRA
+static void resample_v_scalar(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                              uint32_t i, uint32_t n)
+{
+        for (; i < n; i++) {
+                int32_t acc = 1 << (RESAMPLE_V_SHIFT - 1);
+
+                for (uint32_t j = 0; j < taps; j++)
+                        acc += w[j] * rows[j][i];
+
+                acc >>= RESAMPLE_V_SHIFT;
+                dst[i] = (uint8_t)(acc < 0 ? 0 : (acc > 0xff ? 0xff : acc));
+        }
+}
+
+#ifdef HAVE_SIMD_SSE2
+static void resample_v_sse2(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                            uint32_t i, uint32_t n)
+{
+        const __m128i vround = _mm_set1_epi32(1 << (RESAMPLE_V_SHIFT - 1));
+
+        // interleave two rows so one madd handles a pair of taps
+        for (; i + 8 <= n; i += 8) {
+                __m128i acc_lo = vround, acc_hi = vround;
+
+                for (uint32_t j = 0; j < taps; j += 2) {
+                        __m128i a = _mm_loadu_si128((const __m128i *)&rows[j][i]);
+                        __m128i b = _mm_setzero_si128();
+                        int32_t w1 = 0;
+                        __m128i ww;
+
+                        if (j + 1 < taps) {
+                                b = _mm_loadu_si128((const __m128i *)&rows[j + 1][i]);
+                                w1 = w[j + 1];
+                        }
+
+                        ww = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)w1 << 16) | (uint16_t)w[j]));
+                        acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), ww));
+                        acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), ww));
+                }
+
+                acc_lo = _mm_srai_epi32(acc_lo, RESAMPLE_V_SHIFT);
+                acc_hi = _mm_srai_epi32(acc_hi, RESAMPLE_V_SHIFT);
+
+                _mm_storel_epi64((__m128i *)&dst[i],
+                                 _mm_packus_epi16(_mm_packs_epi32(acc_lo, acc_hi), _mm_setzero_si128()));
+        }
+
+        resample_v_scalar(dst, rows, w, taps, i, n);
+}
+#endif
+
+#ifdef HAVE_SIMD_NEON
+static void resample_v_neon(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                            uint32_t i, uint32_t n)
+{
+        const int32x4_t vround = vdupq_n_s32(1 << (RESAMPLE_V_SHIFT - 1));
+
+        // intermediate fits in int16, widening multiply-accumulate per tap
+        for (; i + 8 <= n; i += 8) {
+                int32x4_t acc_lo = vround, acc_hi = vround;
+
+                for (uint32_t j = 0; j < taps; j++) {
+                        int16x8_t a = vreinterpretq_s16_u16(vld1q_u16(&rows[j][i]));
+
+                        acc_lo = vmlal_n_s16(acc_lo, vget_low_s16(a), w[j]);
+                        acc_hi = vmlal_n_s16(acc_hi, vget_high_s16(a), w[j]);
+                }
+
+                acc_lo = vshrq_n_s32(acc_lo, RESAMPLE_V_SHIFT);
+                acc_hi = vshrq_n_s32(acc_hi, RESAMPLE_V_SHIFT);
+
+                vst1_u8(&dst[i], vqmovn_u16(vcombine_u16(vqmovun_s32(acc_lo), vqmovun_s32(acc_hi))));
+        }
+
+        resample_v_scalar(dst, rows, w, taps, i, n);
+}
+#endif
+
+//
+// linear light mode: horizontal pass linearises through resample_srgb_linear[]
+// on load, vertical pass keeps 15bit and encodes back through a second table
+//
+#define RESAMPLE_LINEAR_MAX             (0xff << RESAMPLE_INTER_BITS)
+
+uint16_t resample_srgb_linear[256];
+static uint8_t resample_linear_srgb[RESAMPLE_LINEAR_MAX + 1];
+static uint32_t linear_light;
+
+static void resample_v_linear_scalar(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                                     uint32_t i, uint32_t n)
+{
+        for (; i < n; i++) {
+                int32_t acc = 1 << (RESAMPLE_WEIGHT_BITS - 1);
+
+                for (uint32_t j = 0; j < taps; j++)
+                        acc += w[j] * rows[j][i];
+
+                acc >>= RESAMPLE_WEIGHT_BITS;
+                dst[i] = resample_linear_srgb[acc < 0 ? 0 : min(acc, RESAMPLE_LINEAR_MAX)];
+        }
+}
+
+#ifdef HAVE_SIMD_SSE2
+static void resample_v_linear_sse2(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                                   uint32_t i, uint32_t n)
+{
+        const __m128i vround = _mm_set1_epi32(1 << (RESAMPLE_WEIGHT_BITS - 1));
+        const __m128i vmax = _mm_set1_epi16(RESAMPLE_LINEAR_MAX);
+        const uint8_t *lut = resample_linear_srgb;
+
+        for (; i + 8 <= n; i += 8) {
+                __m128i acc_lo = vround, acc_hi = vround, v;
+
+                for (uint32_t j = 0; j < taps; j += 2) {
+                        __m128i a = _mm_loadu_si128((const __m128i *)&rows[j][i]);
+                        __m128i b = _mm_setzero_si128();
+                        int32_t w1 = 0;
+                        __m128i ww;
+
+                        if (j + 1 < taps) {
+                                b = _mm_loadu_si128((const __m128i *)&rows[j + 1][i]);
+                                w1 = w[j + 1];
+                        }
+
+                        ww = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)w1 << 16) | (uint16_t)w[j]));
+                        acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), ww));
+                        acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), ww));
+                }
+
+                acc_lo = _mm_srai_epi32(acc_lo, RESAMPLE_WEIGHT_BITS);
+                acc_hi = _mm_srai_epi32(acc_hi, RESAMPLE_WEIGHT_BITS);
+
+                v = _mm_max_epi16(_mm_min_epi16(_mm_packs_epi32(acc_lo, acc_hi), vmax),
+                                  _mm_setzero_si128());
+
+                // no gather in sse2, table is small enough to stay in cache
+                dst[i + 0] = lut[_mm_extract_epi16(v, 0)];
+                dst[i + 1] = lut[_mm_extract_epi16(v, 1)];
+                dst[i + 2] = lut[_mm_extract_epi16(v, 2)];
+                dst[i + 3] = lut[_mm_extract_epi16(v, 3)];
+                dst[i + 4] = lut[_mm_extract_epi16(v, 4)];
+                dst[i + 5] = lut[_mm_extract_epi16(v, 5)];
+                dst[i + 6] = lut[_mm_extract_epi16(v, 6)];
+                dst[i + 7] = lut[_mm_extract_epi16(v, 7)];
+        }
+
+        resample_v_linear_scalar(dst, rows, w, taps, i, n);
+}
+#endif
+
+#ifdef HAVE_SIMD_NEON
+static void resample_v_linear_neon(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                                   uint32_t i, uint32_t n)
+{
+        const int32x4_t vround = vdupq_n_s32(1 << (RESAMPLE_WEIGHT_BITS - 1));
+        uint16_t lin[8];
+
+        for (; i + 8 <= n; i += 8) {
+                int32x4_t acc_lo = vround, acc_hi = vround;
+                int16x8_t v;
+
+                for (uint32_t j = 0; j < taps; j++) {
+                        int16x8_t a = vreinterpretq_s16_u16(vld1q_u16(&rows[j][i]));
+
+                        acc_lo = vmlal_n_s16(acc_lo, vget_low_s16(a), w[j]);
+                        acc_hi = vmlal_n_s16(acc_hi, vget_high_s16(a), w[j]);
+                }
+
+                v = vcombine_s16(vqmovn_s32(vshrq_n_s32(acc_lo, RESAMPLE_WEIGHT_BITS)),
+                                 vqmovn_s32(vshrq_n_s32(acc_hi, RESAMPLE_WEIGHT_BITS)));
+                v = vmaxq_s16(vminq_s16(v, vdupq_n_s16(RESAMPLE_LINEAR_MAX)), vdupq_n_s16(0));
+
+                vst1q_u16(lin, vreinterpretq_u16_s16(v));
+
+                for (int k = 0; k < 8; k++)
+                        dst[i + k] = resample_linear_srgb[lin[k]];
+        }
+
+        resample_v_linear_scalar(dst, rows, w, taps, i, n);
+}
+#endif
+
+static void (*resample_v)(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                          uint32_t i, uint32_t n) = resample_v_scalar;
+static void (*resample_v_linear)(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                                 uint32_t i, uint32_t n) = resample_v_linear_scalar;
+
+void resample_linear_set(uint32_t enable)
+{
+        linear_light = enable;
+
+        if (!enable)
+                return;
+
+        for (uint32_t i = 0; i < ARRAY_SIZE(resample_srgb_linear); i++) {
+                double c = i / 255.0;
+                double l = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+
+                resample_srgb_linear[i] = (uint16_t)lround(l * RESAMPLE_LINEAR_MAX);
+        }
+
+        for (uint32_t i = 0; i < ARRAY_SIZE(resample_linear_srgb); i++) {
+                double l = (double)i / RESAMPLE_LINEAR_MAX;
+                double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+
+                resample_linear_srgb[i] = (uint8_t)lround(c * 255.0);
+        }
+}
+
+//
+// upscaling path: separable clamped Keys cubic, a bit sharper than
+// Catmull-Rom, each pass clamps its result between the two nearest source
+// samples, which drops the overshoot ringing of cubic
+//
+// "edge" mode then looks at image content: on cells crossed by a diagonal
+// edge, where separable cubic steps along both axes, result is blended
+// towards cubic interpolation on a grid rotated along the edge, and output
+// rows get a small unsharp mask held inside the range of their neighbours
+//
+#define UPSCALE_TAPS                    4
+#define UPSCALE_SHARPNESS               (-0.6)  // -0.5 is Catmull-Rom
+#define UPSCALE_SHARPEN_MAX             2.0
+
+char *resample_upscale_strs[] = {
+        [RESAMPLE_UPSCALE_EDGE]         = "edge",
+        [RESAMPLE_UPSCALE_CUBIC]        = "cubic",
+        [RESAMPLE_UPSCALE_LINEAR]       = "linear",
+};
+
+static int upscale_mode = RESAMPLE_UPSCALE_EDGE;
+static int32_t upscale_strength = (int32_t)(RESAMPLE_UPSCALE_SHARPEN_DEFAULT * 256);        // unsharp mask, 1/256
+
+struct upscale_axis {
+        int32_t        *start;          // first tap, window always lies in source
+        int16_t        *weights;        // [output][UPSCALE_TAPS]
+        uint8_t        *near;           // [output][2], taps to clamp between
+        uint8_t        *frac;           // [output], position from near[0] to near[1], 1/256
+};
+
+static double upscale_cubic(double x)
+{
+        const double a = UPSCALE_SHARPNESS;
+
+        x = fabs(x);
+
+        if (x < 1.0)
+                return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+
+        if (x < 2.0)
+                return ((x - 5.0) * x + 8.0) * x * a - 4.0 * a;
+
+        return 0.0;
+}
+
+static void upscale_axis_deinit(struct upscale_axis *ax)
+{
+        if (ax->start)
+                free(ax->start);
+        if (ax->weights)
+                free(ax->weights);
+        if (ax->near)
+                free(ax->near);
+        if (ax->frac)
+                free(ax->frac);
+
+        memset(ax, 0, sizeof(*ax));
+}
+
+// @src_len >= UPSCALE_TAPS, taps out of source are folded onto edge pixels
+static int upscale_axis_init(struct upscale_axis *ax, uint32_t src_len, uint32_t dst_len,
+                             uint32_t off, uint32_t cnt)
+{
+        double scale = (double)src_len / dst_len;
+        int64_t last = (int64_t)src_len - 1;
+
+        ax->start = calloc(cnt, sizeof(*ax->start));
+        ax->weights = calloc((size_t)cnt * UPSCALE_TAPS, sizeof(*ax->weights));
+        ax->near = calloc((size_t)cnt * 2, sizeof(*ax->near));
+        ax->frac = calloc(cnt, sizeof(*ax->frac));
+
+        if (!ax->start || !ax->weights || !ax->near || !ax->frac) {
+                upscale_axis_deinit(ax);
+                return -ENOMEM;
+        }
+
+        for (uint32_t i = 0; i < cnt; i++) {
+                double center = (off + i + 0.5) * scale - 0.5;
+                int64_t p = (int64_t)floor(center);
+                int64_t s = min(max(p - 1, (int64_t)0), last - (UPSCALE_TAPS - 1));
+                int16_t *w = &ax->weights[(size_t)i * UPSCALE_TAPS];
+                double fw[UPSCALE_TAPS] = { 0 };
+                int32_t isum = 0;
+                uint32_t peak = 0;
+
+                for (int64_t k = p - 1; k <= p + 2; k++)
+                        fw[min(max(k, (int64_t)0), last) - s] += upscale_cubic((double)k - center);
+
+                for (uint32_t j = 0; j < UPSCALE_TAPS; j++) {
+                        w[j] = (int16_t)lround(fw[j] * (1 << RESAMPLE_WEIGHT_BITS));
+                        isum += w[j];
+
+                        if (w[j] > w[peak])
+                                peak = j;
+                }
+
+                // keep unity gain exact
+                w[peak] += (int16_t)((1 << RESAMPLE_WEIGHT_BITS) - isum);
+
+                ax->start[i] = (int32_t)s;
+                ax->near[i * 2 + 0] = (uint8_t)(min(max(p, (int64_t)0), last) - s);
+                ax->near[i * 2 + 1] = (uint8_t)(min(max(p + 1, (int64_t)0), last) - s);
+                ax->frac[i] = (uint8_t)min(lround((center - (double)p) * 256.0), 255L);
+        }
+
+        return 0;
+}
+
+// horizontal pass of BGRA32 row into RESAMPLE_INTER_BITS fixed point
+static void upscale_h_scalar(uint16_t *dst, const uint8_t *src, const struct upscale_axis *ax,
+                             uint32_t x, uint32_t cnt)
+{
+        const int32_t shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_INTER_BITS;
+
+        for (; x < cnt; x++) {
+                const int16_t *w = &ax->weights[(size_t)x * UPSCALE_TAPS];
+                const uint8_t *p = &src[(size_t)ax->start[x] * 4];
+                const uint8_t *n0 = &p[ax->near[x * 2 + 0] * 4];
+                const uint8_t *n1 = &p[ax->near[x * 2 + 1] * 4];
+
+                for (int ch = 0; ch < 4; ch++) {
+                        int32_t acc = 1 << (shift - 1);
+                        int32_t lo = min(n0[ch], n1[ch]) << RESAMPLE_INTER_BITS;
+                        int32_t hi = max(n0[ch], n1[ch]) << RESAMPLE_INTER_BITS;
+
+                        for (uint32_t j = 0; j < UPSCALE_TAPS; j++)
+                                acc += w[j] * p[j * 4 + ch];
+
+                        acc >>= shift;
+                        dst[x * 4 + ch] = (uint16_t)(acc < lo ? lo : (acc > hi ? hi : acc));
+                }
+        }
+}
+
+// vertical pass, clamped between rows @n0 and @n1, n is in channels
+static void upscale_v_scalar(uint8_t *dst, uint16_t **rows, const int16_t *w,
+                             uint32_t n0, uint32_t n1, uint32_t i, uint32_t n)
+{
+        for (; i < n; i++) {
+                int32_t acc = 1 << (RESAMPLE_V_SHIFT - 1);
+                int32_t lo = (min(rows[n0][i], rows[n1][i]) + (1 << (RESAMPLE_INTER_BITS - 1))) >> RESAMPLE_INTER_BITS;
+                int32_t hi = (max(rows[n0][i], rows[n1][i]) + (1 << (RESAMPLE_INTER_BITS - 1))) >> RESAMPLE_INTER_BITS;
+
+                for (uint32_t j = 0; j < UPSCALE_TAPS; j++)
+                        acc += w[j] * rows[j][i];
+
+                acc >>= RESAMPLE_V_SHIFT;
+                dst[i] = (uint8_t)(acc < lo ? lo : (acc > hi ? hi : acc));
+        }
+}
+
+//
+// unsharp mask of an output row against its 4 neighbours, @s in 1/256,
+// result stays within neighbourhood range so edges steepen without halos,
+// [i, end) of a @n pixels long row, ends repeat the edge pixel
+//
+static void upscale_sharpen_scalar(uint8_t *dst, const uint8_t *up, const uint8_t *cur,
+                                   const uint8_t *down, uint32_t n, int32_t s,
+                                   uint32_t i, uint32_t end)
+{
+        for (; i < end; i++) {
+                uint32_t l = i ? i - 1 : i;
+                uint32_t r = i + 1 < n ? i + 1 : i;
+
+                for (uint32_t ch = 0; ch < 4; ch++) {
+                        int32_t c = cur[i * 4 + ch];
+                        int32_t a = cur[l * 4 + ch], b = cur[r * 4 + ch];
+                        int32_t u = up[i * 4 + ch], d = down[i * 4 + ch];
+                        int32_t lo = min(min(min(a, b), min(u, d)), c);
+                        int32_t hi = max(max(max(a, b), max(u, d)), c);
+                        // same as a 16bit multiply high of (lap << 5) and s
+                        int32_t v = c + (((4 * c - a - b - u - d) * 32 * s) >> 16);
+
+                        dst[i * 4 + ch] = (uint8_t)(v < lo ? lo : (v > hi ? hi : v));
+                }
+        }
+}
+
+//
+// edge direction of source cells (a pixel with its right and lower
+// neighbours) from a 4x4 luma window: the diagonal with less change runs
+// along an edge, weight in 1/256 says how clearly, sign which diagonal,
+// 0 on flat areas and axis aligned edges which separable cubic gets right
+//
+#define UPSCALE_EDGE_FLAT               48      // total diagonal change of a flat window
+#define UPSCALE_EDGE_RATIO_LO           38      // |g1 - g2| / (g1 + g2) in 1/256, no edge
+#define UPSCALE_EDGE_RATIO_HI           115     // full weight
+
+// @grad is scratch of 2 * @width
+static void upscale_edge_dir(int16_t *dir, int32_t *grad, uint8_t **luma, uint32_t width)
+{
+        int32_t *col1 = grad, *col2 = &grad[width];
+
+        // diagonal changes between each column pair, summed down the window
+        for (uint32_t x = 0; x + 1 < width; x++) {
+                int32_t g1 = 0, g2 = 0;
+
+                for (uint32_t j = 0; j + 1 < UPSCALE_TAPS; j++) {
+                        const uint8_t *a = luma[j], *b = luma[j + 1];
+
+                        g1 += abs(a[x] - b[x + 1]);     // along top left to bottom right
+                        g2 += abs(a[x + 1] - b[x]);     // along top right to bottom left
+                }
+
+                col1[x] = g1;
+                col2[x] = g2;
+        }
+
+        for (uint32_t c = 0; c + 1 < width; c++) {
+                uint32_t l = c ? c - 1 : c;
+                uint32_t r = c + 2 < width ? c + 1 : c;
+                int32_t g1 = col1[l] + col1[c] + col1[r];
+                int32_t g2 = col2[l] + col2[c] + col2[r];
+                int32_t diff = abs(g1 - g2) * 256, sum = g1 + g2, w;
+
+                if (sum < UPSCALE_EDGE_FLAT || diff <= UPSCALE_EDGE_RATIO_LO * sum) {
+                        dir[c] = 0;
+                        continue;
+                }
+
+                if (diff >= UPSCALE_EDGE_RATIO_HI * sum)
+                        w = 256;
+                else
+                        w = (diff - UPSCALE_EDGE_RATIO_LO * sum) * 256 / ((UPSCALE_EDGE_RATIO_HI - UPSCALE_EDGE_RATIO_LO) * sum);
+
+                dir[c] = (int16_t)(g1 < g2 ? w : -w);
+        }
+
+        dir[width - 1] = 0;
+}
+
+//
+// rotated grid cubic: across a cell whose edge runs along a diagonal,
+// source pixels lie on lines parallel to the edge, each line is cubic
+// interpolated at the foot of output point, then cubic across the lines,
+// so taps follow the edge instead of stepping along both axes, taps stay
+// in the 4x4 window of the cell, result is clamped to the cell corners
+// and blended into cubic @out by cell weight
+//
+#define UPSCALE_EDGE_STEPS              16      // kernels per pixel along each axis
+
+// [w < 0][fy][fx], 4x4 window of the cell, sum to 1 << RESAMPLE_WEIGHT_BITS
+static int16_t upscale_edge_kern[2][UPSCALE_EDGE_STEPS + 1][UPSCALE_EDGE_STEPS + 1][UPSCALE_TAPS * UPSCALE_TAPS];
+
+static void upscale_edge_kern_build(int16_t *kern, double fx, double fy, int neg)
+{
+        // lines run x - y = k, "/" edges are mirrored vertically
+        double my = neg ? 1.0 - fy : fy;
+        double t = fx - my, s = fx + my;
+        double fw[UPSCALE_TAPS * UPSCALE_TAPS] = { 0 };
+        int32_t k0 = (int32_t)floor(t);
+        int32_t isum = 0;
+        uint32_t peak = 0;
+
+        for (int32_t k = k0 - 1; k <= k0 + 2; k++) {
+                double foot = (s + k) / 2.0;
+                int32_t a0 = (int32_t)floor(foot);
+                double wk = upscale_cubic(t - k);
+
+                for (int32_t a = a0 - 1; a <= a0 + 2; a++) {
+                        // taps past the window repeat last pixel of the line inside
+                        int32_t px = min(max(a, max(-1, k - 1)), min(2, k + 2));
+                        int32_t py = neg ? 1 - px + k : px - k;
+
+                        fw[(py + 1) * UPSCALE_TAPS + px + 1] += wk * upscale_cubic(foot - a);
+                }
+        }
+
+        for (uint32_t i = 0; i < ARRAY_SIZE(fw); i++) {
+                kern[i] = (int16_t)lround(fw[i] * (1 << RESAMPLE_WEIGHT_BITS));
+                isum += kern[i];
+
+                if (kern[i] > kern[peak])
+                        peak = i;
+        }
+
+        kern[peak] += (int16_t)((1 << RESAMPLE_WEIGHT_BITS) - isum);
+}
+
+static void upscale_edge_kern_init(void)
+{
+        for (int neg = 0; neg < 2; neg++) {
+                for (int y = 0; y <= UPSCALE_EDGE_STEPS; y++) {
+                        for (int x = 0; x <= UPSCALE_EDGE_STEPS; x++) {
+                                upscale_edge_kern_build(upscale_edge_kern[neg][y][x],
+                                                        (double)x / UPSCALE_EDGE_STEPS,
+                                                        (double)y / UPSCALE_EDGE_STEPS, neg);
+                        }
+                }
+        }
+}
+
+//
+// kernel on the window of a cell, clamped to its corners, blended into
+// cubic result @out by |@w| of 256, alpha of opaque source stays opaque
+//
+static inline void upscale_edge_apply_scalar(uint8_t *out, const int16_t *kern, const uint8_t *win,
+                                             int32_t w)
+{
+        const uint8_t *p00 = &win[(UPSCALE_TAPS + 1) * 4], *p01 = p00 + UPSCALE_TAPS * 4;
+
+        for (uint32_t ch = 0; ch < 4; ch++) {
+                int32_t lo = min(min(p00[ch], p00[ch + 4]), min(p01[ch], p01[ch + 4]));
+                int32_t hi = max(max(p00[ch], p00[ch + 4]), max(p01[ch], p01[ch + 4]));
+                int32_t v = 1 << (RESAMPLE_WEIGHT_BITS - 1);
+                int32_t o = out[ch];
+
+                for (uint32_t i = 0; i < UPSCALE_TAPS * UPSCALE_TAPS; i++)
+                        v += kern[i] * win[i * 4 + ch];
+
+                v >>= RESAMPLE_WEIGHT_BITS;
+                v = v < lo ? lo : (v > hi ? hi : v);
+                out[ch] = (uint8_t)(o + ((w * (v - o) + 128) >> 8));
+        }
+}
+
+//
+// @rows are the cubic taps of current output row, cell top is @rows[@row0],
+// @apply is inlined into each simd flavour
+//
+static inline void upscale_edge_row_do(uint8_t *out, uint8_t **rows, uint32_t row0, uint32_t width,
+                                       const int16_t *dir, const struct upscale_axis *ax,
+                                       int32_t fy, uint32_t cnt,
+                                       void (*apply)(uint8_t *out, const int16_t *kern,
+                                                     const uint8_t *win, int32_t w))
+{
+        const int32_t qy = (fy * UPSCALE_EDGE_STEPS + 128) / 256;
+        const uint8_t *r[UPSCALE_TAPS];
+        uint8_t win[UPSCALE_TAPS * UPSCALE_TAPS * 4] __attribute__((aligned(16)));
+        int32_t win_cx = -1;
+
+        for (int32_t j = 0; j < UPSCALE_TAPS; j++)
+                r[j] = rows[min(max((int32_t)row0 + j - 1, 0), UPSCALE_TAPS - 1)];
+
+        for (uint32_t x = 0; x < cnt; x++) {
+                const uint8_t *near = &ax->near[x * 2];
+                int32_t cx = ax->start[x] + near[0];
+                int32_t w = dir[cx];
+
+                if (!w || near[0] == near[1])
+                        continue;
+
+                if (win_cx != cx) {
+                        for (int32_t j = 0; j < UPSCALE_TAPS; j++) {
+                                if (cx >= 1 && cx + 2 < (int32_t)width) {
+                                        memcpy(&win[j * UPSCALE_TAPS * 4], &r[j][(cx - 1) * 4], UPSCALE_TAPS * 4);
+                                        continue;
+                                }
+
+                                for (int32_t i = 0; i < UPSCALE_TAPS; i++) {
+                                        int32_t rx = min(max(cx + i - 1, 0), (int32_t)width - 1);
+
+                                        memcpy(&win[(j * UPSCALE_TAPS + i) * 4], &r[j][rx * 4], 4);
+                                }
+                        }
+
+                        win_cx = cx;
+                }
+
+                apply(&out[x * 4], upscale_edge_kern[w < 0][qy][(ax->frac[x] * UPSCALE_EDGE_STEPS + 128) / 256],
+                      win, abs(w));
+        }
+}
+
+static void upscale_edge_row_scalar(uint8_t *out, uint8_t **rows, uint32_t row0, uint32_t width,
+                                    const int16_t *dir, const struct upscale_axis *ax,
+                                    int32_t fy, uint32_t cnt)
+{
+        upscale_edge_row_do(out, rows, row0, width, dir, ax, fy, cnt, upscale_edge_apply_scalar);
+}
+
+#ifdef HAVE_SIMD_SSE2
+static inline __m128i pixel_load_epi16_sse2(const uint8_t *p)
+{
+        int32_t v;
+
+        memcpy(&v, p, sizeof(v));
+
+        return _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+}
+
+// one output pixel per step, four taps of four channels in two madd
+static void upscale_h_sse2(uint16_t *dst, const uint8_t *src, const struct upscale_axis *ax,
+                           uint32_t x, uint32_t cnt)
+{
+        const int32_t shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_INTER_BITS;
+        const __m128i vround = _mm_set1_epi32(1 << (shift - 1));
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; x < cnt; x++) {
+                const int16_t *w = &ax->weights[(size_t)x * UPSCALE_TAPS];
+                const uint8_t *p = &src[(size_t)ax->start[x] * 4];
+                __m128i px = _mm_loadu_si128((const __m128i *)p);
+                __m128i p01 = _mm_unpacklo_epi8(px, zero);
+                __m128i p23 = _mm_unpackhi_epi8(px, zero);
+                __m128i w01 = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)w[1] << 16) | (uint16_t)w[0]));
+                __m128i w23 = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)w[3] << 16) | (uint16_t)w[2]));
+                __m128i n0 = pixel_load_epi16_sse2(&p[ax->near[x * 2 + 0] * 4]);
+                __m128i n1 = pixel_load_epi16_sse2(&p[ax->near[x * 2 + 1] * 4]);
+                __m128i acc, v;
+
+                // b0 b1 g0 g1 r0 r1 a0 a1
+                p01 = _mm_unpacklo_epi16(p01, _mm_srli_si128(p01, 8));
+                p23 = _mm_unpacklo_epi16(p23, _mm_srli_si128(p23, 8));
+
+                acc = _mm_add_epi32(_mm_madd_epi16(p01, w01), _mm_madd_epi16(p23, w23));
+                acc = _mm_srai_epi32(_mm_add_epi32(acc, vround), shift);
+                v = _mm_packs_epi32(acc, acc);
+
+                v = _mm_max_epi16(v, _mm_slli_epi16(_mm_min_epi16(n0, n1), RESAMPLE_INTER_BITS));
+                v = _mm_min_epi16(v, _mm_slli_epi16(_mm_max_epi16(n0, n1), RESAMPLE_INTER_BITS));
+
+                _mm_storel_epi64((__m128i *)&dst[x * 4], v);
+        }
+}
+
+static void upscale_v_sse2(uint8_t *dst, uint16_t **rows, const int16_t *w,
+                           uint32_t n0, uint32_t n1, uint32_t i, uint32_t n)
+{
+        const __m128i vround = _mm_set1_epi32(1 << (RESAMPLE_V_SHIFT - 1));
+        const __m128i bround = _mm_set1_epi16(1 << (RESAMPLE_INTER_BITS - 1));
+        const __m128i w01 = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)w[1] << 16) | (uint16_t)w[0]));
+        const __m128i w23 = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)w[3] << 16) | (uint16_t)w[2]));
+
+        for (; i + 8 <= n; i += 8) {
+                __m128i r0 = _mm_loadu_si128((const __m128i *)&rows[0][i]);
+                __m128i r1 = _mm_loadu_si128((const __m128i *)&rows[1][i]);
+                __m128i r2 = _mm_loadu_si128((const __m128i *)&rows[2][i]);
+                __m128i r3 = _mm_loadu_si128((const __m128i *)&rows[3][i]);
+                __m128i a = _mm_loadu_si128((const __m128i *)&rows[n0][i]);
+                __m128i b = _mm_loadu_si128((const __m128i *)&rows[n1][i]);
+                __m128i acc_lo, acc_hi, v, lo, hi;
+
+                acc_lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r0, r1), w01),
+                                       _mm_madd_epi16(_mm_unpacklo_epi16(r2, r3), w23));
+                acc_hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r0, r1), w01),
+                                       _mm_madd_epi16(_mm_unpackhi_epi16(r2, r3), w23));
+
+                acc_lo = _mm_srai_epi32(_mm_add_epi32(acc_lo, vround), RESAMPLE_V_SHIFT);
+                acc_hi = _mm_srai_epi32(_mm_add_epi32(acc_hi, vround), RESAMPLE_V_SHIFT);
+                v = _mm_packs_epi32(acc_lo, acc_hi);
+
+                lo = _mm_srli_epi16(_mm_add_epi16(_mm_min_epi16(a, b), bround), RESAMPLE_INTER_BITS);
+                hi = _mm_srli_epi16(_mm_add_epi16(_mm_max_epi16(a, b), bround), RESAMPLE_INTER_BITS);
+                v = _mm_min_epi16(_mm_max_epi16(v, lo), hi);
+
+                _mm_storel_epi64((__m128i *)&dst[i], _mm_packus_epi16(v, v));
+        }
+
+        upscale_v_scalar(dst, rows, w, n0, n1, i, n);
+}
+
+static inline __m128i sharpen_half_sse2(__m128i c, __m128i a, __m128i b, __m128i u, __m128i d,
+                                        __m128i s)
+{
+        __m128i lap = _mm_sub_epi16(_mm_slli_epi16(c, 2),
+                                    _mm_add_epi16(_mm_add_epi16(a, b), _mm_add_epi16(u, d)));
+
+        return _mm_add_epi16(c, _mm_mulhi_epi16(_mm_slli_epi16(lap, 5), s));
+}
+
+static void upscale_sharpen_sse2(uint8_t *dst, const uint8_t *up, const uint8_t *cur,
+                                 const uint8_t *down, uint32_t n, int32_t s,
+                                 uint32_t i, uint32_t end)
+{
+        const __m128i vs = _mm_set1_epi16((int16_t)s);
+        const __m128i zero = _mm_setzero_si128();
+
+        if (i == 0 && end) {
+                upscale_sharpen_scalar(dst, up, cur, down, n, s, 0, 1);
+                i = 1;
+        }
+
+        // four pixels with both horizontal neighbours inside row
+        for (; i + 5 <= n && i + 4 <= end; i += 4) {
+                __m128i c = _mm_loadu_si128((const __m128i *)&cur[i * 4]);
+                __m128i a = _mm_loadu_si128((const __m128i *)&cur[i * 4 - 4]);
+                __m128i b = _mm_loadu_si128((const __m128i *)&cur[i * 4 + 4]);
+                __m128i u = _mm_loadu_si128((const __m128i *)&up[i * 4]);
+                __m128i d = _mm_loadu_si128((const __m128i *)&down[i * 4]);
+                __m128i lo = _mm_min_epu8(_mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(u, d)), c);
+                __m128i hi = _mm_max_epu8(_mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(u, d)), c);
+                __m128i v_lo, v_hi;
+
+                v_lo = sharpen_half_sse2(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(a, zero),
+                                         _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(u, zero),
+                                         _mm_unpacklo_epi8(d, zero), vs);
+                v_hi = sharpen_half_sse2(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(a, zero),
+                                         _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(u, zero),
+                                         _mm_unpackhi_epi8(d, zero), vs);
+
+                c = _mm_packus_epi16(v_lo, v_hi);
+                c = _mm_min_epu8(_mm_max_epu8(c, lo), hi);
+
+                _mm_storeu_si128((__m128i *)&dst[i * 4], c);
+        }
+
+        upscale_sharpen_scalar(dst, up, cur, down, n, s, i, end);
+}
+
+// four taps of a window row per two madd, same layout as upscale_h_sse2()
+static inline void upscale_edge_apply_sse2(uint8_t *out, const int16_t *kern, const uint8_t *win,
+                                           int32_t w)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const uint8_t *p00 = &win[(UPSCALE_TAPS + 1) * 4], *p01 = p00 + UPSCALE_TAPS * 4;
+        __m128i acc = _mm_set1_epi32(1 << (RESAMPLE_WEIGHT_BITS - 1));
+        __m128i c0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p00), zero);
+        __m128i c1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p01), zero);
+        __m128i lo = _mm_min_epi16(c0, c1), hi = _mm_max_epi16(c0, c1);
+        __m128i o = pixel_load_epi16_sse2(out);
+        __m128i v, d;
+        int32_t res;
+
+        for (uint32_t j = 0; j < UPSCALE_TAPS; j++) {
+                const int16_t *k = &kern[j * UPSCALE_TAPS];
+                __m128i px = _mm_load_si128((const __m128i *)&win[j * UPSCALE_TAPS * 4]);
+                __m128i p01 = _mm_unpacklo_epi8(px, zero);
+                __m128i p23 = _mm_unpackhi_epi8(px, zero);
+                __m128i k01 = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)k[1] << 16) | (uint16_t)k[0]));
+                __m128i k23 = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)k[3] << 16) | (uint16_t)k[2]));
+
+                p01 = _mm_unpacklo_epi16(p01, _mm_srli_si128(p01, 8));
+                p23 = _mm_unpacklo_epi16(p23, _mm_srli_si128(p23, 8));
+
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(p01, k01));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(p23, k23));
+        }
+
+        v = _mm_srai_epi32(acc, RESAMPLE_WEIGHT_BITS);
+        v = _mm_packs_epi32(v, v);
+        v = _mm_max_epi16(v, _mm_min_epi16(lo, _mm_srli_si128(lo, 8)));
+        v = _mm_min_epi16(v, _mm_max_epi16(hi, _mm_srli_si128(hi, 8)));
+
+        // w * (v - o) + 128 in one madd
+        d = _mm_unpacklo_epi16(_mm_sub_epi16(v, o), _mm_set1_epi16(1));
+        d = _mm_madd_epi16(d, _mm_set1_epi32((int32_t)((128u << 16) | (uint32_t)w)));
+        d = _mm_srai_epi32(d, 8);
+        v = _mm_add_epi16(o, _mm_packs_epi32(d, d));
+
+        res = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+        memcpy(out, &res, sizeof(res));
+}
+
+static void upscale_edge_row_sse2(uint8_t *out, uint8_t **rows, uint32_t row0, uint32_t width,
+                                  const int16_t *dir, const struct upscale_axis *ax,
+                                  int32_t fy, uint32_t cnt)
+{
+        upscale_edge_row_do(out, rows, row0, width, dir, ax, fy, cnt, upscale_edge_apply_sse2);
+}
+#endif
+
+#ifdef HAVE_SIMD_NEON
+static inline int16x4_t pixel_load_s16_neon(const uint8_t *p)
+{
+        uint32_t v;
+
+        memcpy(&v, p, sizeof(v));
+
+        return vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(v))));
+}
+
+static void upscale_h_neon(uint16_t *dst, const uint8_t *src, const struct upscale_axis *ax,
+                           uint32_t x, uint32_t cnt)
+{
+        const int32_t shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_INTER_BITS;
+
+        for (; x < cnt; x++) {
+                const int16_t *w = &ax->weights[(size_t)x * UPSCALE_TAPS];
+                const uint8_t *p = &src[(size_t)ax->start[x] * 4];
+                uint8x16_t px = vld1q_u8(p);
+                int16x8_t p01 = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(px)));
+                int16x8_t p23 = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(px)));
+                int16x4_t n0 = pixel_load_s16_neon(&p[ax->near[x * 2 + 0] * 4]);
+                int16x4_t n1 = pixel_load_s16_neon(&p[ax->near[x * 2 + 1] * 4]);
+                int32x4_t acc;
+                int16x4_t v;
+
+                acc = vmull_n_s16(vget_low_s16(p01), w[0]);
+                acc = vmlal_n_s16(acc, vget_high_s16(p01), w[1]);
+                acc = vmlal_n_s16(acc, vget_low_s16(p23), w[2]);
+                acc = vmlal_n_s16(acc, vget_high_s16(p23), w[3]);
+
+                v = vqmovn_s32(vrshrq_n_s32(acc, shift));
+                v = vmax_s16(v, vshl_n_s16(vmin_s16(n0, n1), RESAMPLE_INTER_BITS));
+                v = vmin_s16(v, vshl_n_s16(vmax_s16(n0, n1), RESAMPLE_INTER_BITS));
+
+                vst1_u16(&dst[x * 4], vreinterpret_u16_s16(v));
+        }
+}
+
+static void upscale_v_neon(uint8_t *dst, uint16_t **rows, const int16_t *w,
+                           uint32_t n0, uint32_t n1, uint32_t i, uint32_t n)
+{
+        for (; i + 8 <= n; i += 8) {
+                int16x8_t a = vreinterpretq_s16_u16(vld1q_u16(&rows[n0][i]));
+                int16x8_t b = vreinterpretq_s16_u16(vld1q_u16(&rows[n1][i]));
+                int32x4_t acc_lo = vdupq_n_s32(0), acc_hi = vdupq_n_s32(0);
+                int16x8_t v, lo, hi;
+
+                for (uint32_t j = 0; j < UPSCALE_TAPS; j++) {
+                        int16x8_t r = vreinterpretq_s16_u16(vld1q_u16(&rows[j][i]));
+
+                        acc_lo = vmlal_n_s16(acc_lo, vget_low_s16(r), w[j]);
+                        acc_hi = vmlal_n_s16(acc_hi, vget_high_s16(r), w[j]);
+                }
+
+                v = vcombine_s16(vqmovn_s32(vrshrq_n_s32(acc_lo, RESAMPLE_V_SHIFT)),
+                                 vqmovn_s32(vrshrq_n_s32(acc_hi, RESAMPLE_V_SHIFT)));
+
+                lo = vrshrq_n_s16(vminq_s16(a, b), RESAMPLE_INTER_BITS);
+                hi = vrshrq_n_s16(vmaxq_s16(a, b), RESAMPLE_INTER_BITS);
+                v = vminq_s16(vmaxq_s16(v, lo), hi);
+
+                vst1_u8(&dst[i], vqmovun_s16(v));
+        }
+
+        upscale_v_scalar(dst, rows, w, n0, n1, i, n);
+}
+
+static inline int16x8_t sharpen_half_neon(uint8x8_t c8, uint8x8_t a8, uint8x8_t b8,
+                                          uint8x8_t u8, uint8x8_t d8, int16x8_t s)
+{
+        int16x8_t c = vreinterpretq_s16_u16(vmovl_u8(c8));
+        int16x8_t sum = vreinterpretq_s16_u16(vaddq_u16(vaddl_u8(a8, b8), vaddl_u8(u8, d8)));
+        int16x8_t lap = vsubq_s16(vshlq_n_s16(c, 2), sum);
+
+        // doubling multiply high, lap << 4 gives the (lap << 5) * s >> 16 of scalar
+        return vaddq_s16(c, vqdmulhq_s16(vshlq_n_s16(lap, 4), s));
+}
+
+static void upscale_sharpen_neon(uint8_t *dst, const uint8_t *up, const uint8_t *cur,
+                                 const uint8_t *down, uint32_t n, int32_t s,
+                                 uint32_t i, uint32_t end)
+{
+        const int16x8_t vs = vdupq_n_s16((int16_t)s);
+
+        if (i == 0 && end) {
+                upscale_sharpen_scalar(dst, up, cur, down, n, s, 0, 1);
+                i = 1;
+        }
+
+        for (; i + 5 <= n && i + 4 <= end; i += 4) {
+                uint8x16_t c = vld1q_u8(&cur[i * 4]);
+                uint8x16_t a = vld1q_u8(&cur[i * 4 - 4]);
+                uint8x16_t b = vld1q_u8(&cur[i * 4 + 4]);
+                uint8x16_t u = vld1q_u8(&up[i * 4]);
+                uint8x16_t d = vld1q_u8(&down[i * 4]);
+                uint8x16_t lo = vminq_u8(vminq_u8(vminq_u8(a, b), vminq_u8(u, d)), c);
+                uint8x16_t hi = vmaxq_u8(vmaxq_u8(vmaxq_u8(a, b), vmaxq_u8(u, d)), c);
+                int16x8_t v_lo, v_hi;
+
+                v_lo = sharpen_half_neon(vget_low_u8(c), vget_low_u8(a), vget_low_u8(b),
+                                         vget_low_u8(u), vget_low_u8(d), vs);
+                v_hi = sharpen_half_neon(vget_high_u8(c), vget_high_u8(a), vget_high_u8(b),
+                                         vget_high_u8(u), vget_high_u8(d), vs);
+
+                c = vcombine_u8(vqmovun_s16(v_lo), vqmovun_s16(v_hi));
+                c = vminq_u8(vmaxq_u8(c, lo), hi);
+
+                vst1q_u8(&dst[i * 4], c);
+        }
+
+        upscale_sharpen_scalar(dst, up, cur, down, n, s, i, end);
+}
+
+static inline void upscale_edge_apply_neon(uint8_t *out, const int16_t *kern, const uint8_t *win,
+                                           int32_t w)
+{
+        const uint8_t *p00 = &win[(UPSCALE_TAPS + 1) * 4], *p01 = p00 + UPSCALE_TAPS * 4;
+        uint8x8_t c0 = vld1_u8(p00), c1 = vld1_u8(p01);
+        uint8x8_t lo = vmin_u8(c0, c1), hi = vmax_u8(c0, c1);
+        int16x4_t o = pixel_load_s16_neon(out);
+        int32x4_t acc = vdupq_n_s32(0);
+        int16x4_t v;
+        uint32_t res;
+
+        for (uint32_t j = 0; j < UPSCALE_TAPS; j++) {
+                const int16_t *k = &kern[j * UPSCALE_TAPS];
+                uint8x16_t px = vld1q_u8(&win[j * UPSCALE_TAPS * 4]);
+                int16x8_t p01 = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(px)));
+                int16x8_t p23 = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(px)));
+
+                acc = vmlal_n_s16(acc, vget_low_s16(p01), k[0]);
+                acc = vmlal_n_s16(acc, vget_high_s16(p01), k[1]);
+                acc = vmlal_n_s16(acc, vget_low_s16(p23), k[2]);
+                acc = vmlal_n_s16(acc, vget_high_s16(p23), k[3]);
+        }
+
+        lo = vmin_u8(lo, vext_u8(lo, lo, 4));
+        hi = vmax_u8(hi, vext_u8(hi, hi, 4));
+
+        v = vmovn_s32(vrshrq_n_s32(acc, RESAMPLE_WEIGHT_BITS));
+        v = vmax_s16(v, vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(lo))));
+        v = vmin_s16(v, vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(hi))));
+
+        acc = vmlal_n_s16(vdupq_n_s32(128), vsub_s16(v, o), (int16_t)w);
+        v = vadd_s16(o, vmovn_s32(vshrq_n_s32(acc, 8)));
+
+        res = vget_lane_u32(vreinterpret_u32_u8(vqmovun_s16(vcombine_s16(v, v))), 0);
+        memcpy(out, &res, sizeof(res));
+}
+
+static void upscale_edge_row_neon(uint8_t *out, uint8_t **rows, uint32_t row0, uint32_t width,
+                                  const int16_t *dir, const struct upscale_axis *ax,
+                                  int32_t fy, uint32_t cnt)
+{
+        upscale_edge_row_do(out, rows, row0, width, dir, ax, fy, cnt, upscale_edge_apply_neon);
+}
+#endif
+
+static void (*upscale_h)(uint16_t *dst, const uint8_t *src, const struct upscale_axis *ax,
+                         uint32_t x, uint32_t cnt) = upscale_h_scalar;
+static void (*upscale_v)(uint8_t *dst, uint16_t **rows, const int16_t *w,
+                         uint32_t n0, uint32_t n1, uint32_t i, uint32_t n) = upscale_v_scalar;
+static void (*upscale_edge_row)(uint8_t *out, uint8_t **rows, uint32_t row0, uint32_t width,
+                                const int16_t *dir, const struct upscale_axis *ax,
+                                int32_t fy, uint32_t cnt) = upscale_edge_row_scalar;
+static void (*upscale_sharpen)(uint8_t *dst, const uint8_t *up, const uint8_t *cur,
+                               const uint8_t *down, uint32_t n, int32_t s,
+                               uint32_t i, uint32_t end) = upscale_sharpen_scalar;
+
+void resample_upscale_set(int mode)
+{
+        upscale_mode = mode;
+}
+
+// unsharp mask strength of upscaled output, 0 turns it off
+void resample_upscale_sharpen_set(double strength)
+{
+        upscale_strength = (int32_t)lround(min(max(strength, 0.0), UPSCALE_SHARPEN_MAX) * 256.0);
+}
+
+// alpha sources stay on premultiplied triangle path
+int resample_upscale_used(uint32_t src_width, uint32_t src_height,
+                          uint32_t dst_width, uint32_t dst_height, uint32_t alpha)
+{
+        if (upscale_mode == RESAMPLE_UPSCALE_LINEAR || alpha)
+                return 0;
+
+        if (src_width < UPSCALE_TAPS || src_height < UPSCALE_TAPS)
+                return 0;
+
+        return dst_width >= src_width && dst_height >= src_height &&
+               (dst_width > src_width || dst_height > src_height);
+}
+
+// store row @y of upscaled output, sharpened against its neighbour rows if enabled
+static void upscale_row_store(struct canvas *c, struct rectangle *vis, const struct pixel_ops *ops,
+                              uint8_t **outs, uint8_t *tmp, uint32_t y)
+{
+        const uint8_t *cur = outs[y % 3];
+        const uint8_t *up = y ? outs[(y - 1) % 3] : cur;
+        const uint8_t *down = y + 1 < vis->height ? outs[(y + 1) % 3] : cur;
+
+        if (upscale_strength) {
+                upscale_sharpen(tmp, up, cur, down, vis->width, upscale_strength, 0, vis->width);
+                cur = tmp;
+        }
+
+        ops->store(canvas_pixel(c, vis->x, vis->y + y), cur, vis->width);
+}
+
+//
+// @vis is already clipped into @dst and canvas, source rows of cubic taps
+// are kept swizzled for the edge pass, output rows are stored one row
+// late since sharpening needs the next one
+//
+static int pixel_upscale(struct canvas *c, struct rectangle *vis, struct rectangle *dst,
+                         struct pixel_image *img)
+{
+        const struct pixel_ops *ops = img->ops;
+        struct upscale_axis ax_x = { 0 }, ax_y = { 0 };
+        uint16_t *ring[UPSCALE_TAPS] = { 0 }, *rows[UPSCALE_TAPS];
+        uint8_t *src_ring[UPSCALE_TAPS] = { 0 }, *srcs[UPSCALE_TAPS];
+        uint8_t *luma_ring[UPSCALE_TAPS] = { 0 }, *lumas[UPSCALE_TAPS];
+        int32_t ring_tag[UPSCALE_TAPS];
+        uint8_t *outs[3] = { 0 }, *tmp = NULL;
+        int edge = upscale_mode == RESAMPLE_UPSCALE_EDGE;
+        int16_t *dir = NULL;
+        int32_t *grad = NULL, dir_tag = -1;
+        int err = 0;
+
+        if ((err = upscale_axis_init(&ax_x, img->width, dst->width, vis->x - dst->x, vis->width)))
+                return err;
+
+        if ((err = upscale_axis_init(&ax_y, img->height, dst->height, vis->y - dst->y, vis->height)))
+                goto out_ax_x;
+
+        tmp = mem_aligned_alloc((size_t)vis->width * 4);
+        if (!tmp) {
+                err = -ENOMEM;
+                goto out_free;
+        }
+
+        for (uint32_t j = 0; j < ARRAY_SIZE(outs); j++) {
+                outs[j] = mem_aligned_alloc((size_t)vis->width * 4);
+                if (!outs[j]) {
+                        err = -ENOMEM;
+                        goto out_free;
+                }
+        }
+
+        if (edge) {
+                dir = calloc(img->width, sizeof(*dir));
+                grad = calloc((size_t)img->width * 2, sizeof(*grad));
+                if (!dir || !grad) {
+                        err = -ENOMEM;
+                        goto out_free;
+                }
+        }
+
+        for (uint32_t j = 0; j < UPSCALE_TAPS; j++) {
+                ring[j] = mem_aligned_alloc((size_t)vis->width * 4 * sizeof(uint16_t));
+                src_ring[j] = mem_aligned_alloc((size_t)img->width * 4);
+                if (!ring[j] || !src_ring[j]) {
+                        err = -ENOMEM;
+                        goto out_free;
+                }
+
+                if (edge) {
+                        luma_ring[j] = mem_aligned_alloc(img->width);
+                        if (!luma_ring[j]) {
+                                err = -ENOMEM;
+                                goto out_free;
+                        }
+                }
+
+                ring_tag[j] = -1;
+        }
+
+        for (uint32_t y = 0; y < vis->height; y++) {
+                const uint8_t *near = &ax_y.near[y * 2];
+                uint8_t *out = outs[y % 3];
+
+                for (uint32_t j = 0; j < UPSCALE_TAPS; j++) {
+                        int32_t sy = ax_y.start[y] + j;
+                        uint32_t slot = (uint32_t)sy % UPSCALE_TAPS;
+
+                        if (ring_tag[slot] != sy) {
+                                ops->swizzle(src_ring[slot], pixel_image_row(img, sy), img->width);
+                                upscale_h(ring[slot], src_ring[slot], &ax_x, 0, vis->width);
+
+                                if (edge)
+                                        pixel_luma_row(luma_ring[slot], src_ring[slot], img->width);
+
+                                ring_tag[slot] = sy;
+                        }
+
+                        rows[j] = ring[slot];
+                        srcs[j] = src_ring[slot];
+                        lumas[j] = luma_ring[slot];
+                }
+
+                upscale_v(out, rows, &ax_y.weights[(size_t)y * UPSCALE_TAPS],
+                          near[0], near[1], 0, vis->width * 4);
+
+                if (edge && near[0] != near[1]) {
+                        int32_t cy = ax_y.start[y] + near[0];
+
+                        if (dir_tag != cy) {
+                                upscale_edge_dir(dir, grad, lumas, img->width);
+                                dir_tag = cy;
+                        }
+
+                        upscale_edge_row(out, srcs, near[0], img->width, dir, &ax_x,
+                                         ax_y.frac[y], vis->width);
+                }
+
+                if (y)
+                        upscale_row_store(c, vis, ops, outs, tmp, y - 1);
+        }
+
+        upscale_row_store(c, vis, ops, outs, tmp, vis->height - 1);
+
+out_free:
+        for (uint32_t j = 0; j < UPSCALE_TAPS; j++) {
+                if (ring[j])
+                        mem_aligned_free(ring[j]);
+                if (src_ring[j])
+                        mem_aligned_free(src_ring[j]);
+                if (luma_ring[j])
+                        mem_aligned_free(luma_ring[j]);
+        }
+
+        for (uint32_t j = 0; j < ARRAY_SIZE(outs); j++) {
+                if (outs[j])
+                        mem_aligned_free(outs[j]);
+        }
+
+        if (tmp)
+                mem_aligned_free(tmp);
+        if (dir)
+                free(dir);
+        if (grad)
+                free(grad);
+
+        upscale_axis_deinit(&ax_y);
+
+out_ax_x:
+        upscale_axis_deinit(&ax_x);
+
+        return err;
+}
+
+void resample_simd_init(int simd)
+{
+        upscale_edge_kern_init();
+
+        switch (simd) {
+#ifdef HAVE_SIMD_SSE2
+        case CPU_SIMD_SSE2:
+                resample_v = resample_v_sse2;
+                resample_v_linear = resample_v_linear_sse2;
+                upscale_h = upscale_h_sse2;
+                upscale_v = upscale_v_sse2;
+                upscale_edge_row = upscale_edge_row_sse2;
+                upscale_sharpen = upscale_sharpen_sse2;
+                break;
+#endif
+
+#ifdef HAVE_SIMD_NEON
+        case CPU_SIMD_NEON:
+                resample_v = resample_v_neon;
+                resample_v_linear = resample_v_linear_neon;
+                upscale_h = upscale_h_neon;
+                upscale_v = upscale_v_neon;
+                upscale_edge_row = upscale_edge_row_neon;
+                upscale_sharpen = upscale_sharpen_neon;
+                break;
+#endif
+
+        default:
+                resample_v = resample_v_scalar;
+                resample_v_linear = resample_v_linear_scalar;
+                upscale_h = upscale_h_scalar;
+                upscale_v = upscale_v_scalar;
+                upscale_edge_row = upscale_edge_row_scalar;
+                upscale_sharpen = upscale_sharpen_scalar;
+                break;
+        }
+}
+
+//
+// single channel horizontal pass of GREY8 sources, a quarter of the
+// intermediate of the BGRA path, canvas store replicates luma
+//
+static void resample_h_grey(uint16_t *dst, const uint8_t *src,
+                            const struct resample_axis *ax, uint32_t cnt)
+{
+        const int32_t shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_INTER_BITS;
+
+        for (uint32_t x = 0; x < cnt; x++) {
+                const int16_t *w = &ax->weights[(size_t)x * ax->taps];
+                const uint8_t *p = &src[ax->start[x]];
+                int32_t acc = 1 << (shift - 1);
+
+                for (uint32_t j = 0; j < ax->count[x]; j++)
+                        acc += w[j] * p[j];
+
+                dst[x] = (uint16_t)(acc >> shift);
+        }
+}
+
+static void resample_h_grey_linear(uint16_t *dst, const uint8_t *src,
+                                   const struct resample_axis *ax, uint32_t cnt)
+{
+        for (uint32_t x = 0; x < cnt; x++) {
+                const int16_t *w = &ax->weights[(size_t)x * ax->taps];
+                const uint8_t *p = &src[ax->start[x]];
+                int32_t acc = 1 << (RESAMPLE_WEIGHT_BITS - 1);
+
+                for (uint32_t j = 0; j < ax->count[x]; j++)
+                        acc += w[j] * resample_srgb_linear[p[j]];
+
+                dst[x] = (uint16_t)(acc >> RESAMPLE_WEIGHT_BITS);
+        }
+}
+
+//
+// scale @img to the size of @dst (in canvas coordinate) and write the part
+// inside @clip into canvas, only needed source rows are filtered, opaque
+// sources are filtered in linear light if enabled
+//
+int pixel_resample(struct canvas *c, struct rectangle *clip, struct rectangle *dst,
+                   struct pixel_image *img)
+{
+        const struct pixel_ops *ops = img->ops;
+        void (*h_pass)(uint16_t *dst, const uint8_t *src,
+                       const struct resample_axis *ax, uint32_t cnt) = ops->resample_h;
+        void (*v_pass)(uint8_t *dst, uint16_t **rows, const int16_t *w, uint32_t taps,
+                       uint32_t i, uint32_t n) = resample_v;
+        void (*store)(uint8_t *dst, const uint8_t *src, uint32_t n) = ops->store;
+        int linear = linear_light && ops->resample_h_linear;
+        uint32_t ch = 4;
+        struct resample_axis ax_x, ax_y;
+        struct rectangle vis;
+        int64_t x0, y0, x1, y1;
+        uint16_t **ring = NULL, **rows = NULL;
+        int32_t *ring_tag = NULL;
+        uint8_t *out = NULL;
+        int err = 0;
+
+        if (!dst->width || !dst->height)
+                return -EINVAL;
+
+        x0 = max((int64_t)dst->x, (int64_t)clip->x);
+        y0 = max((int64_t)dst->y, (int64_t)clip->y);
+        x1 = min((int64_t)dst->x + dst->width, (int64_t)clip->x + clip->width);
+        y1 = min((int64_t)dst->y + dst->height, (int64_t)clip->y + clip->height);
+
+        if (x1 <= x0 || y1 <= y0)
+                return 0;
+
+        vis = (struct rectangle){ (int32_t)x0, (int32_t)y0, (uint32_t)(x1 - x0), (uint32_t)(y1 - y0) };
+
+        if (canvas_rect_clip(c, &vis))
+                return 0;
+
+        // source already rendered at target size, e.g. rasterised vector
+        if (img->width == dst->width && img->height == dst->height)
+                return pixel_blit(c, &vis, dst->x, dst->y, img);
+
+        if (resample_upscale_used(img->width, img->height, dst->width, dst->height, img->alpha))
+                return pixel_upscale(c, &vis, dst, img);
+
+        if (linear) {
+                h_pass = ops->resample_h_linear;
+                v_pass = resample_v_linear;
+        }
+
+        // vertical pass does not care about channels, grey blit expands to BGRA
+        if (img->layout == PIXEL_GREY8) {
+                h_pass = linear ? resample_h_grey_linear : resample_h_grey;
+                store = ops->blit;
+                ch = 1;
+        }
+
+        if ((err = resample_axis_init(&ax_x, img->width, dst->width, vis.x - dst->x, vis.width)))
+                return err;
+
+        if ((err = resample_axis_init(&ax_y, img->height, dst->height, vis.y - dst->y, vis.height)))
+                goto out_ax_x;
+
+        ring = calloc(ax_y.taps, sizeof(*ring));
+        rows = calloc(ax_y.taps, sizeof(*rows));
+        ring_tag = calloc(ax_y.taps, sizeof(*ring_tag));
+        out = mem_aligned_alloc((size_t)vis.width * ch);
+
+        if (!ring || !rows || !ring_tag || !out) {
+                err = -ENOMEM;
+                goto out_free;
+        }
+
+        for (uint32_t j = 0; j < ax_y.taps; j++) {
+                ring[j] = mem_aligned_alloc((size_t)vis.width * ch * sizeof(uint16_t));
+                if (!ring[j]) {
+                        err = -ENOMEM;
+                        goto out_free;
+                }
+
+                ring_tag[j] = -1;
+        }
+
+        for (uint32_t y = 0; y < vis.height; y++) {
+                uint32_t n = ax_y.count[y];
+
+                // source rows only move forward, ring of taps rows is enough
+                for (uint32_t j = 0; j < n; j++) {
+                        int32_t sy = ax_y.start[y] + j;
+                        uint32_t slot = (uint32_t)sy % ax_y.taps;
+
+                        if (ring_tag[slot] != sy) {
+                                h_pass(ring[slot], pixel_image_row(img, sy), &ax_x, vis.width);
+                                ring_tag[slot] = sy;
+                        }
+
+                        rows[j] = ring[slot];
+                }
+
+                v_pass(out, rows, &ax_y.weights[(size_t)y * ax_y.taps], n, 0, vis.width * ch);
+                store(canvas_pixel(c, vis.x, vis.y + y), out, vis.width);
+        }
+
+out_free:
+        if (ring) {
+                for (uint32_t j = 0; j < ax_y.taps; j++) {
+                        if (ring[j])
+                                mem_aligned_free(ring[j]);
+                }
+
+                free(ring);
+        }
+
+        if (rows)
+                free(rows);
+        if (ring_tag)
+                free(ring_tag);
+        if (out)
+                mem_aligned_free(out);
+
+        resample_axis_deinit(&ax_y);
+
+out_ax_x:
+        resample_axis_deinit(&ax_x);
+
+        return err;
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "schedule.h"
+
+// "HH:MM" to minutes since midnight
+int schedule_time_parse(const char *str, double *minute)
+{
+        unsigned h, min;
+        int len = 0;
+
+        if (!str || sscanf(str, "%u:%u%n", &h, &min, &len) != 2 || h > 23 || min > 59)
+                return -EINVAL;
+
+        if (str[len] != '\0' && str[len] != '=' && str[len] != ',' && str[len] != ' ')
+                return -EINVAL;
+
+        *minute = h * 60 + min;
+
+        return 0;
+}
+
+static void schedule_keyframes_sort(struct schedule_keyframe *kf, size_t n)
+{
+        // stable, keyframes of same minute keep their order to form a cut
+        for (size_t i = 1; i < n; i++) {
+                struct schedule_keyframe k = kf[i];
+                size_t j = i;
+
+                for (; j > 0 && kf[j - 1].minute > k.minute; j--)
+                        kf[j] = kf[j - 1];
+
+                kf[j] = k;
+        }
+}
+
+//
+// "HH:MM=night%, ..." e.g. "06:30=100, 07:30=0, 18:30=0, 19:30=100",
+// returns count of keyframes, sorted by time of day
+//
+int schedule_keyframes_parse(const char *str, struct schedule_keyframe *kf, size_t max)
+{
+        const char *p = str;
+        size_t n = 0;
+
+        while (p && *p) {
+                double minute, night;
+                char *end;
+
+                while (*p == ' ' || *p == ',')
+                        p++;
+
+                if (*p == '\0')
+                        break;
+
+                if (n >= max) {
+                        pr_err("schedule: more than %zu keyframes\n", max);
+                        return -E2BIG;
+                }
+
+                if (schedule_time_parse(p, &minute))
+                        goto invalid;
+
+                p = strchr(p, '=');
+                if (!p)
+                        goto invalid;
+
+                night = strtod(p + 1, &end);
+                if (end == p + 1 || night < 0.0 || night > 100.0)
+                        goto invalid;
+
+                kf[n].minute = minute;
+                kf[n].night = night / 100.0;
+                n++;
+
+                p = end;
+
+                while (*p == ' ')
+                        p++;
+
+                if (*p != '\0' && *p != ',')
+                        goto invalid;
+        }
+
+        schedule_keyframes_sort(kf, n);
+
+        return (int)n;
+
+invalid:
+        pr_err("schedule: invalid keyframes \"%s\"\n", str);
+
+        return -EINVAL;
+}
+
+// night fades out from dawn and in from dusk over @transition minutes
+size_t schedule_keyframes_from_times(struct schedule_keyframe *kf, double dawn, double dusk,
+                                     double transition)
+{
+        kf[0] = (struct schedule_keyframe){ dawn, 1.0 };
+        kf[1] = (struct schedule_keyframe){ fmod(dawn + transition, SCHEDULE_DAY_MINUTES), 0.0 };
+        kf[2] = (struct schedule_keyframe){ dusk, 0.0 };
+        kf[3] = (struct schedule_keyframe){ fmod(dusk + transition, SCHEDULE_DAY_MINUTES), 1.0 };
+
+        schedule_keyframes_sort(kf, 4);
+
+        return 4;
+}
+
+// night share at @minute, keyframes wrap around midnight
+double schedule_night_at(const struct schedule_keyframe *kf, size_t n, double minute)
+{
+        size_t prev = n - 1, next;
+        double span, since;
+
+        if (!n)
+                return 0.0;
+
+        for (size_t i = 0; i < n; i++) {
+                if (kf[i].minute <= minute)
+                        prev = i;
+        }
+
+        next = (prev + 1) % n;
+        span = fmod(kf[next].minute - kf[prev].minute + SCHEDULE_DAY_MINUTES, SCHEDULE_DAY_MINUTES);
+        since = fmod(minute - kf[prev].minute + SCHEDULE_DAY_MINUTES, SCHEDULE_DAY_MINUTES);
+
+        if (span <= 0.0)
+                return kf[prev].night;
+
+        return kf[prev].night + (kf[next].night - kf[prev].night) * since / span;
+}
+
+// CIE L* of 8bit sRGB coded luma
+static double lightness_lut[256];
+
+static void lightness_lut_init(void)
+{
+        if (lightness_lut[255] != 0.0)
+                return;
+
+        for (int i = 0; i < 256; i++) {
+                double v = i / 255.0;
+                double y = v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+
+                lightness_lut[i] = y > 216.0 / 24389.0 ? 116.0 * cbrt(y) - 16.0 : y * 24389.0 / 27.0;
+        }
+}
+
+static inline uint8_t bgra_luma8(const uint8_t *p)
+{
+        return (uint8_t)((p[2] * 77 + p[1] * 150 + p[0] * 29 + 128) >> 8);
+}
+
+//
+// mean |delta L*| of every @step-th pixel of two BGRA rows, a blend which
+// moves by w of 256 changes lightness by about w / 256 of this
+//
+double schedule_lightness_diff(const uint8_t *a, const uint8_t *b, uint32_t n, uint32_t step)
+{
+        double sum = 0.0;
+        uint32_t cnt = 0;
+
+        lightness_lut_init();
+
+        if (!step)
+                step = 1;
+
+        for (uint32_t i = 0; i < n; i += step, cnt++)
+                sum += fabs(lightness_lut[bgra_luma8(&a[i * 4])] - lightness_lut[bgra_luma8(&b[i * 4])]);
+
+        return cnt ? sum / cnt : 0.0;
+}
@@ -0,0 +1,23 @@
+#ifndef __TABLET_WALLPAPER_SCHEDULE_H__
+#define __TABLET_WALLPAPER_SCHEDULE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SCHEDULE_KEYFRAME_MAX           16
+#define SCHEDULE_DAY_MINUTES            1440.0
+
+// share of night source at a time of day, blend is linear between keyframes
+struct schedule_keyframe {
+        double          minute;         // since local midnight, [0, 1440)
+        double          night;          // [0, 1], 0: day source only
+};
+
+int schedule_time_parse(const char *str, double *minute);
+int schedule_keyframes_parse(const char *str, struct schedule_keyframe *kf, size_t max);
+size_t schedule_keyframes_from_times(struct schedule_keyframe *kf, double dawn, double dusk,
+                                     double transition);
+double schedule_night_at(const struct schedule_keyframe *kf, size_t n, double minute);
+double schedule_lightness_diff(const uint8_t *a, const uint8_t *b, uint32_t n, uint32_t step);
+
+#endif // __TABLET_WALLPAPER_SCHEDULE_H__
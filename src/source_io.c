@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <windows.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+#include <libjj/iconv.h>
+
+#include "prof.h"
+#include "worker.h"
+#include "source_io.h"
+
+#define SOURCE_READ_CHUNK               (8 << 20)
+
+static int path_to_wc(const char *path, wchar_t *out, size_t len)
+{
+        return iconv_utf82wc((char *)path, strlen(path) + 1, out, len);
+}
+
+int source_stat(const char *path, uint64_t *size, uint64_t *mtime)
+{
+        WIN32_FILE_ATTRIBUTE_DATA attr;
+        wchar_t wpath[PATH_MAX] = { 0 };
+        int err;
+
+        if ((err = path_to_wc(path, wpath, sizeof(wpath))))
+                return err;
+
+        if (!GetFileAttributesExW(wpath, GetFileExInfoStandard, &attr))
+                return -ENOENT;
+
+        if (size)
+                *size = ((uint64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+
+        if (mtime)
+                *mtime = ((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32) |
+                         attr.ftLastWriteTime.dwLowDateTime;
+
+        return 0;
+}
+
+static int source_blob_read(struct source_blob *b)
+{
+        wchar_t wpath[PATH_MAX] = { 0 };
+        LARGE_INTEGER size;
+        FILETIME mtime;
+        HANDLE file;
+        size_t off = 0;
+        int err = 0;
+
+        if ((err = path_to_wc(b->path, wpath, sizeof(wpath))))
+                return err;
+
+        file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+                return -ENOENT;
+
+        if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+                err = -EIO;
+                goto out;
+        }
+
+        if (GetFileTime(file, NULL, NULL, &mtime))
+                b->mtime = ((uint64_t)mtime.dwHighDateTime << 32) | mtime.dwLowDateTime;
+
+        b->size = (size_t)size.QuadPart;
+        b->data = malloc(b->size);
+        if (!b->data) {
+                err = -ENOMEM;
+                goto out;
+        }
+
+        while (off < b->size) {
+                DWORD want = (DWORD)min(b->size - off, (size_t)SOURCE_READ_CHUNK);
+                DWORD got = 0;
+
+                if (!ReadFile(file, b->data + off, want, &got, NULL) || got == 0) {
+                        err = -EIO;
+                        break;
+                }
+
+                off += got;
+        }
+
+        if (err)
+                source_blob_free(b);
+
+out:
+        CloseHandle(file);
+
+        return err;
+}
+
+static void source_blob_job(void *arg, size_t idx)
+{
+        struct source_blob *b = &((struct source_blob *)arg)[idx];
+
+        b->err = source_blob_read(b);
+}
+
+//
+// read whole source files into memory on the worker pool, so opening and
+// reading many small files overlaps instead of blocking decoder one by one
+//
+int source_blobs_read(struct source_blob *blobs, size_t n)
+{
+        uint64_t ts = prof_usec_now();
+        size_t total = 0, failed = 0;
+
+        worker_run(n, source_blob_job, blobs);
+
+        for (size_t i = 0; i < n; i++) {
+                if (blobs[i].err)
+                        failed++;
+                else
+                        total += blobs[i].size;
+        }
+
+        pr_info("read %zu sources (%zu failed, %zu KiB) in %llu us\n",
+                n, failed, total >> 10, (unsigned long long)(prof_usec_now() - ts));
+
+        return failed ? -EIO : 0;
+}
+
+void source_blob_free(struct source_blob *b)
+{
+        if (b->data)
+                free(b->data);
+
+        b->data = NULL;
+        b->size = 0;
+}
+
+static int path_cmp(const void *a, const void *b)
+{
+        return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+void source_dir_list_free(char **paths, size_t n)
+{
+        if (!paths)
+                return;
+
+        for (size_t i = 0; i < n; i++)
+                free(paths[i]);
+
+        free(paths);
+}
+
+//
+// list regular files in @dir as utf-8 paths sorted by name, at most @max,
+// caller releases them with source_dir_list_free()
+//
+int source_dir_list(const char *dir, size_t max, char ***out, size_t *cnt)
+{
+        wchar_t pattern[PATH_MAX] = { 0 };
+        WIN32_FIND_DATAW fd;
+        HANDLE find;
+        char **paths = NULL;
+        size_t n = 0, cap = 0;
+        int err;
+
+        if ((err = path_to_wc(dir, pattern, sizeof(pattern))))
+                return err;
+
+        if (wcslen(pattern) + 3 > ARRAY_SIZE(pattern))
+                return -ENAMETOOLONG;
+
+        wcscat(pattern, L"\\*");
+
+        find = FindFirstFileW(pattern, &fd);
+        if (find == INVALID_HANDLE_VALUE)
+                return -ENOENT;
+
+        do {
+                char name[PATH_MAX] = { 0 };
+                char path[PATH_MAX];
+
+                if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                        continue;
+
+                if (iconv_wc2utf8(fd.cFileName, (wcslen(fd.cFileName) + 1) * sizeof(wchar_t),
+                                  name, sizeof(name)))
+                        continue;
+
+                if ((size_t)snprintf(path, sizeof(path), "%s\\%s", dir, name) >= sizeof(path))
+                        continue;
+
+                if (n == cap) {
+                        size_t ncap = cap ? cap * 2 : 64;
+                        char **p = realloc(paths, ncap * sizeof(*paths));
+
+                        if (!p) {
+                                err = -ENOMEM;
+                                break;
+                        }
+
+                        paths = p;
+                        cap = ncap;
+                }
+
+                if (!(paths[n] = strdup(path))) {
+                        err = -ENOMEM;
+                        break;
+                }
+
+                n++;
+        } while (FindNextFileW(find, &fd));
+
+        FindClose(find);
+
+        if (err) {
+                source_dir_list_free(paths, n);
+                return err;
+        }
+
+        if (n)
+                qsort(paths, n, sizeof(*paths), path_cmp);
+
+        // keep first ones in name order
+        if (max && n > max) {
+                for (size_t i = max; i < n; i++)
+                        free(paths[i]);
+
+                n = max;
+        }
+
+        *out = paths;
+        *cnt = n;
+
+        return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef __TABLET_WALLPAPER_SOURCE_IO_H__
+#define __TABLET_WALLPAPER_SOURCE_IO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct source_blob {
+        const char     *path;           // utf-8, not owned
+        uint8_t        *data;
+        size_t          size;
+        uint64_t        mtime;          // FILETIME ticks
+        uint32_t        users;          // decodes yet to consume it
+        int             err;
+};
+
+int source_stat(const char *path, uint64_t *size, uint64_t *mtime);
+int source_blobs_read(struct source_blob *blobs, size_t n);
+void source_blob_free(struct source_blob *b);
+
+int source_dir_list(const char *dir, size_t max, char ***out, size_t *cnt);
+void source_dir_list_free(char **paths, size_t n);
+
+#endif // __TABLET_WALLPAPER_SOURCE_IO_H__
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#include <wand/magick_wand.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "admission.h"
+#include "pixel.h"
+#include "source_io.h"
+#include "vector.h"
+
+static const char *vector_exts[] = {
+        ".svg", ".svgz",
+};
+
+//
+// rasters are kept per path and size, monitors of same size and style
+// share one, the least recently used one goes first when full
+//
+struct vector_entry {
+        char                   *path;
+        uint64_t                mtime;
+        uint32_t                src_width;      // intrinsic size at default density
+        uint32_t                src_height;
+        uint32_t                width;          // requested raster size
+        uint32_t                height;
+        int                     luma;
+        struct pixel_image      img;
+        uint64_t                used;
+};
+
+static struct vector_entry vector_cache[VECTOR_CACHE_MAX];
+static uint64_t vector_tick;
+static int vector_svg_supported;
+
+//
+// svg coder of GraphicsMagick only decodes when it is built with libxml2,
+// otherwise every read fails with an unhelpful "no decode delegate"
+//
+void vector_init(void)
+{
+        ExceptionInfo exception;
+        const MagickInfo *info;
+
+        GetExceptionInfo(&exception);
+        info = GetMagickInfo("SVG", &exception);
+        DestroyExceptionInfo(&exception);
+
+        vector_svg_supported = info && info->decoder;
+
+        if (!vector_svg_supported)
+                pr_info("GraphicsMagick is built without SVG (libxml2) support, vector sources are disabled\n");
+}
+
+static int vector_supported_check(const char *path)
+{
+        if (vector_svg_supported)
+                return 0;
+
+        pr_err("can not rasterise %s: GraphicsMagick is built without SVG (libxml2) support\n", path);
+
+        return -ENOTSUP;
+}
+
+int vector_path_is_vector(const char *path)
+{
+        const char *ext;
+
+        if (!path)
+                return 0;
+
+        ext = strrchr(path, '.');
+        if (!ext)
+                return 0;
+
+        for (size_t i = 0; i < ARRAY_SIZE(vector_exts); i++) {
+                if (!strcasecmp(ext, vector_exts[i]))
+                        return 1;
+        }
+
+        return 0;
+}
+
+static void vector_entry_drop(struct vector_entry *e)
+{
+        if (e->path)
+                free(e->path);
+
+        pixel_image_free(&e->img);
+
+        memset(e, 0, sizeof(*e));
+}
+
+void vector_cache_drop(void)
+{
+        for (size_t i = 0; i < ARRAY_SIZE(vector_cache); i++)
+                vector_entry_drop(&vector_cache[i]);
+}
+
+static uint64_t vector_cache_bytes(void)
+{
+        uint64_t sum = 0;
+
+        for (size_t i = 0; i < ARRAY_SIZE(vector_cache); i++)
+                sum += (uint64_t)vector_cache[i].img.stride * vector_cache[i].img.height;
+
+        return sum;
+}
+
+static struct vector_entry *vector_cache_lru(void)
+{
+        struct vector_entry *lru = NULL;
+
+        for (size_t i = 0; i < ARRAY_SIZE(vector_cache); i++) {
+                struct vector_entry *e = &vector_cache[i];
+
+                if (e->path && (!lru || e->used < lru->used))
+                        lru = e;
+        }
+
+        return lru;
+}
+
+// evict least recently used rasters until a new one of @bytes fits
+static struct vector_entry *vector_entry_alloc(uint64_t bytes)
+{
+        struct vector_entry *e;
+
+        while ((e = vector_cache_lru()) && vector_cache_bytes() + bytes > VECTOR_CACHE_BYTES)
+                vector_entry_drop(e);
+
+        for (size_t i = 0; i < ARRAY_SIZE(vector_cache); i++) {
+                if (!vector_cache[i].path)
+                        return &vector_cache[i];
+        }
+
+        e = vector_cache_lru();
+        vector_entry_drop(e);
+
+        return e;
+}
+
+// intrinsic size at default density, taken from cache if rasterised before
+static int __vector_size_get(const char *path, uint64_t mtime, uint32_t *width, uint32_t *height)
+{
+        MagickWand *w;
+
+        for (size_t i = 0; i < ARRAY_SIZE(vector_cache); i++) {
+                struct vector_entry *e = &vector_cache[i];
+
+                if (e->path && e->mtime == mtime && !strcmp(e->path, path)) {
+                        *width = e->src_width;
+                        *height = e->src_height;
+                        return 0;
+                }
+        }
+
+        w = NewMagickWand();
+
+        if (MagickPingImage(w, path) != MagickPass) {
+                pr_err("failed to read vector image: %s\n", path);
+                DestroyMagickWand(w);
+                return -EIO;
+        }
+
+        *width = MagickGetImageWidth(w);
+        *height = MagickGetImageHeight(w);
+
+        DestroyMagickWand(w);
+
+        if (!*width || !*height)
+                return -EINVAL;
+
+        return 0;
+}
+
+int vector_size_get(const char *path, uint32_t *width, uint32_t *height)
+{
+        uint64_t mtime = 0;
+        int err;
+
+        if ((err = vector_supported_check(path)))
+                return err;
+
+        if ((err = source_stat(path, NULL, &mtime)))
+                return err;
+
+        return __vector_size_get(path, mtime, width, height);
+}
+
+//
+// rasterise at exactly @width x @height by raising density instead of
+// scaling a raster afterwards, @src_width x @src_height is intrinsic size
+// from vector_size_get(), returned image is owned by cache
+//
+int vector_image_get(const char *path, uint32_t src_width, uint32_t src_height,
+                     uint32_t width, uint32_t height, int luma, struct pixel_image **out)
+{
+        struct vector_entry *e;
+        uint32_t raster_width, raster_height;
+        uint64_t mtime = 0;
+        MagickWand *w;
+        int err;
+
+        if (!width || !height || !src_width || !src_height)
+                return -EINVAL;
+
+        if ((err = vector_supported_check(path)))
+                return err;
+
+        // document file first, raster size is fitted to pixel limit below
+        if ((err = admission_file_check(path, NULL))) {
+                if (err == -EFBIG)
+                        pr_err("reject %s: file over size limit\n", path);
+
+                return err;
+        }
+
+        if ((err = source_stat(path, NULL, &mtime)))
+                return err;
+
+        for (size_t i = 0; i < ARRAY_SIZE(vector_cache); i++) {
+                e = &vector_cache[i];
+
+                if (!e->path || strcmp(e->path, path))
+                        continue;
+
+                // file changed, drop stale rasters of it
+                if (e->mtime != mtime) {
+                        vector_entry_drop(e);
+                        continue;
+                }
+
+                if (e->width == width && e->height == height && e->luma == luma) {
+                        e->used = ++vector_tick;
+                        *out = &e->img;
+                        return 0;
+                }
+        }
+
+        // styled size of center and tile follows document, can be anything
+        raster_width = width;
+        raster_height = height;
+
+        if ((err = admission_pixels_fit(path, &raster_width, &raster_height)))
+                return err;
+
+        w = NewMagickWand();
+
+        MagickSetResolution(w, VECTOR_DENSITY_DEFAULT * raster_width / src_width,
+                            VECTOR_DENSITY_DEFAULT * raster_height / src_height);
+
+        if (MagickReadImage(w, path) != MagickPass) {
+                pr_err("failed to rasterise vector image: %s\n", path);
+                DestroyMagickWand(w);
+                return -EIO;
+        }
+
+        e = vector_entry_alloc((uint64_t)raster_width * raster_height * (luma ? 1 : 4));
+
+        if (luma)
+                err = pixel_image_from_wand_luma(&e->img, w);
+        else
+                err = pixel_image_from_wand(&e->img, w);
+
+        DestroyMagickWand(w);
+
+        if (err)
+                return err;
+
+        e->path = strdup(path);
+        if (!e->path) {
+                vector_entry_drop(e);
+                return -ENOMEM;
+        }
+
+        e->mtime = mtime;
+        e->src_width = src_width;
+        e->src_height = src_height;
+        e->width = width;
+        e->height = height;
+        e->luma = luma;
+        e->used = ++vector_tick;
+
+        pr_dbg("vector %s rasterised at %ux%u for %ux%u\n", path,
+               e->img.width, e->img.height, width, height);
+
+        *out = &e->img;
+
+        return 0;
+}
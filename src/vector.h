@@ -0,0 +1,19 @@
+#ifndef __TABLET_WALLPAPER_VECTOR_H__
+#define __TABLET_WALLPAPER_VECTOR_H__
+
+#include <stdint.h>
+
+#include "pixel.h"
+
+#define VECTOR_DENSITY_DEFAULT          72.0    // dpi intrinsic size is given at
+#define VECTOR_CACHE_MAX                8
+#define VECTOR_CACHE_BYTES              (256ULL << 20)
+
+void vector_init(void);
+int vector_path_is_vector(const char *path);
+int vector_size_get(const char *path, uint32_t *width, uint32_t *height);
+int vector_image_get(const char *path, uint32_t src_width, uint32_t src_height,
+                     uint32_t width, uint32_t height, int luma, struct pixel_image **out);
+void vector_cache_drop(void);
+
+#endif // __TABLET_WALLPAPER_VECTOR_H__
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef HAVE_FFMPEG
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+#endif
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "admission.h"
+#include "pixel.h"
+#include "source_io.h"
+#include "video.h"
+
+//
+// extracted frames are kept per file version and timestamp, a display change
+// or another monitor showing same frame does not seek and decode again
+//
+struct video_entry {
+        char                   *path;
+        uint64_t                mtime;
+        int64_t                 ts_ms;          // requested, before wrapping
+        uint32_t                lowres;
+        int                     luma;
+        struct pixel_image      img;
+        uint64_t                used;
+};
+
+// stream header of last probed file, styles need size before decoding
+static struct {
+        char                   *path;
+        uint64_t                mtime;
+        uint32_t                width;
+        uint32_t                height;
+        uint32_t                lowres_min;     // to fit pixel limit
+        double                  duration;       // seconds, 0: unknown
+} video_probe;
+
+static struct video_entry video_cache[VIDEO_CACHE_MAX];
+static uint64_t video_tick;
+
+// frame index since epoch, which keeps position across restarts
+uint64_t video_slot_get(struct video *v)
+{
+        if (!v->refresh || v->step == 0.0)
+                return 0;
+
+        return (uint64_t)time(NULL) / ((uint64_t)v->refresh * 60);
+}
+
+double video_timestamp_get(struct video *v, uint64_t slot)
+{
+        double ts = v->position + v->step * (double)slot;
+
+        return ts < 0.0 ? 0.0 : ts;
+}
+
+static void video_entry_drop(struct video_entry *e)
+{
+        if (e->path)
+                free(e->path);
+
+        pixel_image_free(&e->img);
+
+        memset(e, 0, sizeof(*e));
+}
+
+void video_cache_drop(void)
+{
+        for (size_t i = 0; i < ARRAY_SIZE(video_cache); i++)
+                video_entry_drop(&video_cache[i]);
+
+        if (video_probe.path)
+                free(video_probe.path);
+
+        memset(&video_probe, 0, sizeof(video_probe));
+}
+
+static struct video_entry *video_entry_alloc(void)
+{
+        struct video_entry *lru = &video_cache[0];
+
+        for (size_t i = 0; i < ARRAY_SIZE(video_cache); i++) {
+                struct video_entry *e = &video_cache[i];
+
+                if (!e->path)
+                        return e;
+
+                if (e->used < lru->used)
+                        lru = e;
+        }
+
+        video_entry_drop(lru);
+
+        return lru;
+}
+
+#ifdef HAVE_FFMPEG
+
+struct video_decoder {
+        AVFormatContext        *fmt;
+        AVCodecContext         *ctx;
+        AVStream               *st;
+        AVPacket               *pkt;
+        AVFrame                *frame;
+        AVFrame                *last;          // latest decoded at or before target
+        int                     idx;
+        uint32_t                lowres_min;     // to fit pixel limit
+};
+
+static void video_decoder_close(struct video_decoder *d)
+{
+        if (d->last)
+                av_frame_free(&d->last);
+        if (d->frame)
+                av_frame_free(&d->frame);
+        if (d->pkt)
+                av_packet_free(&d->pkt);
+        if (d->ctx)
+                avcodec_free_context(&d->ctx);
+        if (d->fmt)
+                avformat_close_input(&d->fmt);
+}
+
+//
+// frame size is checked against pixel limit before anything is decoded,
+// lowres of decoder is the only way to reduce, others are rejected
+//
+static int video_container_open(struct video_decoder *d, const char *path)
+{
+        const AVCodec *codec;
+        int err;
+
+        if ((err = avformat_open_input(&d->fmt, path, NULL, NULL)) < 0) {
+                pr_err("failed to open video %s: %s\n", path, av_err2str(err));
+                return -EIO;
+        }
+
+        if ((err = avformat_find_stream_info(d->fmt, NULL)) < 0) {
+                pr_err("failed to read streams of %s: %s\n", path, av_err2str(err));
+                return -EIO;
+        }
+
+        d->idx = av_find_best_stream(d->fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        if (d->idx < 0) {
+                pr_err("no video stream in %s\n", path);
+                return -ENODATA;
+        }
+
+        d->st = d->fmt->streams[d->idx];
+
+        if (d->st->codecpar->width <= 0 || d->st->codecpar->height <= 0)
+                return -EINVAL;
+
+        codec = avcodec_find_decoder(d->st->codecpar->codec_id);
+
+        return admission_pixels_shift(path, d->st->codecpar->width, d->st->codecpar->height,
+                                      codec ? (uint32_t)codec->max_lowres : 0, &d->lowres_min);
+}
+
+//
+// lowres makes decoders like mjpeg and mpeg4 skip the high frequency part
+// of idct, picked as small as the style still has enough pixels for
+//
+static int video_decoder_open(struct video_decoder *d, uint32_t min_width, uint32_t min_height)
+{
+        const AVCodec *codec;
+        uint32_t width = d->st->codecpar->width;
+        uint32_t height = d->st->codecpar->height;
+        int lowres = (int)d->lowres_min;
+        int err;
+
+        codec = avcodec_find_decoder(d->st->codecpar->codec_id);
+        if (!codec) {
+                pr_err("no decoder for codec %s\n", avcodec_get_name(d->st->codecpar->codec_id));
+                return -ENOTSUP;
+        }
+
+        d->ctx = avcodec_alloc_context3(codec);
+        d->pkt = av_packet_alloc();
+        d->frame = av_frame_alloc();
+        d->last = av_frame_alloc();
+        if (!d->ctx || !d->pkt || !d->frame || !d->last)
+                return -ENOMEM;
+
+        if (avcodec_parameters_to_context(d->ctx, d->st->codecpar) < 0)
+                return -EINVAL;
+
+        while (lowres < codec->max_lowres &&
+               (width >> (lowres + 1)) >= min_width &&
+               (height >> (lowres + 1)) >= min_height)
+                lowres++;
+
+        d->ctx->lowres = lowres;
+        d->ctx->pkt_timebase = d->st->time_base;
+
+        // frame threads add latency of one frame each, which a decode of a
+        // few frames after seeking does not amortise
+        d->ctx->thread_count = 0;
+        d->ctx->thread_type = FF_THREAD_SLICE;
+
+        if ((err = avcodec_open2(d->ctx, codec, NULL)) < 0) {
+                pr_err("failed to open decoder %s: %s\n", codec->name, av_err2str(err));
+                return -EIO;
+        }
+
+        return 0;
+}
+
+//
+// seek to keyframe at or before @target, then decode forward until frame
+// on screen at @target, frames ending before target which nothing refers
+// to are skipped by decoder without reconstruction
+//
+static int video_frame_seek_decode(struct video_decoder *d, int64_t target)
+{
+        int eof = 0;
+        int err;
+
+        if (av_seek_frame(d->fmt, d->idx, target, AVSEEK_FLAG_BACKWARD) < 0)
+                pr_dbg("seek failed, decoding from start\n");
+
+        avcodec_flush_buffers(d->ctx);
+
+        while (1) {
+                err = avcodec_receive_frame(d->ctx, d->frame);
+
+                if (err == 0) {
+                        int64_t pts = d->frame->best_effort_timestamp;
+
+                        if (pts != AV_NOPTS_VALUE && pts > target && d->last->buf[0]) {
+                                av_frame_unref(d->frame);
+                                return 0;
+                        }
+
+                        av_frame_unref(d->last);
+                        av_frame_move_ref(d->last, d->frame);
+
+                        if (pts == AV_NOPTS_VALUE || pts >= target)
+                                return 0;
+
+                        continue;
+                }
+
+                if (err == AVERROR_EOF)
+                        break;
+
+                if (err != AVERROR(EAGAIN) || eof)
+                        return -EIO;
+
+                if (av_read_frame(d->fmt, d->pkt) < 0) {
+                        avcodec_send_packet(d->ctx, NULL);
+                        eof = 1;
+                        continue;
+                }
+
+                if (d->pkt->stream_index == d->idx) {
+                        d->ctx->skip_frame = d->pkt->pts != AV_NOPTS_VALUE && d->pkt->duration > 0 &&
+                                             d->pkt->pts + d->pkt->duration <= target ?
+                                             AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+                        err = avcodec_send_packet(d->ctx, d->pkt);
+                }
+
+                av_packet_unref(d->pkt);
+
+                if (err < 0 && err != AVERROR(EAGAIN))
+                        return -EIO;
+        }
+
+        // target is past last frame, take last one
+        return d->last->buf[0] ? 0 : -ENODATA;
+}
+
+static int video_frame_export(struct pixel_image *img, AVFrame *f, int luma)
+{
+        struct SwsContext *sws;
+        uint8_t *dst[4] = { 0 };
+        int dst_stride[4] = { 0 };
+        int layout = luma ? PIXEL_GREY8 : PIXEL_RGB24;
+        int err;
+
+        if ((err = pixel_image_init(img, f->width, f->height, layout, 0)))
+                return err;
+
+        // same size, only pixel format and colorspace change
+        sws = sws_getContext(f->width, f->height, f->format,
+                             f->width, f->height, luma ? AV_PIX_FMT_GRAY8 : AV_PIX_FMT_RGB24,
+                             SWS_POINT, NULL, NULL, NULL);
+        if (!sws) {
+                pr_err("unsupported video pixel format %s\n", av_get_pix_fmt_name(f->format));
+                pixel_image_free(img);
+                return -ENOTSUP;
+        }
+
+        if (f->colorspace != AVCOL_SPC_UNSPECIFIED) {
+                const int *coef = sws_getCoefficients(f->colorspace);
+
+                sws_setColorspaceDetails(sws, coef, f->color_range == AVCOL_RANGE_JPEG,
+                                         coef, 1, 0, 1 << 16, 1 << 16);
+        }
+
+        dst[0] = img->data;
+        dst_stride[0] = (int)img->stride;
+
+        sws_scale(sws, (const uint8_t * const *)f->data, f->linesize, 0, f->height, dst, dst_stride);
+        sws_freeContext(sws);
+
+        return 0;
+}
+
+static int video_probe_update(const char *path, uint64_t mtime)
+{
+        struct video_decoder d = { 0 };
+        int err;
+
+        if (video_probe.path && video_probe.mtime == mtime && !strcmp(video_probe.path, path))
+                return 0;
+
+        if ((err = video_container_open(&d, path)))
+                goto out;
+
+        if (video_probe.path)
+                free(video_probe.path);
+
+        video_probe.path = strdup(path);
+        if (!video_probe.path) {
+                err = -ENOMEM;
+                goto out;
+        }
+
+        video_probe.mtime = mtime;
+        video_probe.width = d.st->codecpar->width;
+        video_probe.height = d.st->codecpar->height;
+        video_probe.lowres_min = d.lowres_min;
+        video_probe.duration = d.fmt->duration > 0 ? (double)d.fmt->duration / AV_TIME_BASE : 0.0;
+
+out:
+        video_decoder_close(&d);
+
+        return err;
+}
+
+static int video_frame_extract(const char *path, double ts, uint32_t min_width, uint32_t min_height,
+                               int luma, struct pixel_image *img)
+{
+        struct video_decoder d = { 0 };
+        int64_t target;
+        int err;
+
+        if ((err = video_container_open(&d, path)))
+                goto out;
+
+        if ((err = video_decoder_open(&d, min_width, min_height)))
+                goto out;
+
+        target = av_rescale_q((int64_t)(ts * AV_TIME_BASE), AV_TIME_BASE_Q, d.st->time_base);
+        if (d.st->start_time != AV_NOPTS_VALUE)
+                target += d.st->start_time;
+
+        if ((err = video_frame_seek_decode(&d, target))) {
+                pr_err("failed to decode frame at %.3fs of %s\n", ts, path);
+                goto out;
+        }
+
+        pr_info("video frame %.3fs of %s, %dx%d lowres %d\n", ts, path,
+                d.last->width, d.last->height, d.ctx->lowres);
+
+        err = video_frame_export(img, d.last, luma);
+
+out:
+        video_decoder_close(&d);
+
+        return err;
+}
+
+#else
+
+static int video_probe_update(const char *path, uint64_t mtime)
+{
+        (void)mtime;
+
+        pr_err("video source %s is not supported, built without ffmpeg\n", path);
+
+        return -ENOTSUP;
+}
+
+static int video_frame_extract(const char *path, double ts, uint32_t min_width, uint32_t min_height,
+                               int luma, struct pixel_image *img)
+{
+        (void)path;
+        (void)ts;
+        (void)min_width;
+        (void)min_height;
+        (void)luma;
+        (void)img;
+
+        return -ENOTSUP;
+}
+
+#endif // HAVE_FFMPEG
+
+int video_size_get(const char *path, uint32_t *width, uint32_t *height)
+{
+        uint64_t mtime = 0;
+        int err;
+
+        if ((err = source_stat(path, NULL, &mtime)))
+                return err;
+
+        if ((err = video_probe_update(path, mtime)))
+                return err;
+
+        *width = video_probe.width;
+        *height = video_probe.height;
+
+        return 0;
+}
+
+//
+// frame on screen at @ts seconds, wrapped at end of video, decoded at no
+// less than @min_width x @min_height where decoder can reduce, returned
+// image is owned by cache
+//
+int video_frame_get(const char *path, double ts, uint32_t min_width, uint32_t min_height,
+                    int luma, struct pixel_image **out)
+{
+        struct video_entry *e;
+        int64_t ts_ms = (int64_t)(ts * 1000.0);
+        uint32_t lowres;
+        uint64_t mtime = 0;
+        int err;
+
+        if ((err = admission_file_check(path, NULL))) {
+                if (err == -EFBIG)
+                        pr_err("reject %s: file over size limit\n", path);
+
+                return err;
+        }
+
+        if ((err = source_stat(path, NULL, &mtime)))
+                return err;
+
+        if ((err = video_probe_update(path, mtime)))
+                return err;
+
+        lowres = video_probe.lowres_min;
+
+        // only for cache key, decoder may support less
+        while ((video_probe.width >> (lowres + 1)) >= min_width &&
+               (video_probe.height >> (lowres + 1)) >= min_height && lowres < 3)
+                lowres++;
+
+        for (size_t i = 0; i < ARRAY_SIZE(video_cache); i++) {
+                e = &video_cache[i];
+
+                if (!e->path || strcmp(e->path, path))
+                        continue;
+
+                if (e->mtime != mtime) {
+                        video_entry_drop(e);
+                        continue;
+                }
+
+                if (e->ts_ms == ts_ms && e->lowres == lowres && e->luma == luma) {
+                        e->used = ++video_tick;
+                        *out = &e->img;
+                        return 0;
+                }
+        }
+
+        if (video_probe.duration > 0.0 && ts >= video_probe.duration)
+                ts = fmod(ts, video_probe.duration);
+
+        e = video_entry_alloc();
+
+        if ((err = video_frame_extract(path, ts, min_width, min_height, luma, &e->img)))
+                return err;
+
+        e->path = strdup(path);
+        if (!e->path) {
+                video_entry_drop(e);
+                return -ENOMEM;
+        }
+
+        e->mtime = mtime;
+        e->ts_ms = ts_ms;
+        e->lowres = lowres;
+        e->luma = luma;
+        e->used = ++video_tick;
+
+        *out = &e->img;
+
+        return 0;
+}
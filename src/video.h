@@ -0,0 +1,24 @@
+#ifndef __TABLET_WALLPAPER_VIDEO_H__
+#define __TABLET_WALLPAPER_VIDEO_H__
+
+#include <stdint.h>
+
+#include "pixel.h"
+
+#define VIDEO_CACHE_MAX                 4
+
+struct video {
+        double          position;       // seconds into file of first frame
+        double          step;           // seconds advanced every refresh, wraps at end
+        uint32_t        refresh;        // minutes between frames, 0: fixed frame
+};
+
+uint64_t video_slot_get(struct video *v);
+double video_timestamp_get(struct video *v, uint64_t slot);
+
+int video_size_get(const char *path, uint32_t *width, uint32_t *height);
+int video_frame_get(const char *path, double ts, uint32_t min_width, uint32_t min_height,
+                    int luma, struct pixel_image **out);
+void video_cache_drop(void);
+
+#endif // __TABLET_WALLPAPER_VIDEO_H__
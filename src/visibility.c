@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "visibility.h"
+
+static const char *visibility_display_strs[] = {
+        [VISIBILITY_DISPLAY_OFF]        = "off",
+        [VISIBILITY_DISPLAY_ON]         = "on",
+        [VISIBILITY_DISPLAY_DIMMED]     = "dimmed",
+};
+
+void visibility_init(struct visibility *v)
+{
+        memset(v, 0, sizeof(*v));
+
+        // until provider tells otherwise
+        v->display = VISIBILITY_DISPLAY_ON;
+}
+
+int visibility_visible(struct visibility *v)
+{
+        return !v->locked && v->display != VISIBILITY_DISPLAY_OFF;
+}
+
+//
+// returns 1 if @render has to wait until desktop is visible again, repeated
+// requests collapse into one pending render of the widest kind
+//
+int visibility_defer(struct visibility *v, uint32_t render)
+{
+        if (visibility_visible(v))
+                return 0;
+
+        if (v->pending)
+                v->coalesced++;
+
+        v->pending |= render;
+        v->skipped++;
+
+        return 1;
+}
+
+// hand out pending renders once desktop became visible
+static uint32_t visibility_pending_take(struct visibility *v)
+{
+        uint32_t pending = v->pending;
+
+        if (!visibility_visible(v) || !pending)
+                return 0;
+
+        pr_info("desktop visible, run deferred render, %llu skipped (%llu coalesced) so far\n",
+                (unsigned long long)v->skipped, (unsigned long long)v->coalesced);
+
+        v->pending = 0;
+
+        // update re-renders everything, a refresh on top is redundant
+        if (pending & VISIBILITY_RENDER_UPDATE)
+                pending = VISIBILITY_RENDER_UPDATE;
+
+        return pending;
+}
+
+uint32_t visibility_lock_set(struct visibility *v, int locked)
+{
+        v->locked = locked ? 1 : 0;
+
+        pr_info("session %s\n", v->locked ? "locked" : "unlocked");
+
+        return visibility_pending_take(v);
+}
+
+uint32_t visibility_display_set(struct visibility *v, uint32_t display)
+{
+        if (display >= NUM_VISIBILITY_DISPLAYS)
+                display = VISIBILITY_DISPLAY_ON;
+
+        if (v->display != display)
+                pr_info("display %s\n", visibility_display_strs[display]);
+
+        v->display = display;
+
+        return visibility_pending_take(v);
+}
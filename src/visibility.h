@@ -0,0 +1,38 @@
+#ifndef __TABLET_WALLPAPER_VISIBILITY_H__
+#define __TABLET_WALLPAPER_VISIBILITY_H__
+
+#include <stdint.h>
+
+// same values as GUID_CONSOLE_DISPLAY_STATE reports
+enum visibility_display {
+        VISIBILITY_DISPLAY_OFF = 0,
+        VISIBILITY_DISPLAY_ON,
+        VISIBILITY_DISPLAY_DIMMED,
+        NUM_VISIBILITY_DISPLAYS,
+};
+
+// kinds of render which can wait, a pending update covers a refresh
+enum visibility_render {
+        VISIBILITY_RENDER_REFRESH       = 1U << 0,      // schedule blend, next video frame
+        VISIBILITY_RENDER_UPDATE        = 1U << 1,      // display layout or config changed
+};
+
+//
+// whether anyone can see the desktop, fed by a platform provider, which is
+// session and power notifications on windows, or a scripted one in tests
+//
+struct visibility {
+        uint32_t        locked;
+        uint32_t        display;
+        uint32_t        pending;        // mask of visibility_render
+        uint64_t        skipped;        // renders deferred in total
+        uint64_t        coalesced;      // of which merged into a pending one
+};
+
+void visibility_init(struct visibility *v);
+int visibility_visible(struct visibility *v);
+int visibility_defer(struct visibility *v, uint32_t render);
+uint32_t visibility_lock_set(struct visibility *v, int locked);
+uint32_t visibility_display_set(struct visibility *v, uint32_t display);
+
+#endif // __TABLET_WALLPAPER_VISIBILITY_H__
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <windows.h>
+
+#include <libjj/utils.h>
+#include <libjj/logging.h>
+
+#include "worker.h"
+
+struct worker_ctx {
+        worker_fn       fn;
+        void           *arg;
+        size_t          n;
+        volatile long   next;
+};
+
+unsigned worker_count_get(void)
+{
+        static unsigned cpus = 0;
+        SYSTEM_INFO si;
+
+        if (cpus)
+                return cpus;
+
+        GetSystemInfo(&si);
+
+        cpus = si.dwNumberOfProcessors;
+        if (cpus == 0)
+                cpus = 1;
+        if (cpus > WORKER_THREAD_MAX)
+                cpus = WORKER_THREAD_MAX;
+
+        return cpus;
+}
+
+static void worker_loop(struct worker_ctx *ctx)
+{
+        while (1) {
+                size_t i = (size_t)InterlockedIncrement(&ctx->next) - 1;
+
+                if (i >= ctx->n)
+                        break;
+
+                ctx->fn(ctx->arg, i);
+        }
+}
+
+static DWORD WINAPI worker_thread(LPVOID data)
+{
+        worker_loop(data);
+
+        return 0;
+}
+
+//
+// run fn() over [0, n) on all cores and wait for completion,
+// jobs are picked up in index order, so callers put expensive ones first
+//
+int worker_run(size_t n, worker_fn fn, void *arg)
+{
+        struct worker_ctx ctx = { .fn = fn, .arg = arg, .n = n, .next = 0 };
+        HANDLE threads[WORKER_THREAD_MAX] = { 0 };
+        size_t cnt = worker_count_get();
+        size_t spawned = 0;
+        int prio = GetThreadPriority(GetCurrentThread());
+
+        if (n == 0)
+                return 0;
+
+        if (cnt > n)
+                cnt = n;
+
+        // caller thread takes a share as well
+        for (size_t i = 1; i < cnt; i++) {
+                threads[spawned] = CreateThread(NULL, 0, worker_thread, &ctx, 0, NULL);
+                if (!threads[spawned]) {
+                        pr_err("CreateThread() failed, err = %lu\n", GetLastError());
+                        break;
+                }
+
+                // boosted callers, e.g. deferred render, boost their workers too
+                if (prio != THREAD_PRIORITY_NORMAL)
+                        SetThreadPriority(threads[spawned], prio);
+
+                spawned++;
+        }
+
+        worker_loop(&ctx);
+
+        if (spawned)
+                WaitForMultipleObjects(spawned, threads, TRUE, INFINITE);
+
+        for (size_t i = 0; i < spawned; i++)
+                CloseHandle(threads[i]);
+
+        return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef __TABLET_WALLPAPER_WORKER_H__
+#define __TABLET_WALLPAPER_WORKER_H__
+
+#include <stddef.h>
+
+#define WORKER_THREAD_MAX               64      // MAXIMUM_WAIT_OBJECTS
+
+typedef void (*worker_fn)(void *arg, size_t idx);
+
+unsigned worker_count_get(void);
+int worker_run(size_t n, worker_fn fn, void *arg);
+
+#endif // __TABLET_WALLPAPER_WORKER_H__
@@ -0,0 +1,11 @@
+#ifndef __LIBJJ_LOGGING_H__
+#define __LIBJJ_LOGGING_H__
+
+#include <stdio.h>
+
+// host test stand-in for libjj logging, which is only built for windows here
+#define pr_info(fmt, ...)               printf(fmt, ##__VA_ARGS__)
+#define pr_err(fmt, ...)                fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_dbg(fmt, ...)                do { } while (0)
+
+#endif // __LIBJJ_LOGGING_H__
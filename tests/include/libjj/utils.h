@@ -0,0 +1,15 @@
+#ifndef __LIBJJ_UTILS_H__
+#define __LIBJJ_UTILS_H__
+
+// host test stand-in for libjj utils
+#define ARRAY_SIZE(a)                   (sizeof(a) / sizeof((a)[0]))
+
+#ifndef min
+#define min(a, b)                       ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b)                       ((a) > (b) ? (a) : (b))
+#endif
+
+#endif // __LIBJJ_UTILS_H__
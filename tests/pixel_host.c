@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <wand/magick_wand.h>
+
+#include "mem.h"
+#include "canvas.h"
+
+//
+// host stand-ins for what pixel.c and procedural.c link against on windows,
+// images are filled by the tests, so the wand export path is never reached
+//
+void *mem_aligned_alloc(size_t size)
+{
+        void *p;
+
+        if (posix_memalign(&p, MEM_ALIGN, ALIGN_UP(size, MEM_ALIGN)))
+                return NULL;
+
+        return p;
+}
+
+void mem_aligned_free(void *p)
+{
+        free(p);
+}
+
+unsigned long MagickGetImageWidth(MagickWand *w)
+{
+        (void)w;
+        return 0;
+}
+
+unsigned long MagickGetImageHeight(MagickWand *w)
+{
+        (void)w;
+        return 0;
+}
+
+unsigned int MagickGetImageMatte(MagickWand *w)
+{
+        (void)w;
+        return 0;
+}
+
+ImageType MagickGetImageType(MagickWand *w)
+{
+        (void)w;
+        return UndefinedType;
+}
+
+unsigned int MagickGetImagePixels(MagickWand *w, const long x, const long y,
+                                  const unsigned long columns, const unsigned long rows,
+                                  const char *map, const StorageType storage,
+                                  unsigned char *pixels)
+{
+        (void)w; (void)x; (void)y; (void)columns; (void)rows;
+        (void)map; (void)storage; (void)pixels;
+
+        return MagickFail;
+}
+
+// "#rrggbb" only, wand parses every color name
+int color_parse(const char *str, uint32_t *bgra)
+{
+        unsigned long v;
+        char *end;
+
+        if (!str || str[0] != '#')
+                return -EINVAL;
+
+        v = strtoul(str + 1, &end, 16);
+        if (end != str + 7 || *end != '\0')
+                return -EINVAL;
+
+        *bgra = 0xff000000U | (uint32_t)v;
+
+        return 0;
+}
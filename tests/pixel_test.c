@@ -0,0 +1,745 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libjj/utils.h>
+
+#include "cpu.h"
+#include "mem.h"
+#include "pixel.h"
+#include "procedural.h"
+
+// ci runs this under qemu-aarch64 to vet the neon kernels, fail if they are left out
+#if defined(__aarch64__) && !defined(HAVE_SIMD_NEON)
+#error "neon kernels are not built, nothing would be checked"
+#endif
+
+static int failures;
+
+#define CHECK(cond)                                                             \
+        do {                                                                    \
+                if (!(cond)) {                                                  \
+                        fprintf(stderr, "%s:%d: check failed: %s\n",            \
+                                __FILE__, __LINE__, #cond);                     \
+                        failures++;                                             \
+                }                                                               \
+        } while (0)
+
+// cpu.c is windows only, names for messages
+static const char *simd_names[] = {
+        [CPU_SIMD_NONE]         = "scalar",
+        [CPU_SIMD_SSE2]         = "sse2",
+        [CPU_SIMD_NEON]         = "neon",
+};
+
+// vector kernel sets built for this target, each one is checked against scalar
+static const int simd_sets[] = {
+        CPU_SIMD_NONE,
+#ifdef HAVE_SIMD_SSE2
+        CPU_SIMD_SSE2,
+#endif
+#ifdef HAVE_SIMD_NEON
+        CPU_SIMD_NEON,
+#endif
+};
+
+static const char *layout_names[] = {
+        [PIXEL_RGB24]           = "RGB24",
+        [PIXEL_RGBA32]          = "RGBA32",
+        [PIXEL_BGRA32]          = "BGRA32",
+        [PIXEL_GREY8]           = "GREY8",
+};
+
+// odd counts leave vector tails, the others sit around 4/8/16 pixel blocks
+static const uint32_t widths[] = { 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 127, 250, 257 };
+
+#define ROW_MAX                         512
+
+static uint32_t rnd_state = 0x2545f491;
+
+static uint32_t rnd(void)
+{
+        uint32_t x = rnd_state;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        return rnd_state = x;
+}
+
+//
+// random bytes, with runs of 0x00 and 0xff so alpha kernels also see
+// fully transparent and opaque pixels
+//
+static void rnd_fill(uint8_t *p, size_t n)
+{
+        for (size_t i = 0; i < n; i++) {
+                uint32_t r = rnd();
+
+                switch (r & 0x700) {
+                case 0x100:
+                        p[i] = 0x00;
+                        break;
+
+                case 0x200:
+                        p[i] = 0xff;
+                        break;
+
+                default:
+                        p[i] = (uint8_t)r;
+                        break;
+                }
+        }
+}
+
+static void simd_select(int simd)
+{
+        pixel_simd_init(simd);
+        resample_simd_init(simd);
+        procedural_simd_init(simd);
+}
+
+enum row_kernel {
+        ROW_BLIT = 0,
+        ROW_SWIZZLE,
+        ROW_STORE,
+        ROW_FILL,
+        NUM_LAYOUT_KERNELS,
+        ROW_BLEND_PREMUL = NUM_LAYOUT_KERNELS,
+        ROW_LERP,
+        ROW_LUMA,
+        NUM_ROW_KERNELS,
+};
+
+static const char *row_kernel_names[] = {
+        [ROW_BLIT]              = "blit",
+        [ROW_SWIZZLE]           = "swizzle",
+        [ROW_STORE]             = "store",
+        [ROW_FILL]              = "fill",
+        [ROW_BLEND_PREMUL]      = "blend_premul",
+        [ROW_LERP]              = "lerp",
+        [ROW_LUMA]              = "luma",
+};
+
+struct row_case {
+        int             kernel;
+        int             layout;
+        int             alpha;
+        const uint8_t  *src;
+        const uint8_t  *src2;
+        uint32_t        n;              // pixels, bytes for lerp
+        uint32_t        arg;
+};
+
+// kernels are looked up after every simd_select(), which patches the table
+static void row_case_run(uint8_t *dst, const struct row_case *rc)
+{
+        const struct pixel_ops *ops = pixel_ops_get(rc->layout, rc->alpha);
+
+        switch (rc->kernel) {
+        case ROW_BLIT:
+                ops->blit(dst, rc->src, rc->n);
+                break;
+
+        case ROW_SWIZZLE:
+                ops->swizzle(dst, rc->src, rc->n);
+                break;
+
+        case ROW_STORE:
+                ops->store(dst, rc->src, rc->n);
+                break;
+
+        case ROW_FILL:
+                ops->fill(dst, rc->n, rc->arg);
+                break;
+
+        case ROW_BLEND_PREMUL:
+                pixel_blend_premul_row(dst, rc->src, rc->n);
+                break;
+
+        case ROW_LERP:
+                pixel_lerp_row(dst, rc->src, rc->src2, rc->n, rc->arg);
+                break;
+
+        case ROW_LUMA:
+                pixel_luma_row(dst, rc->src, rc->n);
+                break;
+        }
+}
+
+// run case on same destination with scalar and @simd kernels, bytes must match
+static void row_case_check(const struct row_case *rc, int simd, const uint8_t *init, size_t len)
+{
+        uint8_t ref[ROW_MAX * 4 + 16], out[ROW_MAX * 4 + 16];
+
+        memcpy(ref, init, len);
+        memcpy(out, init, len);
+
+        simd_select(CPU_SIMD_NONE);
+        row_case_run(ref, rc);
+
+        simd_select(simd);
+        row_case_run(out, rc);
+
+        if (!memcmp(ref, out, len))
+                return;
+
+        if (rc->kernel < NUM_LAYOUT_KERNELS)
+                fprintf(stderr, "%s %s %s alpha %d n %u: differs from scalar\n",
+                        simd_names[simd], layout_names[rc->layout],
+                        row_kernel_names[rc->kernel], rc->alpha, rc->n);
+        else
+                fprintf(stderr, "%s %s n %u arg %u: differs from scalar\n",
+                        simd_names[simd], row_kernel_names[rc->kernel], rc->n, rc->arg);
+
+        failures++;
+}
+
+//
+// every per-layout specialisation against scalar, source rows start at odd
+// byte offsets too since images are exported without per-pixel alignment
+//
+static void test_layout_kernels(int simd)
+{
+        uint8_t src[ROW_MAX * 4 + 16], dst[ROW_MAX * 4 + 16];
+
+        for (int l = 0; l < NUM_PIXEL_LAYOUTS; l++) {
+                for (int a = 0; a < 2; a++) {
+                        for (size_t w = 0; w < ARRAY_SIZE(widths); w++) {
+                                for (uint32_t off = 0; off < 4; off++) {
+                                        struct row_case rc = {
+                                                .layout = l,
+                                                .alpha = a,
+                                                .src = src + off,
+                                                .n = widths[w],
+                                                .arg = rnd(),
+                                        };
+
+                                        rnd_fill(src, sizeof(src));
+                                        rnd_fill(dst, sizeof(dst));
+
+                                        for (int k = 0; k < NUM_LAYOUT_KERNELS; k++) {
+                                                rc.kernel = k;
+                                                row_case_check(&rc, simd, dst, sizeof(dst));
+                                        }
+                                }
+                        }
+                }
+        }
+}
+
+// canvas row kernels, lerp also at odd byte counts and offsets
+static void test_row_kernels(int simd)
+{
+        static const uint32_t weights[] = { 0, 1, 127, 128, 255, 256 };
+        uint8_t a[ROW_MAX * 4 + 16], b[ROW_MAX * 4 + 16];
+        uint8_t premul[ROW_MAX * 4 + 16], dst[ROW_MAX * 4 + 16];
+
+        for (size_t w = 0; w < ARRAY_SIZE(widths); w++) {
+                for (uint32_t off = 0; off < 4; off++) {
+                        uint32_t n = widths[w];
+                        struct row_case rc = { 0 };
+
+                        rnd_fill(a, sizeof(a));
+                        rnd_fill(b, sizeof(b));
+                        rnd_fill(dst, sizeof(dst));
+
+                        // blend source is premultiplied, no channel above alpha
+                        for (size_t i = 0; i < sizeof(premul); i += 4) {
+                                for (int ch = 0; ch < 3; ch++)
+                                        premul[i + ch] = min(a[i + ch], a[i + 3]);
+
+                                premul[i + 3] = a[i + 3];
+                        }
+
+                        rc = (struct row_case){ .kernel = ROW_BLEND_PREMUL, .src = premul + off * 4, .n = n };
+                        row_case_check(&rc, simd, dst, sizeof(dst));
+
+                        rc = (struct row_case){ .kernel = ROW_LUMA, .src = a + off * 4, .n = n };
+                        row_case_check(&rc, simd, dst, sizeof(dst));
+
+                        for (size_t k = 0; k <= ARRAY_SIZE(weights); k++) {
+                                rc = (struct row_case){
+                                        .kernel = ROW_LERP,
+                                        .src = a + off,
+                                        .src2 = b + off,
+                                        .n = n * 4 - off,
+                                        .arg = k < ARRAY_SIZE(weights) ? weights[k] : rnd() % 257,
+                                };
+                                row_case_check(&rc, simd, dst, sizeof(dst));
+                        }
+                }
+        }
+}
+
+// the same pixels in every layout
+struct layout_rows {
+        uint8_t         bgra[ROW_MAX * 4];
+        uint8_t         rgba[ROW_MAX * 4];
+        uint8_t         rgb[ROW_MAX * 3];
+        uint8_t         grey[ROW_MAX];
+        uint8_t         grey_rgb[ROW_MAX * 3];
+};
+
+static void layout_rows_fill(struct layout_rows *r, uint32_t n)
+{
+        rnd_fill(r->bgra, (size_t)n * 4);
+        rnd_fill(r->grey, n);
+
+        for (uint32_t i = 0; i < n; i++) {
+                const uint8_t *p = &r->bgra[i * 4];
+
+                r->rgba[i * 4 + 0] = p[2];
+                r->rgba[i * 4 + 1] = p[1];
+                r->rgba[i * 4 + 2] = p[0];
+                r->rgba[i * 4 + 3] = p[3];
+
+                r->rgb[i * 3 + 0] = p[2];
+                r->rgb[i * 3 + 1] = p[1];
+                r->rgb[i * 3 + 2] = p[0];
+
+                memset(&r->grey_rgb[i * 3], r->grey[i], 3);
+        }
+}
+
+static const uint8_t *layout_rows_get(const struct layout_rows *r, int layout)
+{
+        switch (layout) {
+        case PIXEL_RGB24:
+                return r->rgb;
+
+        case PIXEL_RGBA32:
+                return r->rgba;
+
+        case PIXEL_GREY8:
+                return r->grey;
+
+        default:
+                break;
+        }
+
+        return r->bgra;
+}
+
+//
+// specialisations of different layouts agree with each other and with the
+// plain per-pixel definition, for whichever kernel set is selected
+//
+static void test_layout_agree(int simd)
+{
+        static struct layout_rows r;
+        uint8_t want[ROW_MAX * 4], got[ROW_MAX * 4], under[ROW_MAX * 4], blend[ROW_MAX * 4];
+
+        simd_select(simd);
+
+        for (size_t w = 0; w < ARRAY_SIZE(widths); w++) {
+                uint32_t n = widths[w];
+                size_t len = (size_t)n * 4;
+
+                layout_rows_fill(&r, n);
+                rnd_fill(under, len);
+
+                // opaque: BGR of source, alpha ignored and set
+                for (uint32_t i = 0; i < n; i++) {
+                        memcpy(&want[i * 4], &r.bgra[i * 4], 3);
+                        want[i * 4 + 3] = 0xff;
+                }
+
+                for (int l = PIXEL_RGB24; l <= PIXEL_BGRA32; l++) {
+                        const struct pixel_ops *ops = pixel_ops_get(l, 0);
+
+                        ops->swizzle(got, layout_rows_get(&r, l), n);
+                        CHECK(!memcmp(got, want, len));
+
+                        memcpy(got, under, len);
+                        ops->blit(got, layout_rows_get(&r, l), n);
+                        CHECK(!memcmp(got, want, len));
+                }
+
+                // alpha: swizzle keeps alpha, blit blends over the same row
+                for (int l = PIXEL_RGBA32; l <= PIXEL_BGRA32; l++) {
+                        const struct pixel_ops *ops = pixel_ops_get(l, 1);
+
+                        ops->swizzle(got, layout_rows_get(&r, l), n);
+                        CHECK(!memcmp(got, r.bgra, len));
+                }
+
+                memcpy(blend, under, len);
+                pixel_ops_get(PIXEL_RGBA32, 1)->blit(blend, r.rgba, n);
+                memcpy(got, under, len);
+                pixel_ops_get(PIXEL_BGRA32, 1)->blit(got, r.bgra, n);
+                CHECK(!memcmp(got, blend, len));
+
+                for (uint32_t i = 0; i < n; i++) {
+                        uint32_t a = r.bgra[i * 4 + 3];
+
+                        if (a == 0xff)
+                                CHECK(!memcmp(&got[i * 4], &r.bgra[i * 4], 3));
+                        else if (a == 0x00)
+                                CHECK(!memcmp(&got[i * 4], &under[i * 4], 3));
+
+                        CHECK(got[i * 4 + 3] == 0xff);
+                }
+
+                // grey is an RGB24 row with equal channels
+                memcpy(want, under, len);
+                pixel_ops_get(PIXEL_RGB24, 0)->blit(want, r.grey_rgb, n);
+                memcpy(got, under, len);
+                pixel_ops_get(PIXEL_GREY8, 0)->blit(got, r.grey, n);
+                CHECK(!memcmp(got, want, len));
+
+                pixel_ops_get(PIXEL_RGB24, 0)->swizzle(want, r.grey_rgb, n);
+                pixel_ops_get(PIXEL_GREY8, 0)->swizzle(got, r.grey, n);
+                CHECK(!memcmp(got, want, len));
+        }
+}
+
+static int canvas_alloc(struct canvas *c, uint32_t width, uint32_t height)
+{
+        c->width = width;
+        c->height = height;
+        c->stride = ALIGN_UP((size_t)width * CANVAS_BPP, CANVAS_ROW_ALIGN);
+        c->pixels = calloc(height, c->stride);
+
+        return c->pixels ? 0 : -1;
+}
+
+static void pixel_image_rnd(struct pixel_image *img)
+{
+        for (uint32_t y = 0; y < img->height; y++)
+                rnd_fill((uint8_t *)pixel_image_row(img, y), (size_t)img->width * img->ops->bpp);
+}
+
+// source rows of other layouts resample to the same canvas as BGRA32
+static void test_layout_resample(int simd)
+{
+        static const struct rectangle dsts[] = {
+                { -3, 2, 61, 37 },      // down
+                { 5, -4, 250, 170 },    // up
+                { 0, 0, 250, 20 },      // up and down
+        };
+        struct pixel_image img[NUM_PIXEL_LAYOUTS][2];
+        struct canvas c[NUM_PIXEL_LAYOUTS][2];
+        struct rectangle clip = { 0, 0, 240, 160 };
+        uint32_t w = 93, h = 57;
+
+        simd_select(simd);
+
+        for (int l = 0; l < NUM_PIXEL_LAYOUTS; l++) {
+                for (int a = 0; a < 2; a++) {
+                        CHECK(!pixel_image_init(&img[l][a], w, h, l, a));
+                        CHECK(!canvas_alloc(&c[l][a], clip.width, clip.height));
+                }
+        }
+
+        for (uint32_t y = 0; y < h; y++) {
+                static struct layout_rows r;
+
+                layout_rows_fill(&r, w);
+
+                for (int l = 0; l < NUM_PIXEL_LAYOUTS; l++) {
+                        for (int a = 0; a < 2; a++) {
+                                struct pixel_image *im = &img[l][a];
+
+                                memcpy((uint8_t *)pixel_image_row(im, y), layout_rows_get(&r, l),
+                                       (size_t)w * im->ops->bpp);
+                        }
+                }
+        }
+
+        for (int up = 0; up < NUM_RESAMPLE_UPSCALES; up++) {
+                resample_upscale_set(up);
+
+                for (size_t d = 0; d < ARRAY_SIZE(dsts); d++) {
+                        for (int l = 0; l < NUM_PIXEL_LAYOUTS; l++) {
+                                for (int a = 0; a < 2; a++) {
+                                        struct rectangle dst = dsts[d];
+
+                                        memset(c[l][a].pixels, 0x40, c[l][a].stride * c[l][a].height);
+                                        CHECK(!pixel_resample(&c[l][a], &clip, &dst, &img[l][a]));
+                                }
+                        }
+
+                        // same colors, RGB24 and opaque RGBA32 go through the same filter
+                        CHECK(!memcmp(c[PIXEL_RGB24][0].pixels, c[PIXEL_BGRA32][0].pixels,
+                                      c[0][0].stride * c[0][0].height));
+                        CHECK(!memcmp(c[PIXEL_RGBA32][0].pixels, c[PIXEL_BGRA32][0].pixels,
+                                      c[0][0].stride * c[0][0].height));
+                        CHECK(!memcmp(c[PIXEL_RGBA32][1].pixels, c[PIXEL_BGRA32][1].pixels,
+                                      c[0][0].stride * c[0][0].height));
+                }
+        }
+
+        resample_upscale_set(RESAMPLE_UPSCALE_EDGE);
+
+        for (int l = 0; l < NUM_PIXEL_LAYOUTS; l++) {
+                for (int a = 0; a < 2; a++) {
+                        pixel_image_free(&img[l][a]);
+                        free(c[l][a].pixels);
+                }
+        }
+}
+
+//
+// a 45 degree step upscaled 2x: edge mode keeps output constant along the
+// step, where separable cubic leaves a staircase
+//
+static uint32_t upscale_step_jag(int mode)
+{
+        struct pixel_image img;
+        struct canvas c;
+        struct rectangle r = { 0, 0, 48, 48 };
+        uint32_t jag = 0;
+
+        CHECK(!pixel_image_init(&img, 24, 24, PIXEL_RGB24, 0));
+        CHECK(!canvas_alloc(&c, r.width, r.height));
+
+        for (uint32_t y = 0; y < 24; y++) {
+                uint8_t *row = (uint8_t *)pixel_image_row(&img, y);
+
+                for (uint32_t x = 0; x < 24; x++)
+                        memset(&row[x * 3], x > y ? 230 : (x == y ? 135 : 40), 3);
+        }
+
+        resample_upscale_set(mode);
+        resample_upscale_sharpen_set(0.0);
+        CHECK(!pixel_resample(&c, &r, &r, &img));
+
+        for (uint32_t y = 8; y < 40; y++) {
+                for (uint32_t x = 8; x < 40; x++)
+                        jag += (uint32_t)abs(canvas_pixel(&c, x, y)[1] - canvas_pixel(&c, x + 1, y + 1)[1]);
+        }
+
+        resample_upscale_set(RESAMPLE_UPSCALE_EDGE);
+        resample_upscale_sharpen_set(RESAMPLE_UPSCALE_SHARPEN_DEFAULT);
+        pixel_image_free(&img);
+        free(c.pixels);
+
+        return jag;
+}
+
+static void test_upscale_edge(int simd)
+{
+        uint32_t cubic, edge;
+
+        simd_select(simd);
+
+        cubic = upscale_step_jag(RESAMPLE_UPSCALE_CUBIC);
+        edge = upscale_step_jag(RESAMPLE_UPSCALE_EDGE);
+
+        CHECK(edge * 4 < cubic);
+}
+
+enum draw_kind {
+        DRAW_RESAMPLE = 0,
+        DRAW_NEAREST,
+        DRAW_PROCEDURAL,
+};
+
+struct draw_case {
+        int             kind;
+        struct pixel_image *img;
+        struct procedural *proc;
+        struct rectangle dst;
+        uint32_t        k;
+        int             upscale;
+        double          sharpen;
+        uint32_t        linear;
+};
+
+static void draw_case_run(struct canvas *c, const struct draw_case *dc)
+{
+        struct rectangle clip = { 3, 2, c->width - 5, c->height - 3 };
+        struct rectangle dst = dc->dst;
+
+        resample_upscale_set(dc->upscale);
+        resample_upscale_sharpen_set(dc->sharpen);
+        resample_linear_set(dc->linear);
+
+        switch (dc->kind) {
+        case DRAW_RESAMPLE:
+                CHECK(!pixel_resample(c, &clip, &dst, dc->img));
+                break;
+
+        case DRAW_NEAREST:
+                CHECK(!pixel_scale_nearest(c, &clip, dst.x, dst.y, dc->k, dc->img));
+                break;
+
+        case DRAW_PROCEDURAL:
+                CHECK(!procedural_render(c, &dst, dc->proc));
+                break;
+        }
+}
+
+//
+// draw with scalar and @simd kernels over the same random canvas, float
+// shading of procedural patterns may round one step apart where the
+// compiler fuses the scalar multiply-add, integer paths must be exact
+//
+static void draw_case_check(const struct draw_case *dc, int simd, const struct canvas *init)
+{
+        uint32_t tol = dc->kind == DRAW_PROCEDURAL ? 1 : 0;
+        struct canvas ref = { 0 }, out = { 0 };
+
+        if (canvas_alloc(&ref, init->width, init->height) ||
+            canvas_alloc(&out, init->width, init->height)) {
+                CHECK(0);
+                goto out;
+        }
+
+        memcpy(ref.pixels, init->pixels, init->stride * init->height);
+        memcpy(out.pixels, init->pixels, init->stride * init->height);
+
+        simd_select(CPU_SIMD_NONE);
+        draw_case_run(&ref, dc);
+
+        simd_select(simd);
+        draw_case_run(&out, dc);
+
+        for (size_t i = 0; i < init->stride * init->height; i++) {
+                if ((uint32_t)abs(ref.pixels[i] - out.pixels[i]) <= tol)
+                        continue;
+
+                fprintf(stderr, "%s draw %d layout %s alpha %u dst %d,%d %ux%u k %u "
+                        "upscale %d sharpen %.2f linear %u: differs from scalar at (%zu, %zu)\n",
+                        simd_names[simd], dc->kind,
+                        dc->img ? layout_names[dc->img->layout] : "-",
+                        dc->img ? dc->img->alpha : 0,
+                        dc->dst.x, dc->dst.y, dc->dst.width, dc->dst.height, dc->k,
+                        dc->upscale, dc->sharpen, dc->linear,
+                        (i % init->stride) / CANVAS_BPP, i / init->stride);
+                failures++;
+                break;
+        }
+
+out:
+        free(ref.pixels);
+        free(out.pixels);
+}
+
+//
+// resample horizontal and vertical passes, upscale passes, linear light
+// luts and nearest replicate, through the same entry points as rendering
+//
+static void test_draw(int simd)
+{
+        static const uint32_t sizes[][2] = { { 93, 57 }, { 6, 5 }, { 3, 2 }, { 250, 3 } };
+        static const double sharpens[] = { 0.0, RESAMPLE_UPSCALE_SHARPEN_DEFAULT, 2.0 };
+        static const struct rectangle dsts[] = {
+                { -7, 4, 61, 37 },      // down
+                { 5, -4, 250, 170 },    // up
+                { 0, 0, 250, 20 },      // up and down
+                { 11, 9, 93, 57 },      // one to one
+                { -30, -20, 400, 300 }, // over canvas
+        };
+        struct canvas init;
+
+        CHECK(!canvas_alloc(&init, 240, 160));
+        rnd_fill(init.pixels, init.stride * init.height);
+
+        for (size_t s = 0; s < ARRAY_SIZE(sizes); s++) {
+                for (int l = 0; l < NUM_PIXEL_LAYOUTS; l++) {
+                        for (int a = 0; a < 2; a++) {
+                                struct pixel_image img;
+
+                                if (pixel_image_init(&img, sizes[s][0], sizes[s][1], l, a)) {
+                                        CHECK(0);
+                                        continue;
+                                }
+
+                                pixel_image_rnd(&img);
+
+                                for (size_t d = 0; d < ARRAY_SIZE(dsts); d++) {
+                                        for (int up = 0; up < NUM_RESAMPLE_UPSCALES; up++) {
+                                                for (uint32_t lin = 0; lin < 2; lin++) {
+                                                        // every strength meets every mode across dsts
+                                                        struct draw_case dc = {
+                                                                .kind = DRAW_RESAMPLE,
+                                                                .img = &img,
+                                                                .dst = dsts[d],
+                                                                .upscale = up,
+                                                                .sharpen = sharpens[(d + up) % ARRAY_SIZE(sharpens)],
+                                                                .linear = lin,
+                                                        };
+
+                                                        draw_case_check(&dc, simd, &init);
+                                                }
+                                        }
+                                }
+
+                                for (uint32_t k = 1; k <= 7; k++) {
+                                        struct draw_case dc = {
+                                                .kind = DRAW_NEAREST,
+                                                .img = &img,
+                                                .dst = { (int32_t)k * 3 - 9, (int32_t)k * 5 - 4, 0, 0 },
+                                                .k = k,
+                                        };
+
+                                        draw_case_check(&dc, simd, &init);
+                                }
+
+                                pixel_image_free(&img);
+                        }
+                }
+        }
+
+        for (int p = PROCEDURAL_LINEAR_GRADIENT; p < NUM_PROCEDURAL_PATTERNS; p++) {
+                static const double angles[] = { 0.0, 30.0, 90.0, 200.0 };
+
+                for (size_t i = 0; i < ARRAY_SIZE(angles); i++) {
+                        for (uint32_t dither = 0; dither < 2; dither++) {
+                                struct procedural proc = {
+                                        .pattern = p,
+                                        .colors = { "#102030", "#f0e0d0" },
+                                        .angle = angles[i],
+                                        .size = i * 13,
+                                        .dither = dither,
+                                };
+                                struct draw_case dc = {
+                                        .kind = DRAW_PROCEDURAL,
+                                        .proc = &proc,
+                                        .dst = { -10, 5, 233, 150 },
+                                };
+
+                                draw_case_check(&dc, simd, &init);
+                        }
+                }
+        }
+
+        resample_upscale_set(RESAMPLE_UPSCALE_EDGE);
+        resample_upscale_sharpen_set(RESAMPLE_UPSCALE_SHARPEN_DEFAULT);
+        resample_linear_set(0);
+        free(init.pixels);
+}
+
+int main(void)
+{
+        for (size_t i = 0; i < ARRAY_SIZE(simd_sets); i++) {
+                int simd = simd_sets[i];
+
+                printf("checking %s kernels\n", simd_names[simd]);
+
+                if (simd != CPU_SIMD_NONE) {
+                        test_layout_kernels(simd);
+                        test_row_kernels(simd);
+                        test_draw(simd);
+                }
+
+                test_layout_agree(simd);
+                test_layout_resample(simd);
+                test_upscale_edge(simd);
+        }
+
+        simd_select(CPU_SIMD_NONE);
+
+        if (failures) {
+                fprintf(stderr, "%d check(s) failed\n", failures);
+                return 1;
+        }
+
+        printf("all pixel checks passed\n");
+
+        return 0;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "schedule.h"
+
+static int failures;
+
+#define CHECK(cond)                                                             \
+        do {                                                                    \
+                if (!(cond)) {                                                  \
+                        fprintf(stderr, "%s:%d: check failed: %s\n",            \
+                                __FILE__, __LINE__, #cond);                     \
+                        failures++;                                             \
+                }                                                               \
+        } while (0)
+
+#define NEAR(a, b)                      (fabs((a) - (b)) < 1e-9)
+
+static void test_time_parse(void)
+{
+        double m = -1.0;
+
+        CHECK(schedule_time_parse("07:30", &m) == 0 && NEAR(m, 450.0));
+        CHECK(schedule_time_parse("00:00", &m) == 0 && NEAR(m, 0.0));
+        CHECK(schedule_time_parse("23:59", &m) == 0 && NEAR(m, 1439.0));
+        CHECK(schedule_time_parse("24:00", &m) != 0);
+        CHECK(schedule_time_parse("12:60", &m) != 0);
+        CHECK(schedule_time_parse("7", &m) != 0);
+        CHECK(schedule_time_parse("07:30x", &m) != 0);
+        CHECK(schedule_time_parse(NULL, &m) != 0);
+}
+
+static void test_keyframes_parse(void)
+{
+        struct schedule_keyframe kf[SCHEDULE_KEYFRAME_MAX];
+        int n;
+
+        // unsorted input comes back sorted by time of day
+        n = schedule_keyframes_parse("19:30=100, 06:30=100,07:30=0 ,18:30=0", kf, SCHEDULE_KEYFRAME_MAX);
+        CHECK(n == 4);
+        CHECK(NEAR(kf[0].minute, 390.0) && NEAR(kf[0].night, 1.0));
+        CHECK(NEAR(kf[1].minute, 450.0) && NEAR(kf[1].night, 0.0));
+        CHECK(NEAR(kf[2].minute, 1110.0) && NEAR(kf[2].night, 0.0));
+        CHECK(NEAR(kf[3].minute, 1170.0) && NEAR(kf[3].night, 1.0));
+
+        CHECK(schedule_keyframes_parse("12:00=50", kf, SCHEDULE_KEYFRAME_MAX) == 1);
+        CHECK(schedule_keyframes_parse("", kf, SCHEDULE_KEYFRAME_MAX) == 0);
+        CHECK(schedule_keyframes_parse("12:00", kf, SCHEDULE_KEYFRAME_MAX) < 0);
+        CHECK(schedule_keyframes_parse("12:00=", kf, SCHEDULE_KEYFRAME_MAX) < 0);
+        CHECK(schedule_keyframes_parse("12:00=101", kf, SCHEDULE_KEYFRAME_MAX) < 0);
+        CHECK(schedule_keyframes_parse("12:00=50 13:00=0", kf, SCHEDULE_KEYFRAME_MAX) < 0);
+        CHECK(schedule_keyframes_parse("01:00=0,02:00=0,03:00=0", kf, 2) < 0);
+}
+
+static void test_night_at(void)
+{
+        struct schedule_keyframe kf[SCHEDULE_KEYFRAME_MAX];
+        size_t n;
+
+        n = (size_t)schedule_keyframes_parse("06:00=100,08:00=0,18:00=0,20:00=100", kf, SCHEDULE_KEYFRAME_MAX);
+
+        CHECK(NEAR(schedule_night_at(kf, n, 360.0), 1.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 420.0), 0.5));
+        CHECK(NEAR(schedule_night_at(kf, n, 720.0), 0.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 1140.0), 0.5));
+        CHECK(NEAR(schedule_night_at(kf, n, 0.0), 1.0));
+
+        // wraps around midnight between last and first keyframe
+        n = (size_t)schedule_keyframes_parse("22:00=0,02:00=100", kf, SCHEDULE_KEYFRAME_MAX);
+        CHECK(NEAR(schedule_night_at(kf, n, 0.0), 0.5));
+        CHECK(NEAR(schedule_night_at(kf, n, 1380.0), 0.25));
+        CHECK(NEAR(schedule_night_at(kf, n, 720.0), 0.5));
+
+        // same minute twice is a cut
+        n = (size_t)schedule_keyframes_parse("12:00=0,12:00=100,13:00=100,13:00=0", kf, SCHEDULE_KEYFRAME_MAX);
+        CHECK(NEAR(schedule_night_at(kf, n, 719.0), 0.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 720.0), 1.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 750.0), 1.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 780.0), 0.0));
+
+        // single keyframe holds all day
+        n = (size_t)schedule_keyframes_parse("12:00=30", kf, SCHEDULE_KEYFRAME_MAX);
+        CHECK(NEAR(schedule_night_at(kf, n, 0.0), 0.3) && NEAR(schedule_night_at(kf, n, 1000.0), 0.3));
+}
+
+// dawn and dusk settings give the same curve as before keyframes
+static void test_from_times(void)
+{
+        struct schedule_keyframe kf[SCHEDULE_KEYFRAME_MAX];
+        size_t n = schedule_keyframes_from_times(kf, 420.0, 1140.0, 60.0);
+
+        CHECK(n == 4);
+        CHECK(NEAR(schedule_night_at(kf, n, 420.0), 1.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 450.0), 0.5));
+        CHECK(NEAR(schedule_night_at(kf, n, 480.0), 0.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 1140.0), 0.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 1155.0), 0.25));
+        CHECK(NEAR(schedule_night_at(kf, n, 1300.0), 1.0));
+        CHECK(NEAR(schedule_night_at(kf, n, 60.0), 1.0));
+
+        // dusk fade crossing midnight
+        n = schedule_keyframes_from_times(kf, 420.0, 1410.0, 60.0);
+        CHECK(NEAR(schedule_night_at(kf, n, 1425.0), 0.25));
+        CHECK(NEAR(schedule_night_at(kf, n, 0.0), 0.5));
+}
+
+static void test_lightness_diff(void)
+{
+        uint8_t black[16 * 4], white[16 * 4], grey[16 * 4];
+
+        memset(black, 0, sizeof(black));
+        memset(white, 255, sizeof(white));
+        memset(grey, 119, sizeof(grey));
+
+        CHECK(NEAR(schedule_lightness_diff(black, black, 16, 1), 0.0));
+        CHECK(fabs(schedule_lightness_diff(black, white, 16, 1) - 100.0) < 1e-6);
+        CHECK(fabs(schedule_lightness_diff(white, black, 16, 4) - 100.0) < 1e-6);
+
+        // sRGB 119 is about mid lightness
+        CHECK(fabs(schedule_lightness_diff(black, grey, 16, 1) - 50.0) < 0.5);
+}
+
+int main(void)
+{
+        test_time_parse();
+        test_keyframes_parse();
+        test_night_at();
+        test_from_times();
+        test_lightness_diff();
+
+        if (failures) {
+                fprintf(stderr, "%d check(s) failed\n", failures);
+                return 1;
+        }
+
+        printf("all schedule checks passed\n");
+
+        return 0;
+}
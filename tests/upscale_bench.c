@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <libjj/utils.h>
+
+#include "cpu.h"
+#include "mem.h"
+#include "pixel.h"
+
+//
+// upscale quality and speed on a synthetic 4K reference: box downscaled
+// by 2 and 3, scaled back up by every filter, compared to the reference
+//
+//   upscale_bench [dir]
+//
+// "simd" column says whether output of simd kernels equals scalar ones,
+// with @dir, src<f>.raw (RGB24 source) and ref<f>.raw (RGB24 reference)
+// are written there for upscale_bench.py, which runs Pillow filters on
+// the same input
+//
+#define REF_WIDTH                       3840
+#define REF_HEIGHT                      2160
+#define BENCH_RUNS                      3
+#define EDGE_MASK_STEP                  32      // reference change that marks an edge pixel
+
+struct bench_filter {
+        const char     *name;
+        int             upscale;
+        double          sharpen;
+};
+
+static const struct bench_filter filters[] = {
+        { "linear",             RESAMPLE_UPSCALE_LINEAR,        0.0  },
+        { "cubic",              RESAMPLE_UPSCALE_CUBIC,         0.0  },
+        { "cubic+usm0.5",       RESAMPLE_UPSCALE_CUBIC,         0.5  },
+        { "edge",               RESAMPLE_UPSCALE_EDGE,          0.0  },
+        { "edge+usm0.25",       RESAMPLE_UPSCALE_EDGE,          0.25 },
+        { "edge+usm0.5",        RESAMPLE_UPSCALE_EDGE,          0.5  },
+        { "edge+usm1.0",        RESAMPLE_UPSCALE_EDGE,          1.0  },
+        { "edge+usm2.0",        RESAMPLE_UPSCALE_EDGE,          2.0  },
+};
+
+static const uint32_t factors[] = { 2, 3 };
+
+//
+// hard edged blocks like text and ui, stripes and rings at many angles,
+// smooth gradients and fine texture, channel @c of pixel (@x, @y)
+//
+static uint8_t ref_px(int x, int y, int c)
+{
+        double v = 128 + 100 * sin(x * 0.004 + c) * cos(y * 0.003);
+
+        if (x < REF_WIDTH / 3) {
+                if (((x / 37) + (y / 53)) % 3 == 0 && (x % 37) < 20)
+                        v = c == 1 ? 250 : 20;
+        } else if (x < REF_WIDTH * 2 / 3) {
+                double a = (y < REF_HEIGHT / 2 ? 30.0 : 60.0) * M_PI / 180.0;
+                double t = (x * cos(a) + y * sin(a)) / 23.0;
+
+                if ((int64_t)floor(t) % 2)
+                        v = c == 2 ? 235 : 40;
+        } else {
+                int dx = x - REF_WIDTH * 5 / 6, dy = y - REF_HEIGHT / 2;
+
+                if (((dx * dx + dy * dy) / 4000) % 2)
+                        v = 0.5 * v + 60 * sin(x * 0.9) * sin(y * 0.7) + 40;
+        }
+
+        return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int raw_write(const char *dir, const char *name, uint32_t f, const uint8_t *data,
+                     size_t row, uint32_t height, size_t stride)
+{
+        char path[4096];
+        FILE *fp;
+
+        snprintf(path, sizeof(path), "%s/%s%u.raw", dir, name, f);
+
+        fp = fopen(path, "wb");
+        if (!fp) {
+                perror(path);
+                return -1;
+        }
+
+        for (uint32_t y = 0; y < height; y++)
+                fwrite(data + (size_t)y * stride, 1, row, fp);
+
+        fclose(fp);
+
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        const char *dir = argc > 1 ? argv[1] : NULL;
+        int simd = CPU_SIMD_NONE;
+        uint8_t *ref, *edge;
+
+#if defined(HAVE_SIMD_SSE2)
+        simd = CPU_SIMD_SSE2;
+#elif defined(HAVE_SIMD_NEON)
+        simd = CPU_SIMD_NEON;
+#endif
+
+        ref = malloc((size_t)REF_WIDTH * REF_HEIGHT * 3);
+        edge = malloc((size_t)REF_WIDTH * REF_HEIGHT);
+        if (!ref || !edge)
+                return 1;
+
+        for (uint32_t y = 0; y < REF_HEIGHT; y++) {
+                for (uint32_t x = 0; x < REF_WIDTH; x++) {
+                        for (int c = 0; c < 3; c++)
+                                ref[((size_t)y * REF_WIDTH + x) * 3 + c] = ref_px(x, y, c);
+                }
+        }
+
+        // pixels next to a hard step in green
+        for (uint32_t y = 0; y < REF_HEIGHT; y++) {
+                for (uint32_t x = 0; x < REF_WIDTH; x++) {
+                        const uint8_t *p = &ref[((size_t)y * REF_WIDTH + x) * 3 + 1];
+                        int dx = x + 1 < REF_WIDTH ? abs(p[3] - p[0]) : 0;
+                        int dy = y + 1 < REF_HEIGHT ? abs(p[REF_WIDTH * 3] - p[0]) : 0;
+
+                        edge[(size_t)y * REF_WIDTH + x] = dx + dy >= EDGE_MASK_STEP;
+                }
+        }
+
+        pixel_simd_init(simd);
+        resample_simd_init(simd);
+
+        printf("%-24s %-13s %9s %8s %10s %10s %10s %6s\n", "size", "filter", "ms", "ns/px",
+               "PSNR dB", "edge dB", "diag dB", "simd");
+
+        for (size_t fi = 0; fi < ARRAY_SIZE(factors); fi++) {
+                uint32_t f = factors[fi];
+                uint32_t w = REF_WIDTH / f, h = REF_HEIGHT / f;
+                uint32_t W = w * f, H = h * f;
+                struct pixel_image img;
+                struct canvas cv = { 0 }, cv_ref;
+                struct rectangle r = { 0, 0, W, H };
+
+                if (pixel_image_init(&img, w, h, PIXEL_RGB24, 0))
+                        return 1;
+
+                for (uint32_t y = 0; y < h; y++) {
+                        uint8_t *row = (uint8_t *)pixel_image_row(&img, y);
+
+                        for (uint32_t x = 0; x < w; x++) {
+                                for (int c = 0; c < 3; c++) {
+                                        uint32_t sum = 0;
+
+                                        for (uint32_t j = 0; j < f; j++) {
+                                                for (uint32_t i = 0; i < f; i++)
+                                                        sum += ref[((size_t)(y * f + j) * REF_WIDTH + x * f + i) * 3 + c];
+                                        }
+
+                                        row[x * 3 + c] = (uint8_t)((sum + f * f / 2) / (f * f));
+                                }
+                        }
+                }
+
+                if (dir) {
+                        raw_write(dir, "src", f, img.data, (size_t)w * 3, h, img.stride);
+                        raw_write(dir, "ref", f, ref, (size_t)REF_WIDTH * 3, REF_HEIGHT, (size_t)REF_WIDTH * 3);
+                }
+
+                cv.width = W;
+                cv.height = H;
+                cv.stride = (size_t)W * 4;
+                cv.pixels = malloc(cv.stride * H);
+                cv_ref = cv;
+                cv_ref.pixels = malloc(cv.stride * H);
+                if (!cv.pixels || !cv_ref.pixels)
+                        return 1;
+
+                for (size_t k = 0; k < ARRAY_SIZE(filters); k++) {
+                        const struct bench_filter *flt = &filters[k];
+                        double best = 1e9, se = 0.0, se_edge = 0.0, se_diag = 0.0;
+                        size_t n_edge = 0, n_diag = 0;
+                        char size[32];
+
+                        resample_upscale_set(flt->upscale);
+                        resample_upscale_sharpen_set(flt->sharpen);
+
+                        pixel_simd_init(CPU_SIMD_NONE);
+                        resample_simd_init(CPU_SIMD_NONE);
+                        pixel_resample(&cv_ref, &r, &r, &img);
+
+                        pixel_simd_init(simd);
+                        resample_simd_init(simd);
+
+                        for (int run = 0; run < BENCH_RUNS; run++) {
+                                double t = now();
+
+                                pixel_resample(&cv, &r, &r, &img);
+                                t = now() - t;
+
+                                if (t < best)
+                                        best = t;
+                        }
+
+                        for (uint32_t y = 0; y < H; y++) {
+                                for (uint32_t x = 0; x < W; x++) {
+                                        const uint8_t *p = &cv.pixels[y * cv.stride + x * 4];
+                                        const uint8_t *q = &ref[((size_t)y * REF_WIDTH + x) * 3];
+                                        double e = 0.0;
+
+                                        for (int c = 0; c < 3; c++) {
+                                                double d = (double)p[2 - c] - q[c];
+
+                                                e += d * d;
+                                        }
+
+                                        se += e;
+
+                                        if (edge[(size_t)y * REF_WIDTH + x]) {
+                                                se_edge += e;
+                                                n_edge++;
+                                        }
+
+                                        // stripes at 30 and 60 degrees
+                                        if (x >= REF_WIDTH / 3 && x < REF_WIDTH * 2 / 3) {
+                                                se_diag += e;
+                                                n_diag++;
+                                        }
+                                }
+                        }
+
+                        snprintf(size, sizeof(size), "%ux%u->%ux%u", w, h, W, H);
+                        printf("%-24s %-13s %9.2f %8.2f %10.2f %10.2f %10.2f %6s\n", size, flt->name,
+                               best * 1e3, best * 1e9 / ((double)W * H),
+                               10.0 * log10(255.0 * 255.0 / (se / (3.0 * W * H))),
+                               10.0 * log10(255.0 * 255.0 / (se_edge / (3.0 * n_edge))),
+                               10.0 * log10(255.0 * 255.0 / (se_diag / (3.0 * n_diag))),
+                               memcmp(cv.pixels, cv_ref.pixels, cv.stride * H) ? "DIFF" : "same");
+                }
+
+                free(cv_ref.pixels);
+                free(cv.pixels);
+                pixel_image_free(&img);
+        }
+
+        free(edge);
+        free(ref);
+
+        return 0;
+}
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+#
+# Pillow filters on the input of upscale_bench, same metrics:
+#
+#   upscale_bench /tmp/ub && tests/upscale_bench.py /tmp/ub
+#
+import sys
+import time
+
+import numpy as np
+from PIL import Image
+
+REF_WIDTH, REF_HEIGHT = 3840, 2160
+EDGE_MASK_STEP = 32
+RUNS = 3
+
+
+def psnr(a, b):
+    return 10.0 * np.log10(255.0 ** 2 / np.mean((a - b) ** 2))
+
+
+def main():
+    d = sys.argv[1] if len(sys.argv) > 1 else "."
+    print(f"{'size':24s} {'filter':13s} {'ms':>9s} {'ns/px':>8s} {'PSNR dB':>10s} {'edge dB':>10s} {'diag dB':>10s}")
+
+    for f in (2, 3):
+        w, h = REF_WIDTH // f, REF_HEIGHT // f
+        W, H = w * f, h * f
+
+        src = Image.frombytes("RGB", (w, h), open(f"{d}/src{f}.raw", "rb").read())
+        ref = np.fromfile(f"{d}/ref{f}.raw", np.uint8).reshape(REF_HEIGHT, REF_WIDTH, 3)
+        ref = ref[:H, :W].astype(np.float64)
+
+        # pixels next to a hard step in green, as upscale_bench.c
+        g = ref[:, :, 1]
+        step = np.zeros_like(g)
+        step[:, :-1] += np.abs(np.diff(g, axis=1))
+        step[:-1, :] += np.abs(np.diff(g, axis=0))
+        edge = step >= EDGE_MASK_STEP
+        diag = slice(REF_WIDTH // 3, REF_WIDTH * 2 // 3)
+
+        for name, flt in (("bicubic", Image.BICUBIC), ("lanczos3", Image.LANCZOS)):
+            best = 1e9
+
+            for _ in range(RUNS):
+                t = time.perf_counter()
+                out = src.resize((W, H), flt)
+                best = min(best, time.perf_counter() - t)
+
+            out = np.asarray(out).astype(np.float64)
+
+            print(f"{f'{w}x{h}->{W}x{H}':24s} {name:13s} {best * 1e3:9.2f} {best * 1e9 / (W * H):8.2f} "
+                  f"{psnr(out, ref):10.2f} {psnr(out[edge], ref[edge]):10.2f} "
+                  f"{psnr(out[:, diag], ref[:, diag]):10.2f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "visibility.h"
+
+//
+// fake provider: replays session and display notifications and render
+// requests in order, the way the notify window feeds them on windows
+//
+enum script_op {
+        OP_LOCK = 0,
+        OP_UNLOCK,
+        OP_DISPLAY,
+        OP_RENDER,
+};
+
+struct script_step {
+        int             op;
+        uint32_t        arg;            // display state or render kind
+        uint32_t        ran;            // renders expected to run on this step
+};
+
+struct renderer {
+        uint32_t        refreshes;
+        uint32_t        updates;
+};
+
+static int failures;
+
+#define CHECK(cond)                                                             \
+        do {                                                                    \
+                if (!(cond)) {                                                  \
+                        fprintf(stderr, "%s:%d: check failed: %s\n",            \
+                                __FILE__, __LINE__, #cond);                     \
+                        failures++;                                             \
+                }                                                               \
+        } while (0)
+
+static void renderer_run(struct renderer *r, uint32_t render)
+{
+        if (render & VISIBILITY_RENDER_UPDATE)
+                r->updates++;
+        else if (render & VISIBILITY_RENDER_REFRESH)
+                r->refreshes++;
+}
+
+static uint32_t script_step_run(struct visibility *v, struct renderer *r,
+                                const struct script_step *s)
+{
+        uint32_t render = 0;
+
+        switch (s->op) {
+        case OP_LOCK:
+                render = visibility_lock_set(v, 1);
+                break;
+
+        case OP_UNLOCK:
+                render = visibility_lock_set(v, 0);
+                break;
+
+        case OP_DISPLAY:
+                render = visibility_display_set(v, s->arg);
+                break;
+
+        case OP_RENDER:
+                if (!visibility_defer(v, s->arg))
+                        render = s->arg;
+
+                break;
+        }
+
+        if (render)
+                renderer_run(r, render);
+
+        return render;
+}
+
+static void script_run(struct visibility *v, struct renderer *r,
+                       const struct script_step *steps, size_t n)
+{
+        for (size_t i = 0; i < n; i++) {
+                uint32_t ran = script_step_run(v, r, &steps[i]);
+
+                if (ran != steps[i].ran) {
+                        fprintf(stderr, "step %zu: ran 0x%x, expected 0x%x\n",
+                                i, ran, steps[i].ran);
+                        failures++;
+                }
+        }
+}
+
+// visible desktop renders right away and counts nothing
+static void test_visible(void)
+{
+        const struct script_step steps[] = {
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  VISIBILITY_RENDER_REFRESH },
+                { OP_DISPLAY, VISIBILITY_DISPLAY_DIMMED,  0 },
+                { OP_RENDER,  VISIBILITY_RENDER_UPDATE,   VISIBILITY_RENDER_UPDATE },
+                { OP_DISPLAY, VISIBILITY_DISPLAY_ON,      0 },
+        };
+        struct visibility v;
+        struct renderer r = { 0 };
+
+        visibility_init(&v);
+        script_run(&v, &r, steps, sizeof(steps) / sizeof(steps[0]));
+
+        CHECK(r.refreshes == 1 && r.updates == 1);
+        CHECK(v.skipped == 0 && v.coalesced == 0 && v.pending == 0);
+}
+
+// refreshes while locked collapse into one, run once on unlock
+static void test_lock_coalesce(void)
+{
+        const struct script_step steps[] = {
+                { OP_LOCK,    0,                          0 },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  0 },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  0 },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  0 },
+                { OP_LOCK,    0,                          0 },
+                { OP_UNLOCK,  0,                          VISIBILITY_RENDER_REFRESH },
+                { OP_UNLOCK,  0,                          0 },
+        };
+        struct visibility v;
+        struct renderer r = { 0 };
+
+        visibility_init(&v);
+        script_run(&v, &r, steps, sizeof(steps) / sizeof(steps[0]));
+
+        CHECK(r.refreshes == 1 && r.updates == 0);
+        CHECK(v.skipped == 3 && v.coalesced == 2 && v.pending == 0);
+}
+
+// update absorbs refreshes deferred before and after it
+static void test_update_absorbs_refresh(void)
+{
+        const struct script_step steps[] = {
+                { OP_DISPLAY, VISIBILITY_DISPLAY_OFF,     0 },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  0 },
+                { OP_RENDER,  VISIBILITY_RENDER_UPDATE,   0 },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  0 },
+                { OP_DISPLAY, VISIBILITY_DISPLAY_ON,      VISIBILITY_RENDER_UPDATE },
+        };
+        struct visibility v;
+        struct renderer r = { 0 };
+
+        visibility_init(&v);
+        script_run(&v, &r, steps, sizeof(steps) / sizeof(steps[0]));
+
+        CHECK(r.refreshes == 0 && r.updates == 1);
+        CHECK(v.skipped == 3 && v.coalesced == 2 && v.pending == 0);
+}
+
+// pending render waits until both session is unlocked and display is on
+static void test_lock_and_display_off(void)
+{
+        const struct script_step steps[] = {
+                { OP_LOCK,    0,                          0 },
+                { OP_DISPLAY, VISIBILITY_DISPLAY_OFF,     0 },
+                { OP_RENDER,  VISIBILITY_RENDER_UPDATE,   0 },
+                { OP_DISPLAY, VISIBILITY_DISPLAY_DIMMED,  0 },
+                { OP_DISPLAY, VISIBILITY_DISPLAY_OFF,     0 },
+                { OP_UNLOCK,  0,                          0 },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  0 },
+                { OP_DISPLAY, VISIBILITY_DISPLAY_DIMMED,  VISIBILITY_RENDER_UPDATE },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  VISIBILITY_RENDER_REFRESH },
+        };
+        struct visibility v;
+        struct renderer r = { 0 };
+
+        visibility_init(&v);
+        script_run(&v, &r, steps, sizeof(steps) / sizeof(steps[0]));
+
+        CHECK(r.refreshes == 1 && r.updates == 1);
+        CHECK(v.skipped == 2 && v.coalesced == 1 && v.pending == 0);
+}
+
+// out of range display state from provider counts as on
+static void test_display_unknown(void)
+{
+        const struct script_step steps[] = {
+                { OP_DISPLAY, VISIBILITY_DISPLAY_OFF,     0 },
+                { OP_RENDER,  VISIBILITY_RENDER_REFRESH,  0 },
+                { OP_DISPLAY, NUM_VISIBILITY_DISPLAYS,    VISIBILITY_RENDER_REFRESH },
+        };
+        struct visibility v;
+        struct renderer r = { 0 };
+
+        visibility_init(&v);
+        script_run(&v, &r, steps, sizeof(steps) / sizeof(steps[0]));
+
+        CHECK(v.display == VISIBILITY_DISPLAY_ON);
+        CHECK(r.refreshes == 1 && v.skipped == 1 && v.coalesced == 0);
+}
+
+int main(void)
+{
+        test_visible();
+        test_lock_coalesce();
+        test_update_absorbs_refresh();
+        test_lock_and_display_off();
+        test_display_unknown();
+
+        if (failures) {
+                fprintf(stderr, "%d check(s) failed\n", failures);
+                return 1;
+        }
+
+        printf("all visibility checks passed\n");
+
+        return 0;
+}